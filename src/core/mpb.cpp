@@ -77,7 +77,7 @@ int mpb_server_auth_challenge::parse(Net_Message *msg) // return 0 on success
 
 Net_Message *mpb_server_auth_challenge::build()
 {
-  Net_Message *nm=new Net_Message;
+  Net_Message *nm=Net_Message::Alloc();
   nm->set_type(MESSAGE_SERVER_AUTH_CHALLENGE);
 
   const int la_sz = (license_agreement ? (int)strlen(license_agreement) + 1 : 0);
@@ -88,7 +88,7 @@ Net_Message *mpb_server_auth_challenge::build()
 
   if (!p)
   {
-    delete nm;
+    nm->releaseRef();
     return 0;
   }
 
@@ -154,7 +154,7 @@ int mpb_server_auth_reply::parse(Net_Message *msg) // return 0 on success
 
 Net_Message *mpb_server_auth_reply::build()
 {
-  Net_Message *nm=new Net_Message;
+  Net_Message *nm=Net_Message::Alloc();
   nm->set_type(MESSAGE_SERVER_AUTH_REPLY);
 
   const int errmsg_sz = errmsg ? (int)strlen(errmsg)+1 : 0;
@@ -165,7 +165,7 @@ Net_Message *mpb_server_auth_reply::build()
 
   if (!p)
   {
-    delete nm;
+    nm->releaseRef();
     return 0;
   }
 
@@ -199,7 +199,7 @@ int mpb_server_config_change_notify::parse(Net_Message *msg) // return 0 on succ
 
 Net_Message *mpb_server_config_change_notify::build()
 {
-  Net_Message *nm=new Net_Message;
+  Net_Message *nm=Net_Message::Alloc();
   nm->set_type(MESSAGE_SERVER_CONFIG_CHANGE_NOTIFY);
 
   nm->set_size(4);
@@ -208,7 +208,7 @@ Net_Message *mpb_server_config_change_notify::build()
 
   if (!p)
   {
-    delete nm;
+    nm->releaseRef();
     return 0;
   }
 
@@ -240,7 +240,7 @@ Net_Message *mpb_server_userinfo_change_notify::build()
     return n;
   }
 
-  Net_Message *nm=new Net_Message;
+  Net_Message *nm=Net_Message::Alloc();
   nm->set_type(MESSAGE_SERVER_USERINFO_CHANGE_NOTIFY);
   nm->set_size(0);
 
@@ -263,7 +263,7 @@ void mpb_server_userinfo_change_notify::build_add_rec(int isActive, int channeli
 
   if (!m_intmsg)
   {
-    m_intmsg = new Net_Message;
+    m_intmsg = Net_Message::Alloc();
     m_intmsg->set_type(MESSAGE_SERVER_USERINFO_CHANGE_NOTIFY);
   }
   const int oldsize=m_intmsg->get_size();
@@ -395,7 +395,7 @@ int mpb_server_download_interval_begin::parse(Net_Message *msg) // return 0 on s
 
 Net_Message *mpb_server_download_interval_begin::build()
 {
-  Net_Message *nm=new Net_Message;
+  Net_Message *nm=Net_Message::Alloc();
   nm->set_type(MESSAGE_SERVER_DOWNLOAD_INTERVAL_BEGIN);
 
   const int username_len = username ? (int)strlen(username) : 0;
@@ -407,7 +407,7 @@ Net_Message *mpb_server_download_interval_begin::build()
 
   if (!p||nm->get_size()!=sz)
   {
-    delete nm;
+    nm->releaseRef();
     return 0;
   }
 
@@ -451,7 +451,7 @@ int mpb_server_download_interval_write::parse(Net_Message *msg) // return 0 on s
 
 Net_Message *mpb_server_download_interval_write::build()
 {
-  Net_Message *nm=new Net_Message;
+  Net_Message *nm=Net_Message::Alloc();
   nm->set_type(MESSAGE_SERVER_DOWNLOAD_INTERVAL_WRITE);
 
   const int sz = 17 + (audio_data ? audio_data_len : 0);
@@ -461,7 +461,7 @@ Net_Message *mpb_server_download_interval_write::build()
 
   if (!p)
   {
-    delete nm;
+    nm->releaseRef();
     return 0;
   }
   memcpy(p,guid,sizeof(guid));
@@ -525,7 +525,7 @@ int mpb_client_auth_user::parse(Net_Message *msg) // return 0 on success
 
 Net_Message *mpb_client_auth_user::build()
 {
-  Net_Message *nm=new Net_Message;
+  Net_Message *nm=Net_Message::Alloc();
   nm->set_type(MESSAGE_CLIENT_AUTH_USER);
 
   const int username_len = username ? (int)strlen(username) : 0;
@@ -536,7 +536,7 @@ Net_Message *mpb_client_auth_user::build()
 
   if (!p)
   {
-    delete nm;
+    nm->releaseRef();
     return 0;
   }
 
@@ -580,7 +580,7 @@ Net_Message *mpb_client_set_usermask::build()
     return n;
   }
 
-  Net_Message *nm=new Net_Message;
+  Net_Message *nm=Net_Message::Alloc();
   nm->set_type(MESSAGE_CLIENT_SET_USERMASK);
   nm->set_size(0);
 
@@ -595,7 +595,7 @@ void mpb_client_set_usermask::build_add_rec(const char *username, unsigned int c
 
   if (!m_intmsg)
   {
-    m_intmsg = new Net_Message;
+    m_intmsg = Net_Message::Alloc();
     m_intmsg->set_type(MESSAGE_CLIENT_SET_USERMASK);
   }
   const int oldsize=m_intmsg->get_size();
@@ -665,7 +665,7 @@ Net_Message *mpb_client_set_channel_info::build()
     return n;
   }
 
-  Net_Message *nm=new Net_Message;
+  Net_Message *nm=Net_Message::Alloc();
   nm->set_type(MESSAGE_CLIENT_SET_CHANNEL_INFO);
   nm->set_size(0);
 
@@ -680,7 +680,7 @@ void mpb_client_set_channel_info::build_add_rec(const char *chname, short volume
 
   if (!m_intmsg)
   {
-    m_intmsg = new Net_Message;
+    m_intmsg = Net_Message::Alloc();
     m_intmsg->set_type(MESSAGE_CLIENT_SET_CHANNEL_INFO);
     m_intmsg->set_size(2);
     unsigned char *p=(unsigned char*)m_intmsg->get_data();
@@ -777,7 +777,7 @@ int mpb_client_upload_interval_begin::parse(Net_Message *msg) // return 0 on suc
 
 Net_Message *mpb_client_upload_interval_begin::build()
 {
-  Net_Message *nm=new Net_Message;
+  Net_Message *nm=Net_Message::Alloc();
   nm->set_type(MESSAGE_CLIENT_UPLOAD_INTERVAL_BEGIN);
 
   const int sz = 25;
@@ -787,7 +787,7 @@ Net_Message *mpb_client_upload_interval_begin::build()
 
   if (!p)
   {
-    delete nm;
+    nm->releaseRef();
     return 0;
   }
 
@@ -829,17 +829,18 @@ int mpb_client_upload_interval_write::parse(Net_Message *msg) // return 0 on suc
 
 Net_Message *mpb_client_upload_interval_write::build()
 {
-  Net_Message *nm=new Net_Message;
+  const int sz = AUDIO_OFFSET + (audio_data ? audio_data_len : 0);
+
+  Net_Message *nm=Net_Message::Alloc(sz);
   nm->set_type(MESSAGE_CLIENT_UPLOAD_INTERVAL_WRITE);
 
-  const int sz = 17 + (audio_data ? audio_data_len : 0);
   nm->set_size(sz);
 
   unsigned char *p=(unsigned char *)nm->get_data();
 
   if (!p)
   {
-    delete nm;
+    nm->releaseRef();
     return 0;
   }
   memcpy(p,guid,sizeof(guid));
@@ -883,7 +884,7 @@ int mpb_chat_message::parse(Net_Message *msg) // return 0 on success
 
 Net_Message *mpb_chat_message::build()
 {
-  Net_Message *nm=new Net_Message;
+  Net_Message *nm=Net_Message::Alloc();
   nm->set_type(MESSAGE_CHAT_MESSAGE);
 
   int x;
@@ -900,7 +901,7 @@ Net_Message *mpb_chat_message::build()
 
   if (!p)
   {
-    delete nm;
+    nm->releaseRef();
     return 0;
   }
 
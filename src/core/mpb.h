@@ -252,7 +252,9 @@ class mpb_client_upload_interval_write
     ~mpb_client_upload_interval_write() { }
 
     int parse(Net_Message *msg); // return 0 on success
-    Net_Message *build();
+    Net_Message *build(); // audio data starts at payload offset AUDIO_OFFSET
+
+    enum { AUDIO_OFFSET=17 };
 
     // public data
     unsigned char guid[16];
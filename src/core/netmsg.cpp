@@ -31,9 +31,114 @@
 #else
 #include <stdlib.h>
 #include <memory.h>
+#include <errno.h>
 #endif
+#include <math.h>
 
 #include "netmsg.h"
+#include "../wdl/mutex.h"
+#include "../wdl/ptrlist.h"
+#include "../wdl/time_precise.h"
+#include "mpb.h"
+
+
+// Free lists of Net_Messages, by storage size class. Messages keep their buffers while
+// pooled, so steady-state traffic (keepalives, upload/download interval writes) does not
+// touch the heap.
+// The last reference to a download chunk may be dropped on the audio thread, so Put()
+// neither locks nor frees: it pushes onto a lock-free stack, which the next Get() sorts
+// into the free lists (deleting any excess there).
+class Net_MessagePool
+{
+public:
+  enum { NUM_CLASSES=7, MAX_FREE_PER_CLASS=32 };
+
+  Net_MessagePool() : m_returned(NULL) { }
+
+  // never destroyed, messages can be released during static destruction
+  static Net_MessagePool *instance()
+  {
+    static Net_MessagePool *pool=new Net_MessagePool;
+    return pool;
+  }
+
+  static int classFromSize(int size)
+  {
+    for (int x = 0; x < NUM_CLASSES; x ++) if (size <= class_sizes[x]) return x;
+    return -1;
+  }
+
+  Net_Message *Get(int size)
+  {
+    const int c=classFromSize(size);
+    Net_Message *msg=NULL;
+    m_mutex.Enter();
+    if (m_returned.load(std::memory_order_relaxed)) collectReturned();
+    if (c >= 0) msg=m_free[c].Pop();
+    m_mutex.Leave();
+    if (!msg)
+    {
+      msg=new Net_Message;
+      if (c >= 0) msg->m_hb.Prealloc(class_sizes[c]);
+    }
+    return msg;
+  }
+
+  // safe on any thread, including the audio thread
+  void Put(Net_Message *msg)
+  {
+    msg->m_parsepos=0;
+    msg->m_type=MESSAGE_INVALID;
+    msg->m_hb.Resize(0,false);
+    msg->m_refcnt.store(0,std::memory_order_relaxed);
+
+    // only Get() takes from the stack, and it takes all of it, so there is no ABA
+    Net_Message *head=m_returned.load(std::memory_order_relaxed);
+    do msg->m_poolnext=head;
+    while (!m_returned.compare_exchange_weak(head,msg,std::memory_order_release,std::memory_order_relaxed));
+  }
+
+private:
+  // called with m_mutex held
+  void collectReturned()
+  {
+    Net_Message *msg=m_returned.exchange(NULL,std::memory_order_acquire);
+    while (msg)
+    {
+      Net_Message *next=msg->m_poolnext;
+      msg->m_poolnext=NULL;
+
+      // file under the largest class the buffer can hold
+      const int alloc=msg->m_hb.GetAlloc();
+      int c=NUM_CLASSES-1;
+      while (c >= 0 && class_sizes[c] > alloc) c--;
+      if (c >= 0 && m_free[c].GetSize() < MAX_FREE_PER_CLASS) m_free[c].Add(msg);
+      else delete msg;
+      msg=next;
+    }
+  }
+
+  static const int class_sizes[NUM_CLASSES];
+
+  WDL_Mutex m_mutex;
+  WDL_PtrList<Net_Message> m_free[NUM_CLASSES];
+  std::atomic<Net_Message *> m_returned; // linked through m_poolnext
+};
+
+const int Net_MessagePool::class_sizes[Net_MessagePool::NUM_CLASSES]=
+{
+  128, 512, 2048, 4096, 8192, 12288, NET_MESSAGE_MAX_SIZE
+};
+
+Net_Message *Net_Message::Alloc(int size)
+{
+  return Net_MessagePool::instance()->Get(size);
+}
+
+void Net_Message::Free(Net_Message *msg)
+{
+  Net_MessagePool::instance()->Put(msg);
+}
 
 int Net_Message::parseBytesNeeded()
 {
@@ -50,6 +155,25 @@ int Net_Message::parseAddBytes(void *data, int len)
   return len;
 }
 
+int Net_Message::parseRecvBytes(JNL_IConnection *con)
+{
+  char *p=(char*)get_data();
+  const int len=parseBytesNeeded();
+  if (!p || len < 1) return 0;
+  const int l=con->recv_bytes(p+m_parsepos,len);
+  if (l > 0) m_parsepos+=l;
+  return l > 0 ? l : 0;
+}
+
+int Net_Message::parseMessageHeaderSize(const void *data, int len)
+{
+  const unsigned char *dp=(const unsigned char *)data;
+  if (len < 5 || dp[0] == MESSAGE_INVALID) return -1;
+  const int size = dp[1] | ((int)dp[2]<<8) | ((int)dp[3]<<16) | ((int)dp[4]<<24);
+  if (size < 0 || size > NET_MESSAGE_MAX_SIZE) return -1;
+  return size;
+}
+
 int Net_Message::parseMessageHeader(void *data, int len) // returns bytes used, if any (or 0 if more data needed) or -1 if invalid
 {
   unsigned char *dp=(unsigned char *)data;
@@ -99,63 +223,72 @@ Net_Message *Net_Connection::Run(int *wantsleep)
     if (wantsleep && (s||r)) *wantsleep=0;
   }
 
-  time_t now=time(NULL);
+  const double now=time_precise();
 
-  if (m_sendq.Available() > 0) m_last_send=now;
+  if (m_nqueued > 0) m_last_send=now;
   else if (now > m_last_send + m_keepalive)
   {
-    Net_Message *keepalive= new Net_Message;
+    Net_Message *keepalive=Net_Message::Alloc();
     keepalive->set_type(MESSAGE_KEEPALIVE);
     keepalive->set_size(0);
     Send(keepalive);
     m_last_send=now;
   }
 
-  // handle sending
-  while (m_con->send_bytes_available()>64 && m_sendq.Available()>0)
+  schedule();
+
+  // handle sending. once connected and JNetLib's send buffer has drained, queued messages are
+  // written straight from their own storage, batched into one gathered send per pass
+  const bool direct = m_con->get_state()==JNL_Connection::STATE_CONNECTED &&
+                      m_con->get_socket()!=INVALID_SOCKET &&
+                      !m_con->send_bytes_in_queue();
+  if (direct && m_sendq.Available()>0)
+  {
+    if (wantsleep) *wantsleep=0;
+    sendDirect();
+  }
+
+  while (!direct && m_con->send_bytes_available()>64 && m_sendq.Available()>0)
   {
-    Net_Message **topofq = (Net_Message **)m_sendq.Get();
+    Net_Message *sendm=m_sendq.Get()->msg;
 
-    if (!topofq) break;
-    Net_Message *sendm=*topofq;
-    if (sendm)
+    if (wantsleep) *wantsleep=0;
+    if (m_msgsendpos<0) // send header (or what's left of it)
     {
-      if (wantsleep) *wantsleep=0;
-      if (m_msgsendpos<0) // send header
-      {
-        char buf[32];
-        int hdrlen=sendm->makeMessageHeader(buf);
-        m_con->send_bytes(buf,hdrlen);
+      char buf[32];
+      int hdrlen=sendm->makeMessageHeader(buf);
+      m_con->send_bytes(buf+m_hdrsendpos,hdrlen-m_hdrsendpos);
+      m_stats.bytes_copied += hdrlen-m_hdrsendpos;
 
-        m_msgsendpos=0;
-      }
+      m_hdrsendpos=0;
+      m_msgsendpos=0;
+    }
 
-      int sz=sendm->get_size()-m_msgsendpos;
-      if (sz < 1) // end of message, discard and move to next
-      {
-        sendm->releaseRef();
-        m_sendq.Advance(sizeof(Net_Message*));
-        m_msgsendpos=-1;
-      }
-      else
-      {
-        int avail=m_con->send_bytes_available();
-        if (sz > avail) sz=avail;
-        if (sz>0)
-        {
-          m_con->send_bytes((char*)sendm->get_data()+m_msgsendpos,sz);
-          m_msgsendpos+=sz;
-        }
-      }
+    int sz=sendm->get_size()-m_msgsendpos;
+    if (sz < 1) // end of message, discard and move to next
+    {
+      retireHead();
+      if (!m_sendq.Available()) schedule();
     }
     else
     {
-      m_sendq.Advance(sizeof(Net_Message*));
-      m_msgsendpos=-1;
+      int avail=m_con->send_bytes_available();
+      if (sz > avail) sz=avail;
+      if (sz>0)
+      {
+        m_con->send_bytes((char*)sendm->get_data()+m_msgsendpos,sz);
+        m_msgsendpos+=sz;
+        m_stats.bytes_copied += sz;
+      }
     }
     {
       int s=0,r=0;
       m_con->run(-1,-1,&s,&r);
+      if (s)
+      {
+        m_stats.send_calls++;
+        m_stats.bytes_sent += s;
+      }
       if (wantsleep && (s||r)) *wantsleep=0;
     }
   }
@@ -164,33 +297,29 @@ Net_Message *Net_Connection::Run(int *wantsleep)
 
   Net_Message *retv=0;
 
-  // handle receive now
-  if (!m_recvmsg)
-  {
-    m_recvmsg=new Net_Message;
-    m_recvstate=0;
-  }
-
+  // handle receive now: the header is peeked, then the payload is read straight from the
+  // connection's receive buffer into a pooled message of the right size class
   while (!retv && m_con->recv_bytes_available()>0)
   {
-    char buf[8192];
-    int bufl=m_con->peek_bytes(buf,sizeof(buf));
-    int a=0;
-
     if (!m_recvstate)
     {
-      a=m_recvmsg->parseMessageHeader(buf,bufl);
-      if (a<0)
+      unsigned char hdr[5];
+      const int hdrl=m_con->peek_bytes(hdr,sizeof(hdr));
+      if (hdrl < (int)sizeof(hdr)) break;
+
+      const int size=Net_Message::parseMessageHeaderSize(hdr,hdrl);
+      if (size < 0)
       {
         m_error=-1;
         break;
       }
-      if (a==0) break;
+      if (!m_recvmsg) m_recvmsg=Net_Message::Alloc(size);
+      m_recvmsg->parseMessageHeader(hdr,hdrl);
+      m_con->recv_bytes(hdr,hdrl);
       m_recvstate=1;
     }
-    int b2=m_recvmsg->parseAddBytes(buf+a,bufl-a);
 
-    m_con->recv_bytes(buf,b2+a); // dump our bytes that we used
+    if (m_recvmsg->parseBytesNeeded()>0 && m_recvmsg->parseRecvBytes(m_con)<1) break;
 
     if (m_recvmsg->parseBytesNeeded()<1)
     {
@@ -210,86 +339,309 @@ Net_Message *Net_Connection::Run(int *wantsleep)
 
   if (retv)
   {
+    const int gap=(int) ((now-m_last_recv)*1000.0);
+    if (gap > m_health.max_recv_gap_ms) m_health.max_recv_gap_ms=gap;
     m_last_recv=now;
+    m_recv_stalled=false;
   }
-  else if (now > m_last_recv + m_keepalive*3)
+  else
   {
-    m_error=-3;
+    const double timeout = m_recv_timeout_ms>0 ? m_recv_timeout_ms*0.001 : m_keepalive*3.0;
+    if (now > m_last_recv + timeout) m_error=-3;
   }
 
+  if (m_con->get_state()==JNL_Connection::STATE_CONNECTED) updateHealth(now);
+
   return retv;
 }
 
-int Net_Connection::Send(Net_Message *msg)
+void Net_Connection::SetKeepAlive(int interval)
 {
-  if (msg)
+  m_keepalive=interval?interval:NET_CON_KEEPALIVE_RATE;
+  m_last_send=m_last_recv=time_precise();
+  m_recv_stalled=false;
+}
+
+void Net_Connection::AddRttSample(double ms, int source)
+{
+  if (ms < 0.0) return;
+  if (m_health.rtt_ms < 0.0)
   {
-    msg->addRef();
-    if (m_sendq.GetSize() < NET_CON_MAX_MESSAGES*(int)sizeof(Net_Message *))
-      m_sendq.Add(&msg,sizeof(Net_Message *));
-    else
+    m_health.rtt_ms=ms;
+    m_health.jitter_ms=ms*0.5;
+  }
+  else
+  {
+    // as TCP does it (RFC 6298)
+    m_health.jitter_ms=m_health.jitter_ms*0.75 + fabs(m_health.rtt_ms-ms)*0.25;
+    m_health.rtt_ms=m_health.rtt_ms*0.875 + ms*0.125;
+  }
+  if (m_health.rtt_min_ms < 0.0 || ms < m_health.rtt_min_ms) m_health.rtt_min_ms=ms;
+  m_health.rtt_source=source;
+}
+
+void Net_Connection::updateHealth(double now)
+{
+  m_health.recv_gap_ms=(int) ((now-m_last_recv)*1000.0);
+  if (!m_recv_stalled && now > m_last_recv + m_keepalive*1.5)
+  {
+    m_recv_stalled=true;
+    m_health.recv_stalls++;
+    // the server keeps the line busy, so put something in flight of our own. if the path
+    // is gone it shows up as retransmits well before the receive timeout
+    if (!m_nqueued)
     {
-      m_error=-2;
-      msg->releaseRef(); // todo: debug message to log overrun error
-      return -1;
+      Net_Message *keepalive=Net_Message::Alloc();
+      keepalive->set_type(MESSAGE_KEEPALIVE);
+      keepalive->set_size(0);
+      Send(keepalive);
+      m_last_send=now;
     }
+  }
 
-#if 0
-    if (m_con)
+  if ((!m_nqueued && !m_con->send_bytes_in_queue()) || m_stats.bytes_sent != m_last_progress_bytes)
+  {
+    m_last_progress=now;
+    m_last_progress_bytes=m_stats.bytes_sent;
+    m_send_stalled=false;
+  }
+  else if (!m_send_stalled && now > m_last_progress + 1.0)
+  {
+    m_send_stalled=true;
+    m_health.send_stalls++;
+  }
+
+  if (now < m_last_tcpinfo + 1.0) return;
+  m_last_tcpinfo=now;
+
+  // the server doesn't echo anything we could time, but the kernel measures RTT on every ack
+#if defined(__linux__) || (defined(__APPLE__) && defined(TCP_CONNECTION_INFO))
+  const SOCKET sock=m_con->get_socket();
+  if (sock == INVALID_SOCKET) return;
+#endif
+#if defined(__linux__)
+  struct tcp_info ti;
+  socklen_t len=sizeof(ti);
+  memset(&ti,0,sizeof(ti));
+  if (!getsockopt(sock,IPPROTO_TCP,TCP_INFO,&ti,&len) && ti.tcpi_rtt > 0)
+  {
+    const double rtt=ti.tcpi_rtt*0.001; // usec
+    m_health.rtt_ms=rtt;
+    m_health.jitter_ms=ti.tcpi_rttvar*0.001;
+    if (m_health.rtt_min_ms < 0.0 || rtt < m_health.rtt_min_ms) m_health.rtt_min_ms=rtt;
+    m_health.rtt_source=RTT_TCPINFO;
+    m_health.tcp_retransmits=(int)ti.tcpi_total_retrans;
+  }
+#elif defined(__APPLE__) && defined(TCP_CONNECTION_INFO)
+  struct tcp_connection_info ti;
+  socklen_t len=sizeof(ti);
+  memset(&ti,0,sizeof(ti));
+  if (!getsockopt(sock,IPPROTO_TCP,TCP_CONNECTION_INFO,&ti,&len) && ti.tcpi_srtt > 0)
+  {
+    const double rtt=ti.tcpi_srtt; // msec
+    m_health.rtt_ms=rtt;
+    m_health.jitter_ms=ti.tcpi_rttvar;
+    if (m_health.rtt_min_ms < 0.0 || rtt < m_health.rtt_min_ms) m_health.rtt_min_ms=rtt;
+    m_health.rtt_source=RTT_TCPINFO;
+    m_health.tcp_retransmits=(int)ti.tcpi_txretransmitpackets;
+  }
+#endif
+}
+
+// moves messages from the priority queues to m_sendq, deficit round robin by bytes. m_sendq is
+// only topped up to NET_CON_MAX_SEND_BURST, so a control message queued behind a backlog of
+// interval data waits for at most that much
+void Net_Connection::schedule()
+{
+  static const int quantum[NET_CON_NUM_PRIO]={ 16384, 8192, 2048 };
+
+  while (m_wirebytes < NET_CON_MAX_SEND_BURST && m_nqueued > m_sendq.Available())
+  {
+    WDL_TypedQueue<SendEntry> *q=m_prioq+m_drr_cur;
+    if (!q->Available())
+    {
+      m_deficit[m_drr_cur]=0;
+      m_drr_cur=(m_drr_cur+1)%NET_CON_NUM_PRIO;
+      m_drr_fresh=true;
+      continue;
+    }
+    if (m_drr_fresh)
+    {
+      m_deficit[m_drr_cur]+=quantum[m_drr_cur];
+      m_drr_fresh=false;
+    }
+
+    const SendEntry *e=q->Get();
+    const int sz=5+e->msg->get_size();
+    if (sz > m_deficit[m_drr_cur])
     {
-      m_con->run();
+      m_drr_cur=(m_drr_cur+1)%NET_CON_NUM_PRIO;
+      m_drr_fresh=true;
+      continue;
+    }
+    m_deficit[m_drr_cur]-=sz;
+    m_wirebytes+=sz;
+    m_sendq.Add(e,1);
+    q->Advance(1);
+  }
+
+  for (int x = 0; x < NET_CON_NUM_PRIO; x ++) m_prioq[x].Compact();
+}
+
+void Net_Connection::retireHead()
+{
+  const SendEntry *e=m_sendq.Get();
+  const int sz=5+e->msg->get_size();
+  const double delay=(time_precise()-e->queued)*1000.0;
+
+  Stats::Prio *ps=m_stats.prio+e->prio;
+  ps->delay_avg_ms = ps->msgs ? ps->delay_avg_ms*0.9 + delay*0.1 : delay;
+  if (delay > ps->delay_max_ms) ps->delay_max_ms=delay;
+  ps->msgs++;
+  ps->bytes+=sz;
+  ps->queued--;
+
+  e->msg->releaseRef();
+  m_sendq.Advance(1);
+  m_wirebytes-=sz;
+  m_nqueued--;
+  m_msgsendpos=-1;
+}
+
+void Net_Connection::sendDirect()
+{
+  enum { MAX_MSGS=NET_CON_MAX_IOV/2 };
 
-      while (m_con->send_bytes_available()>64 && m_sendq.Available()>0)
+#ifdef _WIN32
+  WSABUF iov[NET_CON_MAX_IOV];
+  #define NET_IOV_SET(v,p,l) { (v).buf=(char *)(p); (v).len=(ULONG)(l); }
+#else
+  struct iovec iov[NET_CON_MAX_IOV];
+  #define NET_IOV_SET(v,p,l) { (v).iov_base=(void *)(p); (v).iov_len=(size_t)(l); }
+#endif
+  unsigned char hdrs[MAX_MSGS][8];
+
+  const SendEntry *q=m_sendq.Get();
+  const int nq=m_sendq.Available();
+
+  int niov=0, total=0, x;
+  for (x = 0; x < nq && x < MAX_MSGS && total < NET_CON_MAX_SEND_BURST; x ++)
+  {
+    Net_Message *m=q[x].msg;
+
+    int bodypos=0;
+    if (!x && m_msgsendpos>=0) bodypos=m_msgsendpos;
+    else
+    {
+      const int hdrstart = x ? 0 : m_hdrsendpos;
+      const int hdrlen=m->makeMessageHeader(hdrs[x]);
+      NET_IOV_SET(iov[niov],hdrs[x]+hdrstart,hdrlen-hdrstart)
+      niov++;
+      total+=hdrlen-hdrstart;
+    }
+    const int bodylen=m->get_size()-bodypos;
+    if (bodylen>0)
+    {
+      NET_IOV_SET(iov[niov],(char *)m->get_data()+bodypos,bodylen)
+      niov++;
+      total+=bodylen;
+    }
+  }
+  #undef NET_IOV_SET
+
+  int sent=0;
+  if (niov>0)
+  {
+    const SOCKET sock=m_con->get_socket();
+#ifdef _WIN32
+    DWORD dw=0;
+    if (WSASend(sock,iov,niov,&dw,0,NULL,NULL)==0) sent=(int)dw;
+    else if (WSAGetLastError()!=WSAEWOULDBLOCK) m_error=-4;
+#else
+    struct msghdr mh;
+    memset(&mh,0,sizeof(mh));
+    mh.msg_iov=iov;
+    mh.msg_iovlen=niov;
+  #ifdef MSG_NOSIGNAL
+    const int res=(int)sendmsg(sock,&mh,MSG_NOSIGNAL);
+  #else
+    const int res=(int)sendmsg(sock,&mh,0);
+  #endif
+    if (res>0) sent=res;
+    else if (res<0 && errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR) m_error=-4;
+#endif
+    m_stats.send_calls++;
+    m_stats.bytes_sent += sent;
+  }
+
+  // retire what went out, leaving the position inside the first unfinished message
+  while (sent>0 && m_sendq.Available()>0)
+  {
+    Net_Message *m=m_sendq.Get()->msg;
+    if (m_msgsendpos<0)
+    {
+      const int hdrleft=m->makeMessageHeader(hdrs[0])-m_hdrsendpos;
+      if (sent < hdrleft)
       {
-        Net_Message **topofq = (Net_Message **)m_sendq.Get();
-
-        if (!topofq) break;
-        Net_Message *sendm=*topofq;
-        if (sendm)
-        {
-          if (m_msgsendpos<0) // send header
-          {
-            char buf[32];
-            int hdrlen=sendm->makeMessageHeader(buf);
-            m_con->send_bytes(buf,hdrlen);
-
-            m_msgsendpos=0;
-          }
-
-          int sz=sendm->get_size()-m_msgsendpos;
-          if (sz < 1) // end of message, discard and move to next
-          {
-            sendm->releaseRef();
-            m_sendq.Advance(sizeof(Net_Message*));
-            m_msgsendpos=-1;
-          }
-          else
-          {
-            int avail=m_con->send_bytes_available();
-            if (sz > avail) sz=avail;
-            if (sz>0)
-            {
-              m_con->send_bytes((char*)sendm->get_data()+m_msgsendpos,sz);
-              m_msgsendpos+=sz;
-            }
-          }
-        }
-        else
-        {
-          m_sendq.Advance(sizeof(Net_Message*));
-          m_msgsendpos=-1;
-        }
-        m_con->run();
+        m_hdrsendpos+=sent;
+        break;
       }
+      sent-=hdrleft;
+      m_hdrsendpos=0;
+      m_msgsendpos=0;
+    }
+    const int bodyleft=m->get_size()-m_msgsendpos;
+    if (sent < bodyleft)
+    {
+      m_msgsendpos+=sent;
+      break;
+    }
+    sent-=bodyleft;
+    retireHead();
+  }
+  // a message that was fully sent except for having no body
+  while (m_sendq.Available()>0 && m_msgsendpos>=0 && m_sendq.Get()->msg->get_size()<=m_msgsendpos)
+  {
+    retireHead();
+  }
+}
 
-      m_sendq.Compact();
+int Net_Connection::Send(Net_Message *msg, int prio)
+{
+  if (msg)
+  {
+    if (m_nqueued >= NET_CON_MAX_MESSAGES)
+    {
+      msg->addRef();
+      m_error=-2;
+      msg->releaseRef(); // todo: debug message to log overrun error
+      return -1;
     }
-  #endif
 
+    if (prio < 0 || prio >= NET_CON_NUM_PRIO)
+    {
+      const int t=msg->get_type();
+      prio = (t == MESSAGE_CLIENT_UPLOAD_INTERVAL_BEGIN || t == MESSAGE_CLIENT_UPLOAD_INTERVAL_WRITE) ? NET_CON_PRIO_BULK : NET_CON_PRIO_CONTROL;
+    }
+
+    msg->addRef();
+    SendEntry e={ msg, time_precise(), prio };
+    m_prioq[prio].Add(&e,1);
+    m_nqueued++;
+    m_stats.prio[prio].queued++;
+    m_stats.bytes_queued += 5 + msg->get_size(); // 1 byte type, 4 bytes size
   }
   return 0;
 }
 
+SOCKET Net_Connection::GetWaitSocket(bool *wantwrite)
+{
+  if (wantwrite) *wantwrite=false;
+  if (!m_con || m_error || m_con->get_state()!=JNL_Connection::STATE_CONNECTED) return INVALID_SOCKET;
+  if (wantwrite) *wantwrite = m_nqueued>0 || m_con->send_bytes_in_queue()>0;
+  return m_con->get_socket();
+}
+
 int Net_Connection::GetStatus()
 {
   if (m_error) return m_error;
@@ -298,21 +650,22 @@ int Net_Connection::GetStatus()
 
 Net_Connection::~Net_Connection()
 {
-  Net_Message **p=(Net_Message **)m_sendq.Get();
-  if (p)
+  while (m_sendq.Available()>0)
+  {
+    m_sendq.Get()->msg->releaseRef();
+    m_sendq.Advance(1);
+  }
+  for (int x = 0; x < NET_CON_NUM_PRIO; x ++)
   {
-    int n=m_sendq.Available()/sizeof(Net_Message *);
-    while (n-->0)
+    while (m_prioq[x].Available()>0)
     {
-      (*p)->releaseRef();
-      p++;
+      m_prioq[x].Get()->msg->releaseRef();
+      m_prioq[x].Advance(1);
     }
-    m_sendq.Advance(m_sendq.Available());
-
   }
 
   delete m_con;
-  delete m_recvmsg;
+  if (m_recvmsg) m_recvmsg->releaseRef();
 
 }
 
@@ -29,10 +29,12 @@
 #ifndef _NETMSG_H_
 #define _NETMSG_H_
 
+#include <atomic>
 #include "../wdl/queue.h"
 #include "../wdl/jnetlib/jnetlib.h"
 #ifndef _WIN32
 #include <netinet/tcp.h>
+#include <sys/uio.h>
 #endif
 
 #define NET_MESSAGE_MAX_SIZE 16384
@@ -45,25 +47,39 @@
 
 #define NET_CON_KEEPALIVE_RATE 3
 
+#define NET_CON_MAX_IOV 64 // header+payload pairs gathered into a single send
+#define NET_CON_MAX_SEND_BURST 65536
+
+// send priority classes, scheduled with deficit round robin. a message is always sent whole
+// before the next one starts, whatever its class
+#define NET_CON_PRIO_CONTROL 0 // keepalives, auth, chat, subscriptions, channel info
+#define NET_CON_PRIO_VOICE 1   // uploads for live (voice chat) channels
+#define NET_CON_PRIO_BULK 2    // interval uploads
+#define NET_CON_NUM_PRIO 3
+
 
 class Net_Message
 {
   public:
-    Net_Message() : m_parsepos(0), m_refcnt(0), m_type(MESSAGE_INVALID)
+    Net_Message() : m_parsepos(0), m_refcnt(0), m_type(MESSAGE_INVALID), m_poolnext(NULL)
     {
     }
     ~Net_Message()
     {
     }
 
+    // returns a message (refcount 0) from a size-classed pool, with storage for at least size bytes.
+    // releaseRef() returns it to the pool, so prefer this to new.
+    static Net_Message *Alloc(int size=0);
+
 
     void set_type(int type)  { m_type=type; }
     int  get_type() const { return m_type; }
 
     void set_size(int newsize)
     {
-      m_hb.Resize(newsize);
-      if (m_hb.GetSize() != newsize) m_hb.Resize(0);
+      m_hb.Resize(newsize,false); // keep the allocation, pooled messages are reused
+      if (m_hb.GetSize() != newsize) m_hb.Resize(0,false);
     }
     int get_size() const { return m_hb.GetSize(); }
 
@@ -72,26 +88,40 @@ class Net_Message
     int parseMessageHeader(void *data, int len); // returns bytes used, if any (or 0 if more data needed), or -1 if invalid
     int parseBytesNeeded();
     int parseAddBytes(void *data, int len); // returns bytes actually added
+    int parseRecvBytes(JNL_IConnection *con); // reads directly from con into the message, returns bytes added
+
+    static int parseMessageHeaderSize(const void *data, int len); // returns payload size, or -1 if invalid/incomplete
 
     int makeMessageHeader(void *data); // makes message header, returns length. data should be at least 16 bytes to be safe
 
 
-    void addRef() { ++m_refcnt; }
-    void releaseRef() { if (--m_refcnt < 1) delete this; }
+    void addRef() { m_refcnt.fetch_add(1,std::memory_order_relaxed); }
+    void releaseRef() { if (m_refcnt.fetch_sub(1,std::memory_order_acq_rel) <= 1) Free(this); }
 
   private:
+    friend class Net_MessagePool;
+    static void Free(Net_Message *msg);
+
     int m_parsepos;
-    int m_refcnt;
+    std::atomic<int> m_refcnt; // messages may be referenced by download buffers on the audio thread
     int m_type;
     WDL_HeapBuf m_hb;
+    Net_Message *m_poolnext; // Net_MessagePool's returned stack
 };
 
 
 class Net_Connection
 {
   public:
-    Net_Connection() : m_error(0),m_msgsendpos(-1), m_recvstate(0),m_recvmsg(0),m_con(0)
+    Net_Connection() : m_error(0),m_msgsendpos(-1),m_hdrsendpos(0), m_nqueued(0), m_wirebytes(0), m_drr_cur(0), m_drr_fresh(true),
+                       m_recv_timeout_ms(0), m_recv_stalled(false), m_send_stalled(false), m_last_progress(0.0), m_last_progress_bytes(0), m_last_tcpinfo(0.0),
+                       m_recvstate(0),m_recvmsg(0),m_con(0)
     {
+      memset(&m_stats,0,sizeof(m_stats));
+      memset(m_deficit,0,sizeof(m_deficit));
+      memset(&m_health,0,sizeof(m_health));
+      m_health.rtt_ms=m_health.rtt_min_ms=m_health.jitter_ms=-1.0;
+      m_health.tcp_retransmits=-1;
       SetKeepAlive(0);
     }
     ~Net_Connection();
@@ -117,31 +147,94 @@ class Net_Connection
     }
 
     Net_Message *Run(int *wantsleep=0);
-    int Send(Net_Message *msg); // -1 on error, i.e. queue full
+    int Send(Net_Message *msg, int prio=-1); // -1 on error, i.e. queue full. prio<0 picks a NET_CON_PRIO_* from the message type
     int GetStatus(); // returns <0 on error, 0 on normal, 1 on disconnect
     JNL_IConnection *GetConnection() { return m_con; }
 
-    void SetKeepAlive(int interval)
+    void SetKeepAlive(int interval); // seconds, 0 for the default
+
+    // the connection is treated as dead (GetStatus() -3) after this long without receiving
+    // anything. 0 uses three keepalive intervals
+    void SetRecvTimeout(int ms) { m_recv_timeout_ms=ms; }
+
+    enum { RTT_NONE=0, RTT_HANDSHAKE, RTT_TCPINFO };
+    void AddRttSample(double ms, int source);
+
+    struct Health
     {
-      m_keepalive=interval?interval:NET_CON_KEEPALIVE_RATE;
-      m_last_send=m_last_recv=time(NULL);
-    }
+      double rtt_ms, rtt_min_ms; // smoothed round trip time, -1 if unknown
+      double jitter_ms;          // smoothed variation between samples, -1 if unknown
+      int rtt_source;            // RTT_*
+      int recv_gap_ms;           // since anything was last received
+      int max_recv_gap_ms;
+      int recv_stalls;           // nothing received for 1.5 keepalive intervals
+      int send_stalls;           // data waiting but nothing went out for a second
+      int tcp_retransmits;       // from the kernel, -1 if unavailable
+    };
+    const Health &GetHealth() const { return m_health; }
 
     void Kill(int quick=0);
 
+    // socket to wait on between Run() calls, or INVALID_SOCKET if not connected yet.
+    // *wantwrite is set if there is data waiting to be sent
+    SOCKET GetWaitSocket(bool *wantwrite);
+
+    struct Stats
+    {
+      WDL_INT64 send_calls;   // send system calls that wrote data
+      WDL_INT64 bytes_sent;
+      WDL_INT64 bytes_copied; // bytes copied into JNetLib's send buffer rather than sent from message storage
+      WDL_INT64 bytes_queued; // header and payload bytes accepted by Send(), bytes_queued-bytes_sent is the backlog
+
+      struct Prio
+      {
+        WDL_INT64 msgs, bytes;  // fully sent
+        int queued;             // messages waiting, including one partly sent
+        double delay_avg_ms;    // Send() until the last byte went out, smoothed
+        double delay_max_ms;
+      } prio[NET_CON_NUM_PRIO];
+    };
+    const Stats &GetStats() const { return m_stats; }
+
   private:
-    int m_error;
+    struct SendEntry
+    {
+      Net_Message *msg;
+      double queued; // time_precise() at Send()
+      int prio;
+    };
 
-    int m_keepalive;
-    int m_msgsendpos;
+    void schedule();
+    void retireHead();
+    void sendDirect();
+    void updateHealth(double now);
 
-    time_t m_last_send, m_last_recv;
+    int m_error; // -1 bad message header, -2 send queue full, -3 receive timeout, -4 send failed
+
+    int m_keepalive;
+    int m_msgsendpos; // -1 while the header of the message at the top of m_sendq is unsent
+    int m_hdrsendpos; // header bytes already sent
+    int m_nqueued;    // messages in m_prioq and m_sendq
+    int m_wirebytes;  // bytes of the messages in m_sendq, including what's already gone out of the first
+    int m_deficit[NET_CON_NUM_PRIO];
+    int m_drr_cur;
+    bool m_drr_fresh; // m_drr_cur hasn't had its quantum for this round yet
+    Stats m_stats;
+
+    double m_last_send, m_last_recv; // time_precise()
+    int m_recv_timeout_ms;
+    bool m_recv_stalled, m_send_stalled;
+    double m_last_progress; // last time the send backlog was empty or shrank
+    WDL_INT64 m_last_progress_bytes;
+    double m_last_tcpinfo;
+    Health m_health;
 
     int m_recvstate;
     Net_Message *m_recvmsg;
 
     JNL_IConnection *m_con;
-    WDL_Queue m_sendq;
+    WDL_TypedQueue<SendEntry> m_prioq[NET_CON_NUM_PRIO]; // waiting to be scheduled
+    WDL_TypedQueue<SendEntry> m_sendq; // scheduled, sent in order. kept short so higher priorities don't wait long
 
 
 };
@@ -26,13 +26,121 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <thread>
 #include "njclient.h"
 #include "mpb.h"
 #include "../wdl/pcmfmtcvt.h"
 #include "../wdl/wavwrite.h"
 #include "../wdl/wdlcstring.h"
+#include "../wdl/time_precise.h"
 
 #include "../wdl/win32_utf8.h"
+#include "../debug/rt_check.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// keeps buffers the audio thread touches resident. best effort: past RLIMIT_MEMLOCK it just doesn't.
+// mlock() doesn't nest and small buffers share pages, so locked pages are counted process-wide and
+// each owner unlocks what it locked. Release() before freeing or reallocating anything passed to Lock()
+class AudioMemLock
+{
+  public:
+    AudioMemLock() { }
+    ~AudioMemLock() { Release(); }
+
+    void Lock(const void *p, size_t len);
+    void Release();
+
+  private:
+    struct Range { INT_PTR first, last; }; // page addresses
+    WDL_TypedBuf<Range> m_ranges;
+};
+
+#ifdef __linux__
+struct LockedPages
+{
+  LockedPages() : pagesize((INT_PTR)sysconf(_SC_PAGESIZE)) { }
+  WDL_Mutex mutex;
+  WDL_PtrKeyedArray<int> count; // page address -> owners
+  INT_PTR pagesize;
+};
+static LockedPages *lockedPages()
+{
+  static LockedPages *p=new LockedPages; // leaked: owners can outlive static destructors
+  return p;
+}
+
+void AudioMemLock::Lock(const void *p, size_t len)
+{
+  if (!p || !len) return;
+  LockedPages *lp=lockedPages();
+  Range r;
+  r.first=(INT_PTR)p & ~(lp->pagesize-1);
+  r.last=((INT_PTR)p+(INT_PTR)len-1) & ~(lp->pagesize-1);
+
+  WDL_MutexLock lock(&lp->mutex);
+  for (INT_PTR pg=r.first; pg<=r.last; pg+=lp->pagesize)
+  {
+    int *c=lp->count.GetPtr(pg);
+    if (c) ++*c;
+    else
+    {
+      mlock((void*)pg,lp->pagesize);
+      lp->count.Insert(pg,1);
+    }
+  }
+  m_ranges.Add(r);
+}
+
+void AudioMemLock::Release()
+{
+  if (!m_ranges.GetSize()) return;
+  LockedPages *lp=lockedPages();
+  WDL_MutexLock lock(&lp->mutex);
+  for (int x = 0; x < m_ranges.GetSize(); x ++)
+  {
+    const Range &r=m_ranges.Get()[x];
+    for (INT_PTR pg=r.first; pg<=r.last; pg+=lp->pagesize)
+    {
+      int *c=lp->count.GetPtr(pg);
+      if (WDL_NOT_NORMALLY(!c)) continue;
+      if (--*c > 0) continue;
+      munlock((void*)pg,lp->pagesize);
+      lp->count.Delete(pg);
+    }
+  }
+  m_ranges.Resize(0,false);
+}
+#else
+void AudioMemLock::Lock(const void *p, size_t len) { (void)p; (void)len; }
+void AudioMemLock::Release() { }
+#endif
+
+// debug builds: once PrepareAudio() has sized things, AudioProc marks its thread and the
+// growth points below assert if they have to allocate anyway
+#if defined(_DEBUG) || defined(DEBUG)
+static thread_local bool s_audio_growth_check;
+struct AudioGrowthScope
+{
+  explicit AudioGrowthScope(bool on) { s_audio_growth_check=on; }
+  ~AudioGrowthScope() { s_audio_growth_check=false; }
+};
+// for work on the audio thread that is sized by the data, not the block
+struct AudioGrowthExempt
+{
+  AudioGrowthExempt() : m_was(s_audio_growth_check) { s_audio_growth_check=false; }
+  ~AudioGrowthExempt() { s_audio_growth_check=m_was; }
+  bool m_was;
+};
+#define NJ_AUDIO_GROWTH(what) WDL_ASSERT(!s_audio_growth_check && what)
+#else
+struct AudioGrowthScope { explicit AudioGrowthScope(bool) { } };
+struct AudioGrowthExempt { AudioGrowthExempt() { } };
+#define NJ_AUDIO_GROWTH(what) do { } while (0)
+#endif
 
 #define NJ_ENCODER_FMT_TYPE MAKE_NJ_FOURCC('O','G','G','v')
 
@@ -88,48 +196,533 @@
 
 #define MAKE_NJ_FOURCC(A,B,C,D) ((A) | ((B)<<8) | ((C)<<16) | ((D)<<24))
 
+// Compressed interval data as a list of chunks. Downloaded chunks reference the received
+// Net_Message payload directly rather than being copied.
+// There is one writer (the network thread); readers don't lock. A full chunk table is
+// copied into one twice its size and the old table is kept until the buffer is freed,
+// so a reader holding a stale table still sees valid chunks.
 class DecodeMediaBuffer
 {
 public:
   DecodeMediaBuffer()
   {
     refcnt=1;
-    rdpos=0;
+    m_size=0;
+    m_nchunks=0;
+    m_tab=NULL;
+    m_tab_alloc=0;
   }
   ~DecodeMediaBuffer()
   {
+    Chunk *tab=m_tab.load(std::memory_order_relaxed);
+    const int n=m_nchunks.load(std::memory_order_relaxed);
+    for (int x = 0; x < n; x ++) tab[x].msg->releaseRef();
+    free(tab);
+    for (int x = 0; x < m_oldtabs.GetSize(); x ++) free(m_oldtabs.Get(x));
+  }
+  // cached buffers are released from both the audio and network threads
+  void AddRef() { refcnt.fetch_add(1,std::memory_order_relaxed); }
+  void Release() { if (refcnt.fetch_sub(1,std::memory_order_acq_rel) == 1) delete this; }
+
+  // buf must point into msg's payload; msg is referenced until the buffer is freed
+  void WriteRef(Net_Message *msg, const void *buf, int len)
+  {
+    if (len < 1) return;
+    const int n=m_nchunks.load(std::memory_order_relaxed);
+    Chunk *tab=m_tab.load(std::memory_order_relaxed);
+    if (n >= m_tab_alloc)
+    {
+      const int na=m_tab_alloc ? m_tab_alloc*2 : 32;
+      Chunk *nt=(Chunk *)malloc(na*sizeof(Chunk));
+      if (!nt) return;
+      if (n) memcpy(nt,tab,n*sizeof(Chunk));
+      if (tab) m_oldtabs.Add(tab);
+      m_tab.store(nt,std::memory_order_release);
+      m_tab_alloc=na;
+      tab=nt;
+    }
+    msg->addRef();
+    const int start=m_size.load(std::memory_order_relaxed);
+    Chunk c = { msg, (const char *)buf, start, len };
+    tab[n]=c;
+    m_nchunks.store(n+1,std::memory_order_release);
+    m_size.store(start+len,std::memory_order_release);
   }
-  void AddRef() { refcnt++; }
-  void Release() { if (!--refcnt) delete this; }
 
   void Write(const void *buf, int len)
   {
-    mutex.Enter();
-    m_buf.Add(buf,len);
-    mutex.Leave();
+    if (len < 1) return;
+    Net_Message *msg=Net_Message::Alloc(len);
+    msg->set_size(len);
+    if (msg->get_data())
+    {
+      memcpy(msg->get_data(),buf,len);
+      WriteRef(msg,msg->get_data(),len);
+    }
+    else
+      msg->releaseRef(); // never referenced, goes back to the pool
   }
 
-  int Avail() { return m_buf.Available() - rdpos; }
-  int Size() { return m_buf.Available(); }
-  int Read(void *buf, int len)
+  int Size() { return m_size.load(std::memory_order_acquire); }
+
+  // each reader keeps its own position, so one buffer can feed several decoders
+  // (a session channel may decode the same interval again after a seek)
+  int ReadAt(int pos, void *buf, int len)
   {
-    mutex.Enter();
-    int l=Avail();
-    if (l >len)l=len;
-    if (l>0)
+    // the count is published after its chunk and after any table it lives in
+    const int n=m_nchunks.load(std::memory_order_acquire);
+    const Chunk *chunks=m_tab.load(std::memory_order_acquire);
+    if (n < 1 || pos < 0 || pos >= chunks[n-1].start+chunks[n-1].len) return 0;
+
+    // chunks are in stream order, find the one containing pos
+    int lo=0, hi=n-1;
+    while (lo < hi)
+    {
+      const int mid=(lo+hi+1)/2;
+      if (chunks[mid].start <= pos) lo=mid;
+      else hi=mid-1;
+    }
+    int rd=0;
+    for (int x = lo; x < n && rd < len; x ++)
     {
-      memcpy(buf,(char *)m_buf.Get()+rdpos,l);
-      rdpos+=l;
+      const int offs=pos+rd-chunks[x].start;
+      int l=wdl_min(chunks[x].len-offs,len-rd);
+      memcpy((char *)buf+rd,chunks[x].data+offs,l);
+      rd+=l;
     }
-    mutex.Leave();
-    return l;
+    return rd;
+  }
+
+  bool WriteToFile(FILE *fp)
+  {
+    const int n=m_nchunks.load(std::memory_order_acquire);
+    const Chunk *chunks=m_tab.load(std::memory_order_acquire);
+    bool ok=true;
+    for (int x = 0; ok && x < n; x ++)
+      ok = (int)fwrite(chunks[x].data,1,chunks[x].len,fp) == chunks[x].len;
+    return ok;
   }
 
 private:
-  WDL_Mutex mutex;
-  int rdpos;
-  int refcnt;
-  WDL_Queue m_buf;
+  struct Chunk
+  {
+    Net_Message *msg;
+    const char *data;
+    int start, len;
+  };
+
+  std::atomic<int> refcnt;
+  std::atomic<int> m_size, m_nchunks;
+  std::atomic<Chunk *> m_tab;
+  int m_tab_alloc;
+  WDL_PtrList<Chunk> m_oldtabs; // superseded tables, readers may still be using them
+};
+
+
+// Size-bounded, least-recently-used store of compressed session-mode intervals,
+// keyed by GUID. Downloads for session channels are written here instead of to disk;
+// start_decode() looks here before falling back to a file. Entries are evicted
+// (optionally spilling to the GUID file) once they are complete and the budget is exceeded.
+class IntervalCache
+{
+public:
+  IntervalCache() : m_bytes(0), m_hits(0), m_misses(0), m_spills(0) { }
+  ~IntervalCache() { Clear(NULL,false); }
+
+  // returns a referenced buffer for the caller to fill, or NULL if the GUID is already cached
+  DecodeMediaBuffer *Insert(const unsigned char *guid, unsigned int fourcc)
+  {
+    WDL_MutexLock lock(&m_mutex);
+    if (find(guid) >= 0) return NULL;
+
+    Entry *e=new Entry;
+    memcpy(e->guid,guid,sizeof(e->guid));
+    e->buf=new DecodeMediaBuffer;
+    e->fourcc=fourcc;
+    e->size=0;
+    e->complete=false;
+    m_lru.Add(e);
+
+    e->buf->AddRef();
+    return e->buf;
+  }
+
+  // returns a referenced buffer, or NULL
+  DecodeMediaBuffer *Lookup(const unsigned char *guid)
+  {
+    m_mutex.Enter();
+
+    DecodeMediaBuffer *ret=NULL;
+    const int idx=find(guid);
+    if (idx < 0) m_misses++;
+    else
+    {
+      m_hits++;
+      Entry *e=m_lru.Get(idx);
+      m_lru.Delete(idx); // move to most-recently-used, list capacity is unchanged
+      m_lru.Add(e);
+      e->buf->AddRef();
+      ret=e->buf;
+    }
+    m_mutex.Leave();
+    return ret;
+  }
+
+  void NoteWrite(const unsigned char *guid, int len)
+  {
+    WDL_MutexLock lock(&m_mutex);
+    const int idx=find(guid);
+    if (idx >= 0)
+    {
+      m_lru.Get(idx)->size += len;
+      m_bytes += len;
+    }
+  }
+
+  void SetComplete(const unsigned char *guid)
+  {
+    WDL_MutexLock lock(&m_mutex);
+    const int idx=find(guid);
+    if (idx >= 0) m_lru.Get(idx)->complete=true;
+  }
+
+  // evicts least-recently-used complete entries until resident bytes fit maxbytes.
+  // Files are written without holding the lock, and entries stay visible to Lookup()
+  // until their file exists.
+  void Trim(NJClient *parent, WDL_INT64 maxbytes, bool spill)
+  {
+    if (!parent) spill=false;
+    WDL_PtrList<Entry> victims;
+    {
+      WDL_MutexLock lock(&m_mutex);
+      WDL_INT64 bytes=m_bytes;
+      for (int x = 0; bytes > maxbytes && x < m_lru.GetSize(); x ++)
+      {
+        Entry *e=m_lru.Get(x);
+        if (!e->complete) continue;
+        bytes -= e->size;
+
+        Entry *v=new Entry(*e);
+        v->buf->AddRef();
+        victims.Add(v);
+      }
+    }
+    if (!victims.GetSize()) return;
+
+    int spilled=0;
+    if (spill)
+      for (int x = 0; x < victims.GetSize(); x ++)
+        if (spillEntry(parent,victims.Get(x))) spilled++;
+
+    {
+      WDL_MutexLock lock(&m_mutex);
+      m_spills+=spilled;
+      for (int x = 0; x < victims.GetSize(); x ++)
+      {
+        // a Clear() may have happened while spilling
+        const int idx=find(victims.Get(x)->guid);
+        Entry *e=m_lru.Get(idx);
+        if (!e || e->buf != victims.Get(x)->buf) continue;
+        m_bytes -= e->size;
+        e->buf->Release(); // victims still holds a reference, freed below
+        delete e;
+        m_lru.Delete(idx);
+      }
+    }
+    for (int x = 0; x < victims.GetSize(); x ++) victims.Get(x)->buf->Release();
+    victims.Empty(true);
+  }
+
+  // drops every entry, writing complete ones to their GUID files first if spill is set
+  void Clear(NJClient *parent, bool spill)
+  {
+    WDL_PtrList<Entry> old;
+    {
+      WDL_MutexLock lock(&m_mutex);
+      for (int x = 0; x < m_lru.GetSize(); x ++) old.Add(m_lru.Get(x));
+      m_lru.Empty();
+      m_bytes=0;
+    }
+
+    int spilled=0;
+    for (int x = 0; x < old.GetSize(); x ++)
+    {
+      Entry *e=old.Get(x);
+      if (spill && parent && e->complete && spillEntry(parent,e)) spilled++;
+      e->buf->Release();
+    }
+    old.Empty(true);
+
+    if (spilled)
+    {
+      WDL_MutexLock lock(&m_mutex);
+      m_spills+=spilled;
+    }
+  }
+
+  void GetStats(NJClient::IntervalCacheStats *st)
+  {
+    WDL_MutexLock lock(&m_mutex);
+    st->hits=m_hits;
+    st->misses=m_misses;
+    st->spills=m_spills;
+    st->entries=m_lru.GetSize();
+    st->bytes_resident=m_bytes;
+  }
+
+private:
+  struct Entry
+  {
+    unsigned char guid[16];
+    unsigned int fourcc;
+    DecodeMediaBuffer *buf;
+    int size;
+    bool complete;
+  };
+
+  int find(const unsigned char *guid) const
+  {
+    // most recently used entries are at the end, and are the most likely to be asked for
+    for (int x = m_lru.GetSize()-1; x >= 0; x --)
+      if (!memcmp(m_lru.Get(x)->guid,guid,sizeof(Entry::guid))) return x;
+    return -1;
+  }
+
+  bool spillEntry(NJClient *parent, Entry *e); // call without m_mutex held
+
+  WDL_Mutex m_mutex;
+  WDL_PtrList<Entry> m_lru; // least recently used first
+  WDL_INT64 m_bytes;
+  int m_hits, m_misses, m_spills;
+};
+
+// A fully decoded session-mode interval. Immutable once published, shared by refcount.
+struct PcmBlock
+{
+  PcmBlock() : refcnt(1), lastuse(0), nch(0), srate(0) { memset(guid,0,sizeof(guid)); }
+
+  void AddRef() { refcnt.fetch_add(1,std::memory_order_relaxed); }
+  void Release() { if (refcnt.fetch_sub(1,std::memory_order_acq_rel) == 1) delete this; }
+
+  std::atomic<int> refcnt;
+  std::atomic<unsigned int> lastuse; // PcmCache tick of the last Lookup()
+  unsigned char guid[16];
+  int nch, srate;
+  WDL_TypedBuf<float> samples; // interleaved
+};
+
+class DecodeState;
+
+// Memory-budgeted LRU of decoded session-mode intervals, keyed by GUID. Filled by Run(),
+// so a looping session doesn't decode the same intervals again. On a hit the audio thread
+// binds a block to a decoder Run() allocated ahead of time (see takeSessionDecode()) and
+// copies samples out of it; misses are decoded by Run() too.
+// Lookup() runs on the audio thread and doesn't lock: blocks are published in a fixed
+// slot table, and the Run() thread only drops its reference to an unpublished block
+// once no Lookup() is in progress, so the audio thread never frees one.
+class PcmCache
+{
+public:
+  enum { MAX_BLOCKS=64, FILL_SLICES=8, FILL_SLICE_BYTES=4096 };
+
+  PcmCache() : m_readers(0), m_tick(0), m_hits(0), m_misses(0), m_bytes(0), m_cur(NULL)
+  {
+    for (int x = 0; x < MAX_BLOCKS; x ++) m_slots[x]=NULL;
+    memset(m_curguid,0,sizeof(m_curguid));
+  }
+  ~PcmCache() { Clear(); }
+
+  // queue an interval for decoding in Run()
+  void Request(const unsigned char *guid)
+  {
+    WDL_MutexLock lock(&m_mutex);
+    if (findSlot(guid) >= 0) return;
+    if (m_cur && !memcmp(m_curguid,guid,16)) return;
+    const int n=m_pending.GetSize()/16;
+    for (int x = 0; x < n; x ++)
+      if (!memcmp(m_pending.Get()+x*16,guid,16)) return;
+    memcpy(m_pending.ResizeOK(n*16+16,false)+n*16,guid,16);
+  }
+
+  // audio thread: returns a referenced block, or NULL
+  PcmBlock *Lookup(const unsigned char *guid)
+  {
+    m_readers.fetch_add(1,std::memory_order_seq_cst);
+    PcmBlock *ret=NULL;
+    for (int x = 0; x < MAX_BLOCKS; x ++)
+    {
+      PcmBlock *b=m_slots[x].load(std::memory_order_acquire);
+      if (b && !memcmp(b->guid,guid,16))
+      {
+        b->AddRef();
+        b->lastuse.store(m_tick.fetch_add(1,std::memory_order_relaxed)+1,std::memory_order_relaxed);
+        ret=b;
+        break;
+      }
+    }
+    m_readers.fetch_sub(1,std::memory_order_seq_cst);
+
+    (ret ? m_hits : m_misses).fetch_add(1,std::memory_order_relaxed);
+    return ret;
+  }
+
+  // Run() thread: decodes a bounded slice of the current interval, publishing it when done.
+  // returns true if more work is pending
+  bool Fill(NJClient *parent, WDL_INT64 maxbytes);
+
+  void Trim(WDL_INT64 maxbytes)
+  {
+    WDL_MutexLock lock(&m_mutex);
+    while (m_bytes > maxbytes && evictLRU()) { }
+    reclaim();
+  }
+
+  void Clear()
+  {
+    WDL_MutexLock lock(&m_mutex);
+    abortDecode();
+    for (int x = 0; x < MAX_BLOCKS; x ++) unpublish(x);
+    m_pending.Resize(0,false);
+    reclaim();
+  }
+
+  void GetStats(NJClient::PcmCacheStats *st)
+  {
+    WDL_MutexLock lock(&m_mutex);
+    st->hits=m_hits.load(std::memory_order_relaxed);
+    st->misses=m_misses.load(std::memory_order_relaxed);
+    st->entries=0;
+    for (int x = 0; x < MAX_BLOCKS; x ++) if (m_slots[x].load(std::memory_order_relaxed)) st->entries++;
+    st->pending=m_pending.GetSize()/16 + (m_cur?1:0);
+    st->bytes_resident=m_bytes;
+  }
+
+private:
+  static WDL_INT64 blockBytes(const PcmBlock *b) { return b->samples.GetSize()*(WDL_INT64)sizeof(float); }
+
+  // the following are called with m_mutex held, from the thread that runs Fill()
+  int findSlot(const unsigned char *guid) const
+  {
+    for (int x = 0; x < MAX_BLOCKS; x ++)
+    {
+      const PcmBlock *b=m_slots[x].load(std::memory_order_relaxed);
+      if (b && !memcmp(b->guid,guid,16)) return x;
+    }
+    return -1;
+  }
+
+  void unpublish(int slot)
+  {
+    PcmBlock *b=m_slots[slot].exchange(NULL,std::memory_order_seq_cst);
+    if (!b) return;
+    m_bytes -= blockBytes(b);
+    m_retired.Add(b);
+  }
+
+  bool evictLRU()
+  {
+    int best=-1;
+    unsigned int bestuse=0;
+    const unsigned int now=m_tick.load(std::memory_order_relaxed);
+    for (int x = 0; x < MAX_BLOCKS; x ++)
+    {
+      const PcmBlock *b=m_slots[x].load(std::memory_order_relaxed);
+      if (!b) continue;
+      const unsigned int age=now - b->lastuse.load(std::memory_order_relaxed);
+      if (best < 0 || age > bestuse) { best=x; bestuse=age; }
+    }
+    if (best < 0) return false;
+    unpublish(best);
+    return true;
+  }
+
+  // drops the cache's reference to unpublished blocks once no Lookup() can still see them
+  void reclaim()
+  {
+    if (!m_retired.GetSize() || m_readers.load(std::memory_order_seq_cst) != 0) return;
+    for (int x = 0; x < m_retired.GetSize(); x ++) m_retired.Get(x)->Release();
+    m_retired.Empty();
+  }
+
+  void publish(PcmBlock *blk, WDL_INT64 maxbytes);
+  void abortDecode();
+
+  std::atomic<PcmBlock *> m_slots[MAX_BLOCKS];
+  std::atomic<int> m_readers;
+  std::atomic<unsigned int> m_tick;
+  std::atomic<int> m_hits, m_misses;
+
+  WDL_Mutex m_mutex; // Run()-side state below, never taken by Lookup()
+  WDL_PtrList<PcmBlock> m_retired; // unpublished, still referenced by the cache
+  WDL_TypedBuf<unsigned char> m_pending; // 16-byte GUIDs waiting to be decoded
+  WDL_INT64 m_bytes;
+
+  DecodeState *m_cur; // interval being decoded across Fill() calls
+  unsigned char m_curguid[16];
+};
+
+// Plays a PcmBlock through the decoder interface. Samples are copied into a private
+// window, since mixInChannel()/applyOverlap() modify what Get() returns in place.
+// Created without a block, it is a spare for the audio thread to Bind() later.
+class PcmCacheDecoder : public I_NJDecoder
+{
+public:
+  PcmCacheDecoder(PcmBlock *blk) : m_blk(blk), m_rdpos(0), m_winpos(0)
+  {
+    if (m_blk) m_blk->AddRef();
+    m_win.Prealloc(WINDOW_FRAMES*2*(m_blk ? wdl_max(m_blk->nch,1) : 2));
+  }
+  virtual ~PcmCacheDecoder() { if (m_blk) m_blk->Release(); }
+
+  // takes over a referenced block, only on a spare (no block yet): doesn't allocate or free
+  void Bind(PcmBlock *blk)
+  {
+    WDL_ASSERT(!m_blk);
+    m_blk=blk;
+    Reset();
+  }
+
+  virtual int GetSampleRate() { return m_blk ? m_blk->srate : 0; }
+  virtual int GetNumChannels() { return m_blk ? m_blk->nch : 0; }
+
+  // not fed compressed data, see Pull()
+  virtual void *DecodeGetSrcBuffer(int srclen) { return NULL; }
+  virtual void DecodeWrote(int srclen) { }
+
+  virtual void Reset() { m_rdpos=m_winpos=0; m_win.Resize(0,false); }
+  virtual int Available() { return m_win.GetSize()-m_winpos; }
+  virtual float *Get() { return m_win.Get()+m_winpos; }
+  virtual void Skip(int amt) { m_winpos=wdl_min(m_winpos+amt,m_win.GetSize()); }
+  virtual int GenerateLappingSamples() { return 0; }
+
+  // copies up to frames more samples into the window, returns true at end of block
+  bool Pull(int frames)
+  {
+    if (!m_blk) return true;
+    const int nch=m_blk->nch;
+    int len=wdl_min(frames*nch,m_blk->samples.GetSize()-m_rdpos);
+    if (len <= 0) return true;
+
+    int keep=m_win.GetSize()-m_winpos;
+    if (keep+len > m_win.GetAlloc()) NJ_AUDIO_GROWTH("PcmCacheDecoder window grew");
+    if (m_winpos)
+    {
+      if (keep > 0) memmove(m_win.Get(),m_win.Get()+m_winpos,keep*sizeof(float));
+      m_winpos=0;
+    }
+    float *p=m_win.ResizeOK(keep+len,false);
+    if (!p) return true;
+    memcpy(p+keep,m_blk->samples.Get()+m_rdpos,len*sizeof(float));
+    m_rdpos+=len;
+    return false;
+  }
+
+private:
+  enum { WINDOW_FRAMES=4096 };
+
+  PcmBlock *m_blk;
+  int m_rdpos, m_winpos;
+  WDL_TypedBuf<float> m_win;
 };
 
 struct overlapFadeState {
@@ -144,9 +737,9 @@ struct overlapFadeState {
 class DecodeState
 {
   public:
-    DecodeState() : decode_fp(0), decode_buf(0), decode_codec(0),
+    DecodeState() : decode_fp(0), decode_buf(0), decode_buf_pos(0), decode_pcm(0), decode_codec(0),
                                            resample_state(0.0),
-                                           is_voice_firstchk(false)
+                                           is_voice_firstchk(false), retire_next(0)
     {
       memset(guid,0,sizeof(guid));
     }
@@ -158,6 +751,7 @@ class DecodeState
       decode_fp=0;
       if (decode_buf) decode_buf->Release();
       decode_buf=0;
+      decode_pcm=0; // owned by decode_codec
 
     }
 
@@ -165,10 +759,13 @@ class DecodeState
 
     FILE *decode_fp;
     DecodeMediaBuffer *decode_buf;
+    int decode_buf_pos;
+    PcmCacheDecoder *decode_pcm; // when set, this is also decode_codec
     I_NJDecoder *decode_codec;
     double resample_state;
 
     bool is_voice_firstchk;
+    DecodeState *retire_next; // see NJClient::retireDecodeState()
 
     void applyOverlap(overlapFadeState *s)
     {
@@ -228,8 +825,29 @@ class DecodeState
         }
       }
     }
+    bool HasSource() const { return decode_fp || decode_buf || decode_pcm; }
+
+    // the stock decoder's output queue. REANINJAM's decoders come from the host and are left alone
+    enum { DECODE_BURST_FRAMES=8192 }; // what one runDecode() can add: a couple of long Vorbis blocks
+    void preallocOutput(int frames)
+    {
+#ifndef REANINJAM
+      if (decode_codec && !decode_pcm) ((VorbisDecoder *)decode_codec)->PreallocOutput(frames*decode_codec->GetNumChannels());
+#else
+      (void)frames;
+#endif
+    }
+    int outputAlloc() const
+    {
+#ifndef REANINJAM
+      if (decode_codec && !decode_pcm) return ((VorbisDecoder *)decode_codec)->OutputAlloc();
+#endif
+      return 0;
+    }
+
     bool runDecode(int sz=1024) // return true if eof
     {
+      if (decode_pcm) return decode_pcm->Pull(sz);
       if (!decode_fp && !decode_buf) return true;
 
       int l;
@@ -243,10 +861,18 @@ class DecodeState
       }
       else
       {
-        l=decode_buf->Read(srcbuf,sz);
+        l=decode_buf->ReadAt(decode_buf_pos,srcbuf,sz);
+        decode_buf_pos+=l;
       }
 
-      decode_codec->DecodeWrote(l);
+      const int oldalloc=outputAlloc();
+      {
+        // libogg/libvorbis size their internal buffers from the stream as packets arrive; the
+        // output queue they fill is ours and is checked below
+        JAMWIDE_RT_EXEMPT();
+        decode_codec->DecodeWrote(l);
+      }
+      if (outputAlloc() > oldalloc) NJ_AUDIO_GROWTH("decoder output queue grew");
 
       return !l;
     }
@@ -283,6 +909,7 @@ class RemoteUser_Channel
     int out_chan_index;
 
     int flags;
+    unsigned int version; // NJClient::m_remote_version this channel last changed at
 
     WDL_String name;
 
@@ -291,12 +918,23 @@ class RemoteUser_Channel
     DecodeState *ds;
     DecodeState *next_ds[2]; // prepared by main thread, for audio thread
 
+    // session mode: mixInChannel() asks for the interval playing at session_want (-1 if none)
+    // and Run() decodes it into session_ready. session_spare is an unbound PcmCacheDecoder
+    // state the audio thread can use for a PcmCache hit. all three are protected by m_users_cs
+    double session_want;
+    DecodeState *session_ready, *session_spare;
+
     double decode_peak_vol[2];
+    // for the meter, this block's pre-volume sum of squares over decode_meter_n samples
+    double decode_sumsq[2];
+    int decode_meter_n, decode_clip;
 
     double curds_lenleft;
 
     void AddSessionInfo(const unsigned char *guid, double st, double len);
-    bool GetSessionInfo(double time, unsigned char *guid, double *offs, double *len, double mv);
+    // nowait is set by the audio thread: if Run() is changing the list, returns false with *len=0
+    // (nothing to play for now) rather than waiting for it
+    bool GetSessionInfo(double time, unsigned char *guid, double *offs, double *len, double mv, bool nowait=false);
     double GetMaxLength()
     {
       ChannelSessionInfo *p=sessioninfo.Get(sessioninfo.GetSize()-1);
@@ -311,6 +949,8 @@ class RemoteUser_Channel
     }
 
   private:
+    bool findSessionInfo(double time, unsigned char *guid, double *offs, double *len, double mv); // sessionlist_mutex held
+
     WDL_Mutex sessionlist_mutex;
     WDL_PtrList<ChannelSessionInfo> sessioninfo;
 
@@ -320,7 +960,7 @@ class RemoteUser_Channel
 class RemoteUser
 {
 public:
-  RemoteUser() : muted(0), volume(1.0f), pan(0.0f), submask(0), mutedmask(0), solomask(0), last_session_pos(-1.0), last_session_pos_updtime(0), chanpresentmask(0) { }
+  RemoteUser() : muted(0), volume(1.0f), pan(0.0f), submask(0), mutedmask(0), solomask(0), last_session_pos(-1.0), last_session_pos_updtime(0), chanpresentmask(0), stats_slot(-1), submask_dirty(false), reconnect_seen(0), version(0) { }
   ~RemoteUser() { }
 
   bool muted;
@@ -333,6 +973,12 @@ public:
   int solomask;
   double last_session_pos;
   time_t last_session_pos_updtime;
+  int stats_slot; // index into NJClient::m_peerstats, -1 if none
+  bool submask_dirty; // submask needs to be sent to the server
+  unsigned int reconnect_seen; // channels the server has listed since the last reconnect
+  unsigned int version; // NJClient::m_remote_version the user's own state last changed at
+
+  NJArrivalEstimator arrival; // see NJClient::getPlayPrebuffer()
   RemoteUser_Channel channels[MAX_USER_CHANNELS];
 };
 
@@ -345,21 +991,31 @@ public:
 
   void Close();
   void Open(NJClient *parent, unsigned int fourcc, bool forceToDisk);
-  void Write(const void *buf, int len);
+  void Write(const void *buf, int len, Net_Message *src=NULL); // if src is set, buf points into its payload and is referenced rather than copied
   void startPlaying(int force=0); // call this with 1 to make sure it gets played ASAP, or let RemoteDownload call it automatically
 
   time_t last_time;
   unsigned char guid[16];
+  int wheel_slot; // index into NJClient::m_download_wheel, -1 if not scheduled
 
   int chidx;
   WDL_String username;
   int playtime;
 
+  // arrival timing, time_precise() seconds, 0 if it didn't happen
+  double t_begin, t_first, t_last, t_play;
+  double t_needed; // local interval boundary this was needed for, 0 if not tied to one
+  double max_gap;  // longest time between two data messages
+  WDL_INT64 bytes;
+  bool completed;
+
 private:
   unsigned int m_fourcc;
   NJClient *m_parent;
   FILE *m_fp;
   DecodeMediaBuffer *m_decbuf;
+  bool m_cached; // m_decbuf is owned by m_parent->m_intervalcache
+  bool m_session;
 };
 
 
@@ -367,15 +1023,20 @@ private:
 class BufferQueue
 {
   public:
-    BufferQueue() { }
+    BufferQueue() { JAMWIDE_RT_ALLOW_LOCK(&m_cs); } // AddBlock() runs on the audio thread
     ~BufferQueue()
     {
       Clear();
+      JAMWIDE_RT_FORBID_LOCK(&m_cs);
     }
 
+    enum { MAX_QUEUED_BLOCKS=512 }; // AddBlock drops audio past this many
+
     void AddBlock(int attr, double blockstart, float *samples, int len, float *samples2=NULL);
     int GetBlock(WDL_HeapBuf **b, int *attr=NULL, double *startpos=NULL); // return 0 if got one, 1 if none avail
     void DisposeBlock(WDL_HeapBuf *b);
+    // fill the free pools so AddBlock() of up to blockbytes doesn't allocate while nblocks are queued
+    void Prealloc(int nblocks, int blockbytes);
 
     typedef struct
     {
@@ -383,8 +1044,23 @@ class BufferQueue
       double startpos;
     } AttrStruct;
 
+    // drops whatever is queued but keeps the blocks pooled for AddBlock()
+    void Flush()
+    {
+      m_cs.Enter();
+      for (int x = 0; x < m_samplequeue.GetSize(); x += 2)
+      {
+        WDL_HeapBuf *b=m_samplequeue.Get(x), *a=m_samplequeue.Get(x+1);
+        if (b && b != (WDL_HeapBuf*)-1) m_emptybufs.Add(b);
+        if (a) m_emptybufs_attr.Add(a);
+      }
+      m_samplequeue.Empty();
+      m_cs.Leave();
+    }
+
     void Clear()
     {
+      m_locked.Release();
       m_emptybufs.Empty(true);
       m_emptybufs_attr.Empty(true);
       m_samplequeue.Empty(true);
@@ -395,6 +1071,7 @@ class BufferQueue
     WDL_PtrList<WDL_HeapBuf> m_emptybufs;
     WDL_PtrList<WDL_HeapBuf> m_emptybufs_attr;
     WDL_Mutex m_cs;
+    AudioMemLock m_locked; // Prealloc()'s pools, released on Clear() or the next Prealloc()
 };
 
 
@@ -436,9 +1113,22 @@ public:
 
 #ifndef NJCLIENT_NO_XMIT_SUPPORT
   I_NJEncoder  *m_enc;
-  int m_enc_bitrate_used;
+  int m_enc_bitrate_used; // kbps before the stereo allowance
   int m_enc_nch_used;
+  I_NJEncoder  *m_enc_next; // built ahead of the boundary where the bitrate changes
+  int m_enc_next_bitrate;
+  int m_enc_next_nch;
   Net_Message *m_enc_header_needsend;
+  int m_send_prio; // NET_CON_PRIO_* for the interval being sent, fixed at its start so its messages stay in order
+
+  // the class for messages starting an interval (or the zero-GUID begin ending one). on a change of
+  // mode it only moves once nothing is queued in the old class, so the channel's messages stay in order
+  int UpdateSendPrio(Net_Connection *con)
+  {
+    const int want=(flags&2) ? NET_CON_PRIO_VOICE : NET_CON_PRIO_BULK;
+    if (want != m_send_prio && !con->GetStats().prio[m_send_prio].queued) m_send_prio=want;
+    return m_send_prio;
+  }
 #endif
 
   WDL_String name;
@@ -459,8 +1149,12 @@ public:
 
 #define MIN_ENC_BLOCKSIZE 2048
 #define MAX_ENC_BLOCKSIZE (8192+1024)
-#define DEFAULT_CONFIG_PREBUFFER  8192
-#define LIVE_PREBUFFER 128
+#define DEFAULT_INTERVAL_CACHE_BYTES (32*1024*1024)
+
+#define UPLOAD_BACKLOG_MAX_SEC 1.0     // step the upload bitrate down once this much data is waiting to go out
+#define UPLOAD_BACKLOG_MIN_BYTES 8192  // ...and at least this much
+#define UPLOAD_GOOD_INTERVALS 3        // intervals with an empty backlog before stepping back up
+static const int upload_rate_steps[]={ 100, 80, 64, 50, 40, 32, 25 }; // percent of the configured bitrate
 #define LIVE_ENC_BLOCKSIZE1 2048
 #define LIVE_ENC_BLOCKSIZE2 64
 
@@ -469,6 +1163,11 @@ public:
 
 static unsigned char zero_guid[16];
 
+static int guidkey_cmp(const unsigned char * const *a, const unsigned char * const *b)
+{
+  return memcmp(*a,*b,16);
+}
+
 
 static void guidtostr(const unsigned char *guid, char *str)
 {
@@ -565,12 +1264,24 @@ void NJClient::makeFilenameFromGuid(WDL_String *s, unsigned char *guid)
 
 
 
-NJClient::NJClient()
+NJClient::NJClient() : m_downloads(guidkey_cmp)
 {
+  time(&m_download_wheel_time);
+  for (int x = 0; x < PEER_STATS_MAX; x ++)
+  {
+    m_peerstats[x].seq.store(0,std::memory_order_relaxed);
+    memset(&m_peerstats[x].st,0,sizeof(m_peerstats[x].st));
+  }
   m_wavebq=new BufferQueue;
+  m_audiomem=new AudioMemLock;
+  m_intervalcache=new IntervalCache;
+  m_pcmcache=new PcmCache;
   m_userinfochange=0;
+  m_remote_version.store(1,std::memory_order_relaxed); // views start at 0, so the first update copies everything
+  m_remote_layout_version=1;
   m_loopcnt=0;
   m_srate=48000;
+  m_audio_maxlen=m_audio_prep_srate=0;
 #ifdef _WIN32
   DWORD v=GetTickCount();
   WDL_RNG_addentropy(&v,sizeof(v));
@@ -593,6 +1304,34 @@ NJClient::NJClient()
   config_mastermute.store(false, std::memory_order_relaxed);
   config_play_prebuffer.store(DEFAULT_CONFIG_PREBUFFER, std::memory_order_relaxed);
   config_remote_autochan = config_remote_autochan_nch = 0;
+  config_interval_cache_bytes=DEFAULT_INTERVAL_CACHE_BYTES;
+  config_interval_cache_spill=1;
+  config_pcm_cache_bytes=0;
+  m_chaninfo_dirty=false;
+  m_submask_dirty=false;
+  config_upload_adapt=1;
+  config_upload_bitrate_min=32;
+  config_upload_bitrate_max=256;
+  config_halfopen_timeout_ms=0;
+  config_auto_reconnect=8;
+  m_reconnect_attempt=0;
+  m_reconnect_time=0.0;
+  m_reconnect_prune=0.0;
+  config_dns=NULL;
+  config_meters=NULL;
+  m_prewarm_con=NULL;
+  m_prewarm_time=0.0;
+  m_connect_phase=-1;
+  m_connect_start=m_connect_mark=0.0;
+  memset(&m_connect_timings,0,sizeof(m_connect_timings));
+  m_health_valid=false;
+  m_auth_sent_time=0.0;
+  m_upload_level=0;
+  m_upload_good_intervals=0;
+  m_upload_last_time=0.0;
+  m_upload_last_queued=m_upload_last_sent=0;
+  memset(&m_upload_stats,0,sizeof(m_upload_stats));
+  m_upload_stats.scale_pct=100;
 
   LicenseAgreement_User=0;
   LicenseAgreementCallback=0;
@@ -600,6 +1339,14 @@ NJClient::NJClient()
   ChatMessage_User=0;
   ChannelMixer=0;
   ChannelMixer_User=0;
+  m_work_avail.store(false,std::memory_order_relaxed);
+  m_ds_retired.store(NULL,std::memory_order_relaxed);
+
+  // AudioProc takes these by design: short sections shared with the Run thread, priority
+  // inheriting on Linux. the rt checker reports any other lock
+  JAMWIDE_RT_ALLOW_LOCK(&m_users_cs);
+  JAMWIDE_RT_ALLOW_LOCK(&m_locchan_cs);
+  JAMWIDE_RT_ALLOW_LOCK(&m_misc_cs);
 
   waveWrite=0;
 #ifndef NJCLIENT_NO_XMIT_SUPPORT
@@ -618,6 +1365,9 @@ NJClient::NJClient()
   _reinit();
 
   m_session_pos_ms=m_session_pos_samples=0;
+
+  m_timing_seq.store(0,std::memory_order_relaxed);
+  publishTiming();
 }
 
 void NJClient::_reinit()
@@ -636,7 +1386,6 @@ void NJClient::_reinit()
   m_beatinfo_updated=1;
 
   m_audio_enable=0;
-  m_debug_logged_remote=false;
 
   m_active_bpm=120;
   m_active_bpi=32;
@@ -703,6 +1452,8 @@ NJClient::~NJClient()
 {
   delete m_netcon;
   m_netcon=0;
+  delete m_prewarm_con;
+  m_prewarm_con=0;
 
   delete waveWrite;
   SetOggOutFile(NULL,0,0);
@@ -720,13 +1471,42 @@ NJClient::~NJClient()
     WDL_MutexLock lock_channels(&m_remotechannel_rd_mutex);
     for (x = 0; x < m_remoteusers.GetSize(); x ++) delete m_remoteusers.Get(x);
     m_remoteusers.Empty();
+    m_users_byname.DeleteAll();
   }
-  for (x = 0; x < m_downloads.GetSize(); x ++) delete m_downloads.Get(x);
-  m_downloads.Empty();
+  deleteAllDownloads();
   for (x = 0; x < m_locchannels.GetSize(); x ++) delete m_locchannels.Get(x);
   m_locchannels.Empty();
 
+  freeRetiredDecodeStates();
+
+  delete m_pcmcache;
+  delete m_intervalcache;
   delete m_wavebq;
+  delete m_audiomem; // unlocks tmpblock and *this before they're freed
+
+  JAMWIDE_RT_FORBID_LOCK(&m_users_cs);
+  JAMWIDE_RT_FORBID_LOCK(&m_locchan_cs);
+  JAMWIDE_RT_FORBID_LOCK(&m_misc_cs);
+}
+
+// the audio thread hands finished decoders to the Run thread instead of freeing them itself
+void NJClient::retireDecodeState(DecodeState *ds)
+{
+  if (!ds) return;
+  DecodeState *head=m_ds_retired.load(std::memory_order_relaxed);
+  do ds->retire_next=head;
+  while (!m_ds_retired.compare_exchange_weak(head,ds,std::memory_order_release,std::memory_order_relaxed));
+}
+
+void NJClient::freeRetiredDecodeStates()
+{
+  DecodeState *ds=m_ds_retired.exchange(NULL,std::memory_order_acquire);
+  while (ds)
+  {
+    DecodeState *next=ds->retire_next;
+    delete ds;
+    ds=next;
+  }
 }
 
 
@@ -740,10 +1520,84 @@ void NJClient::updateBPMinfo(int bpm, int bpi)
 }
 
 
+void NJClient::publishTiming()
+{
+  m_timing_seq.store(m_timing_seq.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_timing.interval_pos=m_interval_pos;
+  m_timing.interval_length=m_interval_length;
+  m_timing.bpm=m_active_bpm;
+  m_timing.bpi=m_active_bpi;
+  m_timing_seq.store(m_timing_seq.load(std::memory_order_relaxed)+1,std::memory_order_release);
+}
+
+// each reading thread's last consistent TimingInfo, per client
+struct TimingSnapshot
+{
+  const NJClient *owner;
+  int t[4];
+};
+static thread_local TimingSnapshot s_lasttiming[4];
+static thread_local int s_lasttiming_next;
+
+void NJClient::readTiming(TimingInfo *out) const
+{
+  static_assert(sizeof(TimingInfo) == sizeof(s_lasttiming[0].t),"TimingSnapshot out of date");
+  TimingSnapshot *last=NULL;
+  for (int x = 0; x < 4 && !last; x ++) if (s_lasttiming[x].owner == this) last=s_lasttiming+x;
+
+  for (int tries = 0; ; tries ++)
+  {
+    const unsigned int a=m_timing_seq.load(std::memory_order_acquire);
+    if (!(a&1))
+    {
+      memcpy(out,&m_timing,sizeof(*out));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (m_timing_seq.load(std::memory_order_relaxed) == a)
+      {
+        if (!last)
+        {
+          last=s_lasttiming+(s_lasttiming_next++&3);
+          last->owner=this;
+        }
+        memcpy(last->t,out,sizeof(*out));
+        return;
+      }
+    }
+    if (tries >= 64)
+    {
+      // the audio thread was preempted mid-publish. never hand out a torn copy: the last
+      // consistent one is at most a publish behind
+      if (last)
+      {
+        memcpy(out,last->t,sizeof(*out));
+        return;
+      }
+      std::this_thread::yield(); // first read on this thread, wait the writer out
+    }
+  }
+}
+
+float NJClient::GetActualBPM()
+{
+  TimingInfo t;
+  readTiming(&t);
+  return (float) t.bpm;
+}
+
+int NJClient::GetBPI()
+{
+  TimingInfo t;
+  readTiming(&t);
+  return t.bpi;
+}
+
 void NJClient::GetPosition(int *pos, int *length)  // positions in samples
 {
-  if (length) *length=m_interval_length;
-  if (pos && (*pos=m_interval_pos)<0) *pos=0;
+  TimingInfo t;
+  readTiming(&t);
+  if (length) *length=t.interval_length;
+  if (pos && (*pos=t.interval_pos)<0) *pos=0;
 }
 
 unsigned int NJClient::GetSessionPosition()// returns milliseconds
@@ -756,7 +1610,9 @@ unsigned int NJClient::GetSessionPosition()// returns milliseconds
 
 void NJClient::AudioProc(float **inbuf, int innch, float **outbuf, int outnch, int len, int srate, bool justmonitor, bool isPlaying, bool isSeek, double cursessionpos)
 {
+  JAMWIDE_RT_SCOPE();
   m_srate=srate;
+  AudioGrowthScope growth_check(m_audio_maxlen > 0);
   // zero output
   int x;
   for (x = 0; x < outnch; x ++) memset(outbuf[x],0,sizeof(float)*len);
@@ -773,6 +1629,7 @@ void NJClient::AudioProc(float **inbuf, int innch, float **outbuf, int outnch, i
       )
   {
     process_samples(inbuf,innch,outbuf,outnch,len,srate,0,1,isPlaying,isSeek,cursessionpos);
+    publishTiming();
     return;
   }
 
@@ -795,7 +1652,6 @@ void NJClient::AudioProc(float **inbuf, int innch, float **outbuf, int outnch, i
   }
 
 
-
   int offs=0;
 
   while (len > 0)
@@ -847,7 +1703,7 @@ void NJClient::AudioProc(float **inbuf, int innch, float **outbuf, int outnch, i
       cursessionpos += x/(double)srate;
     }
   }
-
+  publishTiming();
 }
 
 
@@ -857,22 +1713,44 @@ void NJClient::Disconnect()
   m_host.Set("");
   m_user.Set("");
   m_pass.Set("");
-  m_debug_logged_remote=false;
-  delete m_netcon;
-  m_netcon=0;
+  m_login_user.Set("");
+  m_reconnect_attempt=0;
+  m_reconnect_prune=0.0;
+  closeConnection();
 
   int x;
   {
     WDL_MutexLock lock_users(&m_users_cs);
     WDL_MutexLock lock_channels(&m_remotechannel_rd_mutex);
+    if (m_remoteusers.GetSize()) markRemoteChanged(NULL,-1,true);
     for (x=0;x<m_remoteusers.GetSize(); x++) delete m_remoteusers.Get(x);
     m_remoteusers.Empty();
+    m_users_byname.DeleteAll();
   }
   if (x) m_userinfochange=1; // if we removed users, notify parent
 
-  for (x = 0; x < m_downloads.GetSize(); x ++) delete m_downloads.Get(x);
+  for (x = 0; x < PEER_STATS_MAX; x ++) freePeerStats(x);
+
+  // session intervals that only lived in memory would otherwise be lost here
+  m_intervalcache->Clear(this,!!config_interval_cache_spill);
+  m_pcmcache->Clear();
+
+  m_wavebq->Flush(); // keep PrepareAudio()'s pool
+
+  _reinit();
 
+  // Update cached status for lock-free audio thread access
+  cached_status.store(NJC_STATUS_DISCONNECTED, std::memory_order_release);
+}
 
+void NJClient::closeConnection()
+{
+  delete m_netcon;
+  m_netcon=0;
+
+  deleteAllDownloads();
+
+  int x;
   for (x = 0; x < m_locchannels.GetSize(); x ++)
   {
     Local_Channel *c=m_locchannels.Get(x);
@@ -883,20 +1761,120 @@ void NJClient::Disconnect()
 #ifndef NJCLIENT_NO_XMIT_SUPPORT
     delete c->m_enc;
     c->m_enc=0;
+    delete c->m_enc_next;
+    c->m_enc_next=0;
     delete c->m_enc_header_needsend;
     c->m_enc_header_needsend=0;
 #endif
 
-    c->m_bq.Clear();
+    c->m_bq.Flush(); // keep PrepareAudio()'s pool
   }
-  m_downloads.Empty();
 
-  m_wavebq->Clear();
+  m_chaninfo_dirty=false;
+  m_submask_dirty=false;
 
-  _reinit();
+  m_upload_level=0;
+  m_upload_good_intervals=0;
+  m_upload_last_time=0.0;
+  m_upload_last_queued=m_upload_last_sent=0;
+  {
+    WDL_MutexLock lock(&m_upload_cs);
+    memset(&m_upload_stats,0,sizeof(m_upload_stats));
+    m_upload_stats.scale_pct=100;
+  }
+  {
+    WDL_MutexLock lock(&m_health_cs);
+    m_health_valid=false;
+  }
+  m_auth_sent_time=0.0;
+}
 
-  // Update cached status for lock-free audio thread access
-  cached_status.store(NJC_STATUS_DISCONNECTED, std::memory_order_release);
+static const int reconnect_backoff_ms[]={ 0, 500, 1000, 2000, 4000, 8000, 15000 };
+
+void NJClient::beginReconnect()
+{
+  closeConnection();
+
+  // keep tempo, users and their decoders, but restart the interval once we're back in so
+  // uploads begin cleanly on the new connection
+  m_audio_enable=0;
+  m_status=0;
+  m_in_auth=0;
+  m_connection_keepalive=0;
+  m_interval_pos=-1;
+  m_reconnect_prune=0.0;
+  m_user.Set(m_login_user.Get());
+
+  const int n=sizeof(reconnect_backoff_ms)/sizeof(reconnect_backoff_ms[0]);
+  const int delay=reconnect_backoff_ms[wdl_min(m_reconnect_attempt,n-1)];
+  m_reconnect_attempt++;
+  m_reconnect_time=time_precise() + delay*0.001;
+
+  writeLog("reconnect %d %dms\n",m_reconnect_attempt,delay);
+  fprintf(stderr, "[NJClient] Connection lost, reconnect attempt %d in %dms\n", m_reconnect_attempt, delay);
+}
+
+void NJClient::pruneStaleUsers()
+{
+  WDL_MutexLock lock_users(&m_users_cs);
+  WDL_MutexLock lock_channels(&m_remotechannel_rd_mutex);
+  for (int x = m_remoteusers.GetSize()-1; x >= 0; x --)
+  {
+    RemoteUser *user=m_remoteusers.Get(x);
+    const unsigned int gone=user->chanpresentmask & ~user->reconnect_seen;
+    if (!gone) continue;
+
+    for (int cid = 0; cid < MAX_USER_CHANNELS && gone >= (1u<<cid); cid ++)
+    {
+      if (gone & (1u<<cid)) clearRemoteChannel(user,cid);
+    }
+    if (!user->chanpresentmask)
+    {
+      m_users_byname.Delete(user->name.Get());
+      freePeerStats(user->stats_slot);
+      m_remoteusers.Delete(x);
+      delete user;
+    }
+    m_userinfochange=1;
+  }
+
+  int i;
+  for (i = 0; i < m_remoteusers.GetSize() && !m_remoteusers.Get(i)->solomask; i ++);
+  if (i < m_remoteusers.GetSize()) m_issoloactive|=1;
+  else m_issoloactive&=~1;
+}
+
+void NJClient::markRemoteChanged(RemoteUser *user, int cid, bool layout)
+{
+  const unsigned int v=m_remote_version.load(std::memory_order_relaxed)+1;
+  if (user)
+  {
+    user->version=v;
+    if (cid >= 0) user->channels[cid].version=v;
+  }
+  if (layout) m_remote_layout_version=v;
+  m_remote_version.store(v,std::memory_order_release);
+}
+
+void NJClient::clearRemoteChannel(RemoteUser *user, int cid)
+{
+  markRemoteChanged(user,cid,true);
+  user->channels[cid].ClearSessionInfo();
+
+  user->channels[cid].name.Set("");
+  user->chanpresentmask &= ~(1u<<cid);
+  user->submask &= ~(1u<<cid);
+  user->solomask &= ~(1u<<cid);
+
+  delete user->channels[cid].ds;
+  delete user->channels[cid].next_ds[0];
+  delete user->channels[cid].next_ds[1];
+  delete user->channels[cid].session_ready;
+  user->channels[cid].ds=0;
+  user->channels[cid].next_ds[0]=0;
+  user->channels[cid].next_ds[1]=0;
+  user->channels[cid].session_ready=0;
+  user->channels[cid].session_want=-1.0;
 }
 
 void NJClient::Connect(const char *host, const char *user, const char *pass)
@@ -908,10 +1886,20 @@ void NJClient::Connect(const char *host, const char *user, const char *pass)
 
   m_host.Set(host);
   m_user.Set(user);
+  m_login_user.Set(user);
   m_pass.Set(pass);
 
+  startConnection();
+
+  // Update cached status for lock-free audio thread access
+  cached_status.store(GetStatus(), std::memory_order_release);
+  fprintf(stderr, "[NJClient] Connection initiated, status=%d\n", GetStatus());
+}
+
+JNL_Connection *NJClient::openConnection(const char *hostport)
+{
   char tmp[256];
-  lstrcpyn_safe(tmp,m_host.Get(),sizeof(tmp));
+  lstrcpyn_safe(tmp,hostport,sizeof(tmp));
   int port=NJ_PORT;
   char *p=strstr(tmp,":");
   if (p)
@@ -921,20 +1909,87 @@ void NJClient::Connect(const char *host, const char *user, const char *pass)
     if (!port) port=NJ_PORT;
   }
   fprintf(stderr, "[NJClient] Connecting to %s:%d\n", tmp, port);
-  JNL_Connection *c=new JNL_Connection(JNL_CONNECTION_AUTODNS,65536,65536);
+  JNL_Connection *c=new JNL_Connection(config_dns ? config_dns : JNL_CONNECTION_AUTODNS,65536,65536);
   c->connect(tmp,port);
+  return c;
+}
+
+void NJClient::startConnection()
+{
+  m_connect_start=m_connect_mark=time_precise();
+  m_connect_phase=CONNECT_PHASE_RESOLVE;
+  m_connect_timings.resolve_ms=m_connect_timings.tcp_ms=-1.0;
+  m_connect_timings.challenge_ms=m_connect_timings.auth_ms=-1.0;
+  m_connect_timings.total_ms=-1.0;
+  m_connect_timings.prewarmed=false;
+
+  JNL_Connection *c=NULL;
+  if (m_prewarm_con)
+  {
+    const int st=m_prewarm_con->get_state();
+    if (!strcmp(m_prewarm_host.Get(),m_host.Get()) &&
+        m_connect_start < m_prewarm_time + PREWARM_MAX_AGE &&
+        st != JNL_Connection::STATE_ERROR && st != JNL_Connection::STATE_CLOSING && st != JNL_Connection::STATE_CLOSED)
+    {
+      c=m_prewarm_con;
+      m_connect_timings.prewarmed=true;
+      fprintf(stderr, "[NJClient] Using prewarmed connection to %s\n", m_host.Get());
+    }
+    else
+    {
+      delete m_prewarm_con;
+    }
+    m_prewarm_con=NULL;
+  }
+  if (!c) c=openConnection(m_host.Get());
+
   m_netcon = new Net_Connection;
   m_netcon->attach(c);
+  m_netcon->SetRecvTimeout(config_halfopen_timeout_ms);
 
   m_status=0;
+}
+
+void NJClient::PrewarmConnection(const char *host)
+{
+  if (!host || !*host || m_netcon) return;
+  if (m_prewarm_con && !strcmp(m_prewarm_host.Get(),host)) return;
+
+  delete m_prewarm_con;
+  m_prewarm_con=openConnection(host);
+  m_prewarm_host.Set(host);
+  m_prewarm_time=time_precise();
+}
+
+void NJClient::connectPhaseDone(int phase)
+{
+  if (m_connect_phase < 0 || phase < m_connect_phase) return;
+
+  const double now=time_precise();
+  double *slot[CONNECT_PHASE_DONE]={ &m_connect_timings.resolve_ms, &m_connect_timings.tcp_ms,
+                                     &m_connect_timings.challenge_ms, &m_connect_timings.auth_ms };
+  for (; m_connect_phase <= phase; m_connect_phase++)
+    *slot[m_connect_phase] = m_connect_phase == phase ? (now-m_connect_mark)*1000.0 : 0.0;
+  m_connect_mark=now;
+
+  if (phase == CONNECT_PHASE_AUTH)
+  {
+    m_connect_timings.total_ms=(now-m_connect_start)*1000.0;
+    writeLog("connect %.1f %.1f %.1f %.1f%s\n",m_connect_timings.resolve_ms,m_connect_timings.tcp_ms,
+             m_connect_timings.challenge_ms,m_connect_timings.auth_ms,m_connect_timings.prewarmed?" prewarmed":"");
+  }
+}
 
-  // Update cached status for lock-free audio thread access
-  cached_status.store(GetStatus(), std::memory_order_release);
-  fprintf(stderr, "[NJClient] Connection initiated, status=%d\n", GetStatus());
+bool NJClient::GetConnectTimings(ConnectTimings *t)
+{
+  if (!t || m_connect_phase < 0) return false;
+  *t=m_connect_timings;
+  return true;
 }
 
 int NJClient::GetStatus()
 {
+  if (m_reconnect_attempt > 0 && m_status >= 0 && m_status < 2) return NJC_STATUS_RECONNECTING;
   if (!m_status || m_status == -1) return NJC_STATUS_PRECONNECT;
   if (m_status == 1000) return NJC_STATUS_CANTCONNECT;
   if (m_status == 1001) return NJC_STATUS_INVALIDAUTH;
@@ -1008,6 +2063,8 @@ int NJClient::find_unused_output_channel_pair() const
 
 int NJClient::Run() // nonzero if sleep ok
 {
+  freeRetiredDecodeStates();
+
   WDL_HeapBuf *p=0;
   while (!m_wavebq->GetBlock(&p))
   {
@@ -1042,13 +2099,67 @@ int NJClient::Run() // nonzero if sleep ok
     return value;
   };
 
+  if (m_prewarm_con)
+  {
+    m_prewarm_con->run();
+    const int st=m_prewarm_con->get_state();
+    if (time_precise() >= m_prewarm_time + PREWARM_MAX_AGE ||
+        st == JNL_Connection::STATE_ERROR || st == JNL_Connection::STATE_CLOSED)
+    {
+      delete m_prewarm_con;
+      m_prewarm_con=NULL;
+    }
+  }
+
+  if (!m_netcon && m_reconnect_attempt > 0 && time_precise() >= m_reconnect_time)
+  {
+    fprintf(stderr, "[NJClient] Reconnecting to %s (attempt %d)\n", m_host.Get(), m_reconnect_attempt);
+    startConnection();
+  }
+
   if (m_netcon)
   {
+    time_t now;
+    time(&now);
+    expireDownloads(now);
+
+    if (m_reconnect_prune > 0.0 && time_precise() >= m_reconnect_prune)
+    {
+      m_reconnect_prune=0.0;
+      pruneStaleUsers();
+    }
+
     Net_Message *msg=m_netcon->Run(&wantsleep);
+    if (m_connect_phase >= 0 && m_connect_phase <= CONNECT_PHASE_TCP)
+    {
+      const int st=m_netcon->GetConnection()->get_state();
+      if (st != JNL_Connection::STATE_RESOLVING) connectPhaseDone(CONNECT_PHASE_RESOLVE);
+      if (st == JNL_Connection::STATE_CONNECTED) connectPhaseDone(CONNECT_PHASE_TCP);
+    }
+    {
+      WDL_MutexLock lock(&m_health_cs);
+      m_health=m_netcon->GetHealth();
+      m_health_valid=true;
+    }
     if (!msg)
     {
       if (m_netcon->GetStatus())
       {
+        // a dropped session (or a failed attempt to resume one) is retried unless the server
+        // turned us away. a first connect that fails is reported as before
+        if (m_status != 1001 && (m_status == 2 || m_reconnect_attempt > 0) &&
+            m_reconnect_attempt < config_auto_reconnect)
+        {
+          beginReconnect();
+          return return_with_status(1);
+        }
+        if (m_reconnect_attempt > 0)
+        {
+          // gave up, report the session as dropped rather than the last attempt's failure
+          m_reconnect_attempt=0;
+          m_in_auth=0;
+          m_status=1002;
+        }
         m_audio_enable=0;
         if (m_in_auth)  m_status=1001;
         if (m_status > 0 && m_status < 1000) m_status=1002;
@@ -1065,6 +2176,7 @@ int NJClient::Run() // nonzero if sleep ok
       {
         case MESSAGE_SERVER_AUTH_CHALLENGE:
           {
+            connectPhaseDone(CONNECT_PHASE_CHALLENGE);
             mpb_server_auth_challenge cha;
             if (!cha.parse(msg))
             {
@@ -1084,18 +2196,8 @@ int NJClient::Run() // nonzero if sleep ok
 
 //              printf("Got keepalive of %d\n",m_connection_keepalive);
 
-              // Log auth state
-              {
-                FILE* lf = fopen("/tmp/jamwide.log", "a");
-                if (lf) {
-                  fprintf(lf, "[NJClient] Auth challenge received\n");
-                  fprintf(lf, "[NJClient]   user='%s' pass_len=%d\n", m_user.Get(), (int)strlen(m_pass.Get()));
-                  fprintf(lf, "[NJClient]   license_agreement=%s\n", cha.license_agreement ? "yes" : "no");
-                  fprintf(lf, "[NJClient]   LicenseAgreementCallback=%p\n", (void*)LicenseAgreementCallback);
-                  fclose(lf);
-                }
-              }
-              
+              if (config_debug_level>0) printf("AUTH CHALLENGE user '%s' license %s\n",m_user.Get(),cha.license_agreement?"yes":"no");
+
               if (cha.license_agreement)
               {
                 m_netcon->SetKeepAlive(45);
@@ -1103,27 +2205,13 @@ int NJClient::Run() // nonzero if sleep ok
                 if (LicenseAgreementCallback) {
                   license_result = LicenseAgreementCallback(LicenseAgreement_User,cha.license_agreement);
                 }
-                {
-                  FILE* lf = fopen("/tmp/jamwide.log", "a");
-                  if (lf) {
-                    fprintf(lf, "[NJClient]   license callback returned: %d\n", license_result);
-                    fclose(lf);
-                  }
-                }
+                if (config_debug_level>0) printf("AUTH LICENSE %s\n",license_result?"accepted":"rejected");
                 if (license_result)
                 {
                   repl.client_caps|=1;
                 }
               }
               m_netcon->SetKeepAlive(m_connection_keepalive);
-              
-              {
-                FILE* lf = fopen("/tmp/jamwide.log", "a");
-                if (lf) {
-                  fprintf(lf, "[NJClient]   client_caps=%d (bit0=license_accepted)\n", repl.client_caps);
-                  fclose(lf);
-                }
-              }
 
               WDL_SHA1 tmp;
               tmp.add(m_user.Get(),strlen(m_user.Get()));
@@ -1137,6 +2225,7 @@ int NJClient::Run() // nonzero if sleep ok
               tmp.result(repl.passhash);
 
               m_netcon->Send(repl.build());
+              m_auth_sent_time=time_precise();
 
               m_in_auth=1;
             }
@@ -1145,6 +2234,13 @@ int NJClient::Run() // nonzero if sleep ok
         case MESSAGE_SERVER_AUTH_REPLY:
           {
             mpb_server_auth_reply ar;
+            connectPhaseDone(CONNECT_PHASE_AUTH);
+            if (m_auth_sent_time > 0.0)
+            {
+              // the server answers straight away, so this is our first RTT estimate
+              m_netcon->AddRttSample((time_precise()-m_auth_sent_time)*1000.0,Net_Connection::RTT_HANDSHAKE);
+              m_auth_sent_time=0.0;
+            }
             if (!ar.parse(msg))
             {
               if (ar.flag) // send our channel information
@@ -1156,6 +2252,23 @@ int NJClient::Run() // nonzero if sleep ok
                     m_locchannels.Get(x)->channel_idx = x;
                 }
                 NotifyServerOfChannelChange();
+                if (m_reconnect_attempt > 0)
+                {
+                  // back in: resend every subscription in the same pass as the channel info.
+                  // users the server doesn't list again within a second are dropped
+                  fprintf(stderr, "[NJClient] Reconnected after %d attempt(s)\n", m_reconnect_attempt);
+                  writeLog("reconnected\n");
+                  m_reconnect_attempt=0;
+                  m_reconnect_prune=time_precise()+1.0;
+                  WDL_MutexLock lock(&m_users_cs);
+                  for (int x = 0; x < m_remoteusers.GetSize(); x ++)
+                  {
+                    RemoteUser *user=m_remoteusers.Get(x);
+                    user->reconnect_seen=0;
+                    user->submask_dirty=true;
+                  }
+                  m_submask_dirty=true;
+                }
                 m_status=2;
                 m_in_auth=0;
                 m_max_localch=ar.maxchan;
@@ -1202,14 +2315,12 @@ int NJClient::Run() // nonzero if sleep ok
 
                 m_userinfochange=1;
 
-                int x;
                 // todo: per-user autosubscribe option, or callback
                 // todo: have volume/pan settings here go into defaults for the channel. or not, kinda think it's pointless
                 if (cid >= 0 && cid < MAX_USER_CHANNELS)
                 {
                   m_users_cs.Enter();
-                  RemoteUser *theuser;
-                  for (x = 0; x < m_remoteusers.GetSize() && strcmp((theuser=m_remoteusers.Get(x))->name.Get(),un); x ++);
+                  RemoteUser *theuser=findRemoteUser(un);
 
     //              char buf[512];
   //                sprintf(buf,"user %s, channel %d \"%s\": %s v:%d.%ddB p:%d flag=%d\n",un,cid,chn,a?"active":"inactive",(int)v/10,abs((int)v)%10,p,f);
@@ -1218,11 +2329,15 @@ int NJClient::Run() // nonzero if sleep ok
 
                   if (a)
                   {
-                    if (x == m_remoteusers.GetSize())
+                    bool layout=false;
+                    if (!theuser)
                     {
+                      layout=true;
                       theuser=new RemoteUser;
                       theuser->name.Set(un);
                       m_remoteusers.Add(theuser);
+                      m_users_byname.Insert(un,theuser);
+                      theuser->stats_slot=allocPeerStats(un);
                     }
 
                     if ((theuser->channels[cid].flags^f)&(2|4)) // if flags changed instamode, flush out the samples
@@ -1230,9 +2345,12 @@ int NJClient::Run() // nonzero if sleep ok
                       delete theuser->channels[cid].ds;
                       delete theuser->channels[cid].next_ds[0];
                       delete theuser->channels[cid].next_ds[1];
+                      delete theuser->channels[cid].session_ready;
                       theuser->channels[cid].ds=0;
                       theuser->channels[cid].next_ds[0]=0;
                       theuser->channels[cid].next_ds[1]=0;
+                      theuser->channels[cid].session_ready=0;
+                      theuser->channels[cid].session_want=-1.0;
 //                      OutputDebugString("channel flags changed, flushing sources\n");
                     }
                     theuser->channels[cid].flags = f;
@@ -1243,15 +2361,16 @@ int NJClient::Run() // nonzero if sleep ok
                     }
 
                     theuser->channels[cid].name.Set(chn);
+                    if (!(theuser->chanpresentmask & (1u<<cid))) layout=true;
                     theuser->chanpresentmask |= 1u<<cid;
+                    theuser->reconnect_seen |= 1u<<cid;
 
 
                     if (config_autosubscribe)
                     {
                       theuser->submask |= 1u<<cid;
-                      mpb_client_set_usermask su;
-                      su.build_add_rec(un,theuser->submask);
-                      m_netcon->Send(su.build());
+                      theuser->submask_dirty=true;
+                      m_submask_dirty=true;
                     }
                     if ((config_remote_autochan == 1 || config_remote_autochan == 2) &&
                         config_remote_autochan_nch > 2 &&
@@ -1277,33 +2396,23 @@ int NJClient::Run() // nonzero if sleep ok
                         theuser->channels[cid].out_chan_index = find_unused_output_channel_pair();
                       }
                     }
+                    markRemoteChanged(theuser,cid,layout);
                   }
                   else
                   {
-                    if (x < m_remoteusers.GetSize())
+                    if (theuser)
                     {
-                      theuser->channels[cid].ClearSessionInfo();
-
-                      theuser->channels[cid].name.Set("");
-                      theuser->chanpresentmask &= ~(1u<<cid);
-                      theuser->submask &= ~(1u<<cid);
-
                       int chksolo=theuser->solomask == (1u<<cid);
-                      theuser->solomask &= ~(1u<<cid);
-
-                      delete theuser->channels[cid].ds;
-                      delete theuser->channels[cid].next_ds[0];
-                      delete theuser->channels[cid].next_ds[1];
-                      theuser->channels[cid].ds=0;
-                      theuser->channels[cid].next_ds[0]=0;
-                      theuser->channels[cid].next_ds[1]=0;
+                      clearRemoteChannel(theuser,cid);
 //                      OutputDebugString("channel flags changed, flushing sources2\n");
 
                       if (!theuser->chanpresentmask) // user no longer exists, it seems
                       {
                         chksolo=1;
+                        m_users_byname.Delete(un);
+                        freePeerStats(theuser->stats_slot);
+                        m_remoteusers.DeletePtr(theuser);
                         delete theuser;
-                        m_remoteusers.Delete(x);
                       }
 
                       if (chksolo)
@@ -1328,10 +2437,8 @@ int NJClient::Run() // nonzero if sleep ok
             if (!dib.parse(msg) && dib.username)
             {
               WDL_MutexLock lock(&m_users_cs);
-              int x;
-              RemoteUser *theuser;
-              for (x = 0; x < m_remoteusers.GetSize() && strcmp((theuser=m_remoteusers.Get(x))->name.Get(),dib.username); x ++);
-              if (x < m_remoteusers.GetSize() && dib.chidx >= 0 && dib.chidx < MAX_USER_CHANNELS)
+              RemoteUser *theuser=findRemoteUser(dib.username);
+              if (theuser && dib.chidx >= 0 && dib.chidx < MAX_USER_CHANNELS)
               {
                 //printf("Getting interval for %s, channel %d\n",dib.username,dib.chidx);
                 if (!memcmp(dib.guid,zero_guid,sizeof(zero_guid)))
@@ -1353,11 +2460,20 @@ int NJClient::Run() // nonzero if sleep ok
                   memcpy(ds->guid,dib.guid,sizeof(ds->guid));
                   ds->Open(this,dib.fourcc,!!(theuser->channels[dib.chidx].flags&4));
 
-                  ds->playtime=(theuser->channels[dib.chidx].flags&2)?LIVE_PREBUFFER:config_play_prebuffer.load(std::memory_order_relaxed);
+                  ds->playtime=getPlayPrebuffer(theuser,theuser->channels[dib.chidx].flags);
                   ds->chidx=dib.chidx;
                   ds->username.Set(dib.username);
 
-                  m_downloads.Add(ds);
+                  ds->t_begin=time_precise();
+                  if (!(theuser->channels[dib.chidx].flags&(2|4)))
+                  {
+                    // it goes into next_ds, so it's needed by the next local interval boundary
+                    const int ilen=m_interval_length, ipos=m_interval_pos;
+                    if (ipos >= 0 && ilen > ipos && m_srate > 0)
+                      ds->t_needed=ds->t_begin + (ilen-ipos)/(double)m_srate;
+                  }
+
+                  addDownload(ds);
                 }
                 else if (!(theuser->channels[dib.chidx].flags&4))
                 {
@@ -1378,37 +2494,21 @@ int NJClient::Run() // nonzero if sleep ok
             mpb_server_download_interval_write diw;
             if (!diw.parse(msg))
             {
-              time_t now;
-              time(&now);
-              int x;
-              for (x = 0; x < m_downloads.GetSize(); x ++)
+              RemoteDownload *ds=m_downloads.Get(diw.guid);
+              if (ds)
               {
-                RemoteDownload *ds=m_downloads.Get(x);
-                if (ds)
-                {
-                  if (!memcmp(ds->guid,diw.guid,sizeof(ds->guid)))
-                  {
-                    if (config_debug_level>1) printf("RECV BLOCK DATA %s%s %d bytes\n",guidtostr_tmp(diw.guid),diw.flags&1?":end":"",diw.audio_data_len);
-
-                    ds->last_time=now;
-                    if (diw.audio_data_len > 0 && diw.audio_data)
-                    {
-                      ds->Write(diw.audio_data,diw.audio_data_len);
-                    }
-                    if (diw.flags & 1)
-                    {
-                      delete ds;
-                      m_downloads.Delete(x);
-                    }
-                    break;
-                  }
+                if (config_debug_level>1) printf("RECV BLOCK DATA %s%s %d bytes\n",guidtostr_tmp(diw.guid),diw.flags&1?":end":"",diw.audio_data_len);
 
-                  if (now - ds->last_time > DOWNLOAD_TIMEOUT)
-                  {
-                    ds->chidx=-1;
-                    delete ds;
-                    m_downloads.Delete(x--);
-                  }
+                ds->last_time=now; // the timer wheel picks this up lazily when ds's slot comes due
+                if (diw.audio_data_len > 0 && diw.audio_data)
+                {
+                  ds->Write(diw.audio_data,diw.audio_data_len,msg);
+                }
+                if (diw.flags & 1)
+                {
+                  ds->completed=true;
+                  removeDownload(ds);
+                  delete ds;
                 }
               }
             }
@@ -1425,11 +2525,9 @@ int NJClient::Run() // nonzero if sleep ok
                 if (foo.parms[1] && foo.parms[2] && foo.parms[3] && foo.parms[4])
                 {
                   WDL_MutexLock lock(&m_users_cs);
-                  int x;
-                  RemoteUser *theuser;
-                  for (x = 0; x < m_remoteusers.GetSize() && strcmp((theuser=m_remoteusers.Get(x))->name.Get(),foo.parms[1]); x ++);
+                  RemoteUser *theuser=findRemoteUser(foo.parms[1]);
                   int chanidx=atoi(foo.parms[3]);
-                  if (x < m_remoteusers.GetSize() && chanidx >= 0 && chanidx < MAX_USER_CHANNELS &&
+                  if (theuser && chanidx >= 0 && chanidx < MAX_USER_CHANNELS &&
                       ((theuser->submask & theuser->chanpresentmask) & (1u<<chanidx)) && // only update if subscribed
                       (theuser->channels[chanidx].flags&4))
                   {
@@ -1506,7 +2604,11 @@ int NJClient::Run() // nonzero if sleep ok
     }
   }
 
+  // before any uploads, so the server knows about new channels by the time their data arrives
+  flushControlMessages();
+
 #ifndef NJCLIENT_NO_XMIT_SUPPORT
+  bool upload_boundary=false;
   int u;
   for (u = 0; u < m_locchannels.GetSize(); u ++)
   {
@@ -1556,7 +2658,7 @@ int NJClient::Run() // nonzero if sleep ok
         memset(lc->m_curwritefile.guid,0,sizeof(lc->m_curwritefile.guid));
         cuib.fourcc=0;
         cuib.estsize=0;
-        m_netcon->Send(cuib.build());
+        m_netcon->Send(cuib.build(),lc->UpdateSendPrio(m_netcon));
         p=0;
       }
       else if (p)
@@ -1564,7 +2666,20 @@ int NJClient::Run() // nonzero if sleep ok
         // encode data
         if (!lc->m_enc)
         {
-          lc->m_enc = CreateNJEncoder(m_srate,lc->m_enc_nch_used=block_nch,lc->m_enc_bitrate_used = lc->bitrate+(block_nch>1?lc->bitrate/3:0),WDL_RNG_int32());
+          const int br=getUploadBitrate(lc);
+          if (lc->m_enc_next && lc->m_enc_next_nch == block_nch && lc->m_enc_next_bitrate == br)
+          {
+            lc->m_enc=lc->m_enc_next;
+            lc->m_enc_next=0;
+          }
+          else
+          {
+            delete lc->m_enc_next;
+            lc->m_enc_next=0;
+            lc->m_enc = CreateNJEncoder(m_srate,block_nch,br+(block_nch>1?br/3:0),WDL_RNG_int32());
+          }
+          lc->m_enc_nch_used=block_nch;
+          lc->m_enc_bitrate_used=br;
         }
 
         if (lc->m_need_header)
@@ -1605,6 +2720,7 @@ int NJClient::Run() // nonzero if sleep ok
             cuib.estsize=0;
             delete lc->m_enc_header_needsend;
             lc->m_enc_header_needsend=cuib.build();
+            lc->UpdateSendPrio(m_netcon);
           }
         }
 
@@ -1640,7 +2756,8 @@ int NJClient::Run() // nonzero if sleep ok
               wh.flags=0;
               wh.audio_data=lc->m_enc->Get();
               wh.audio_data_len=s;
-              lc->m_curwritefile.Write(wh.audio_data,wh.audio_data_len);
+              Net_Message *msg=wh.build();
+              writeUploadCopy(lc,msg);
 
               if (lc->m_enc_header_needsend)
               {
@@ -1650,13 +2767,13 @@ int NJClient::Run() // nonzero if sleep ok
                   dib.parse(lc->m_enc_header_needsend);
                   printf("SEND BLOCK HEADER %s\n",guidtostr_tmp(dib.guid));
                 }
-                m_netcon->Send(lc->m_enc_header_needsend);
+                m_netcon->Send(lc->m_enc_header_needsend,lc->m_send_prio);
                 lc->m_enc_header_needsend=0;
               }
 
               if (config_debug_level>1) printf("SEND BLOCK %s%s %d bytes\n",guidtostr_tmp(wh.guid),wh.flags&1?"end":"",wh.audio_data_len);
 
-              m_netcon->Send(wh.build());
+              m_netcon->Send(msg,lc->m_send_prio);
             }
 
             lc->m_enc->Advance(s);
@@ -1684,11 +2801,12 @@ int NJClient::Run() // nonzero if sleep ok
             memcpy(wh.guid,lc->m_curwritefile.guid,sizeof(wh.guid));
             wh.audio_data=lc->m_enc->Get();
             wh.audio_data_len=l;
+            wh.flags=lc->m_enc->Available()>l ? 0 : 1;
 
-            lc->m_curwritefile.Write(wh.audio_data,wh.audio_data_len);
+            Net_Message *msg=wh.build();
+            writeUploadCopy(lc,msg);
 
             lc->m_enc->Advance(l);
-            wh.flags=lc->m_enc->Available()>0 ? 0 : 1;
 
             if (lc->m_enc_header_needsend)
             {
@@ -1698,12 +2816,12 @@ int NJClient::Run() // nonzero if sleep ok
                 dib.parse(lc->m_enc_header_needsend);
                 printf("SEND BLOCK HEADER %s\n",guidtostr_tmp(dib.guid));
               }
-              m_netcon->Send(lc->m_enc_header_needsend);
+              m_netcon->Send(lc->m_enc_header_needsend,lc->m_send_prio);
               lc->m_enc_header_needsend=0;
             }
 
             if (config_debug_level>1) printf("SEND BLOCK %s%s %d bytes\n",guidtostr_tmp(wh.guid),wh.flags&1?"end":"",wh.audio_data_len);
-            m_netcon->Send(wh.build());
+            m_netcon->Send(msg,lc->m_send_prio);
           }
           while (lc->m_enc->Available()>0);
           lc->m_enc->Compact(); // free any memory left
@@ -1745,78 +2863,472 @@ int NJClient::Run() // nonzero if sleep ok
 
         }
 
-        if (lc->m_enc && lc->bitrate != lc->m_enc_bitrate_used)
+        if (lc->m_enc && getUploadBitrate(lc) != lc->m_enc_bitrate_used)
         {
           delete lc->m_enc;
           lc->m_enc=0;
         }
         lc->m_need_header=true;
+        upload_boundary=true;
         lc->m_curwritefile_writelen=0.0;
 
-        // end the last encode
-      }
+        // end the last encode
+      }
+    }
+
+    // if the bitrate is going to change at the next boundary, build that encoder now so the
+    // next interval can start encoding right away
+    if (lc->m_enc && lc->channel_idx < m_max_localch)
+    {
+      const int br=getUploadBitrate(lc);
+      const int nch=(lc->src_channel&1024)?2:1;
+      if (br != lc->m_enc_bitrate_used &&
+          (!lc->m_enc_next || lc->m_enc_next_bitrate != br || lc->m_enc_next_nch != nch))
+      {
+        delete lc->m_enc_next;
+        lc->m_enc_next=CreateNJEncoder(m_srate,nch,br+(nch>1?br/3:0),WDL_RNG_int32());
+        lc->m_enc_next_bitrate=br;
+        lc->m_enc_next_nch=nch;
+      }
+    }
+  }
+
+  if (upload_boundary) updateUploadRate();
+#endif
+
+  prepareSessionDecodes();
+
+  if (config_pcm_cache_bytes > 0)
+  {
+    if (m_pcmcache->Fill(this,config_pcm_cache_bytes)) wantsleep=0;
+  }
+
+  // Update cached status for lock-free audio thread access
+  cached_status.store(GetStatus(), std::memory_order_release);
+
+  return wantsleep;
+
+}
+
+
+DecodeState *NJClient::start_decode(unsigned char *guid, int chanflags, unsigned int fourcc, DecodeMediaBuffer *decbuf)
+{
+  DecodeState *newstate=new DecodeState;
+  if (decbuf)
+  {
+    decbuf->AddRef();
+    newstate->decode_buf=decbuf;
+  }
+  memcpy(newstate->guid,guid,sizeof(newstate->guid));
+
+  if (!newstate->decode_buf && (chanflags&4))
+  {
+    PcmBlock *blk=m_pcmcache->Lookup(guid);
+    if (blk)
+    {
+      newstate->decode_codec=newstate->decode_pcm=new PcmCacheDecoder(blk);
+      blk->Release();
+      newstate->decode_pcm->Pull(1024);
+      return newstate;
+    }
+    newstate->decode_buf=m_intervalcache->Lookup(guid);
+  }
+
+  // todo: make plug-in system to allow encoders to add types allowed
+  // todo: with a preference for 'fourcc' if specified
+  unsigned int types[]={MAKE_NJ_FOURCC('O','G','G','v')}; // only types we understand
+
+  if (!newstate->decode_buf)
+  {
+    WDL_String s;
+
+    makeFilenameFromGuid(&s,guid);
+    const int oldl=s.GetLength()+1;
+    s.Append(".XXXXXXXXX");
+    unsigned int x;
+    for (x = 0; !newstate->decode_fp && x < sizeof(types)/sizeof(types[0]); x ++)
+    {
+      char tmp[8];
+      s.SetLen(oldl);
+      type_to_string(types[x],tmp);
+      s.Append(tmp);
+      newstate->decode_fp=fopenUTF8(s.Get(),"rb");
+    }
+  }
+
+  if (newstate->decode_fp||newstate->decode_buf)
+  {
+    newstate->decode_codec= CreateNJDecoder();
+    // run some decoding
+
+    if (newstate->decode_codec)
+    {
+      while (newstate->decode_codec->Available() <= 0)
+      {
+        if (newstate->runDecode()) break;
+      }
+      // mixInChannel() keeps up to a block's worth (resampled) plus a burst queued, and the queue
+      // only compacts once half of it is consumed
+      if (m_audio_maxlen > 0 && m_audio_prep_srate > 0)
+      {
+        const int nch=wdl_max(newstate->decode_codec->GetNumChannels(),1);
+        const int srcsr=wdl_max(newstate->decode_codec->GetSampleRate(),m_audio_prep_srate);
+        const int block=(int)(((WDL_INT64)m_audio_maxlen*srcsr)/m_audio_prep_srate)+1;
+        newstate->preallocOutput(newstate->decode_codec->Available()/nch + 2*(block+DecodeState::DECODE_BURST_FRAMES));
+      }
+      if (chanflags & 2)
+        newstate->is_voice_firstchk=true;
+    }
+  }
+
+  return newstate;
+}
+
+// audio thread, m_users_cs held: a state Run() decoded for this interval, or the spare bound to
+// its PcmCache block. NULL if neither is there yet, mixInChannel() then asks Run() for it
+DecodeState *NJClient::takeSessionDecode(RemoteUser_Channel *userchan, const unsigned char *guid)
+{
+  DecodeState *ds=userchan->session_ready;
+  if (ds && !memcmp(ds->guid,guid,sizeof(ds->guid)))
+  {
+    userchan->session_ready=NULL;
+    return ds;
+  }
+
+  ds=userchan->session_spare;
+  if (!ds) return NULL;
+  PcmBlock *blk=m_pcmcache->Lookup(guid);
+  if (!blk) return NULL;
+
+  userchan->session_spare=NULL;
+  memcpy(ds->guid,guid,sizeof(ds->guid));
+  ds->decode_pcm->Bind(blk);
+  ds->decode_pcm->Pull(1024);
+  return ds;
+}
+
+// Run thread: decodes what mixInChannel() asked for, so the audio thread never opens a decoder.
+// m_remoteusers only changes on this thread, m_users_cs is held just to exchange states
+void NJClient::prepareSessionDecodes()
+{
+  if (m_srate <= 0) return;
+  for (int u = 0; u < m_remoteusers.GetSize(); u ++)
+  {
+    RemoteUser *user=m_remoteusers.Get(u);
+    for (int ch = 0; ch < MAX_USER_CHANNELS; ch ++)
+    {
+      RemoteUser_Channel *chan=&user->channels[ch];
+      if (!(user->chanpresentmask & (1u<<ch)) || (chan->flags&(2|4)) != 4) continue;
+
+      if (!chan->session_spare)
+      {
+        DecodeState *spare=new DecodeState;
+        spare->decode_codec=spare->decode_pcm=new PcmCacheDecoder(NULL);
+        m_users_cs.Enter();
+        chan->session_spare=spare;
+        m_users_cs.Leave();
+      }
+
+      m_users_cs.Enter();
+      const double want=chan->session_want;
+      chan->session_want=-1.0;
+      unsigned char readyguid[16];
+      const bool haveready=!!chan->session_ready;
+      if (haveready) memcpy(readyguid,chan->session_ready->guid,16);
+      m_users_cs.Leave();
+      if (want < 0.0) continue;
+
+      unsigned char guid[16];
+      double offs, len;
+      bool found=chan->GetSessionInfo(want,guid,&offs,&len,1.0/m_srate);
+      if (!found && len < 1.0) found=chan->GetSessionInfo(want+len,guid,&offs,&len,1.0/m_srate); // next one after a gap
+      if (!found || (haveready && !memcmp(readyguid,guid,16))) continue;
+
+      // installed even without a decoder, mixInChannel() then plays silence for the interval
+      DecodeState *ds=start_decode(guid,chan->flags,0,NULL);
+      m_users_cs.Enter();
+      DecodeState *old=chan->session_ready;
+      chan->session_ready=ds;
+      m_users_cs.Leave();
+      delete old;
+    }
+  }
+}
+
+bool PcmCache::Fill(NJClient *parent, WDL_INT64 maxbytes)
+{
+  WDL_MutexLock lock(&m_mutex);
+  while (m_bytes > maxbytes && evictLRU()) { } // budget may have been lowered
+  reclaim();
+
+  if (!m_cur)
+  {
+    if (m_pending.GetSize() < 16) return false;
+    memcpy(m_curguid,m_pending.Get(),16);
+    memmove(m_pending.Get(),m_pending.Get()+16,m_pending.GetSize()-16);
+    m_pending.Resize(m_pending.GetSize()-16,false);
+
+    // decode from the compressed cache if it has the interval, otherwise from the GUID file
+    DecodeMediaBuffer *src=parent->m_intervalcache->Lookup(m_curguid);
+    m_cur=parent->start_decode(m_curguid,0,0,src);
+    if (src) src->Release();
+    if (!m_cur->decode_codec || !m_cur->HasSource())
+    {
+      abortDecode();
+      return m_pending.GetSize() >= 16;
+    }
+  }
+
+  // a slice per Run() pass, so a long interval doesn't hold up the network
+  bool eof=false;
+  for (int x = 0; x < FILL_SLICES && !eof; x ++) eof=m_cur->runDecode(FILL_SLICE_BYTES);
+  if (!eof) return true;
+
+  const int nch=m_cur->decode_codec->GetNumChannels();
+  const int avail=m_cur->decode_codec->Available();
+  if (nch > 0 && avail > 0 && avail*(WDL_INT64)sizeof(float) <= maxbytes && findSlot(m_curguid) < 0)
+  {
+    PcmBlock *blk=new PcmBlock;
+    memcpy(blk->guid,m_curguid,16);
+    blk->nch=nch;
+    blk->srate=m_cur->decode_codec->GetSampleRate();
+    float *p=blk->samples.ResizeOK(avail,false);
+    if (p)
+    {
+      memcpy(p,m_cur->decode_codec->Get(),avail*sizeof(float));
+      publish(blk,maxbytes);
+    }
+    else blk->Release();
+  }
+  abortDecode();
+
+  return m_pending.GetSize() >= 16;
+}
+
+void PcmCache::publish(PcmBlock *blk, WDL_INT64 maxbytes)
+{
+  const WDL_INT64 sz=blockBytes(blk);
+  int slot=-1;
+  for (;;)
+  {
+    if (m_bytes + sz <= maxbytes)
+    {
+      for (int x = 0; x < MAX_BLOCKS && slot < 0; x ++)
+        if (!m_slots[x].load(std::memory_order_relaxed)) slot=x;
+      if (slot >= 0) break;
+    }
+    if (!evictLRU()) break;
+  }
+  if (slot < 0) { blk->Release(); return; }
+
+  blk->lastuse.store(m_tick.load(std::memory_order_relaxed),std::memory_order_relaxed);
+  m_bytes += sz;
+  m_slots[slot].store(blk,std::memory_order_release);
+}
+
+void PcmCache::abortDecode()
+{
+  delete m_cur;
+  m_cur=NULL;
+}
+
+void NJClient::GetPcmCacheStats(PcmCacheStats *st)
+{
+  if (st) m_pcmcache->GetStats(st);
+}
+
+SOCKET NJClient::GetNetSocket(bool *wantwrite)
+{
+  if (!m_netcon)
+  {
+    if (wantwrite) *wantwrite=false;
+    return INVALID_SOCKET;
+  }
+  return m_netcon->GetWaitSocket(wantwrite);
+}
+
+bool NJClient::GetNetSendStats(Net_Connection::Stats *st)
+{
+  if (!m_netcon || !st) return false;
+  *st=m_netcon->GetStats();
+  return true;
+}
+
+bool NJClient::GetConnectionHealth(Net_Connection::Health *h)
+{
+  if (!h) return false;
+  WDL_MutexLock lock(&m_health_cs);
+  if (!m_health_valid) return false;
+  *h=m_health;
+  return true;
+}
+
+void NJClient::GetIntervalCacheStats(IntervalCacheStats *st)
+{
+  if (st) m_intervalcache->GetStats(st);
+}
+
+void NJClient::GetUploadRateStats(UploadRateStats *st)
+{
+  if (!st) return;
+  WDL_MutexLock lock(&m_upload_cs);
+  *st=m_upload_stats;
+}
+
+int NJClient::getUploadBitrate(const Local_Channel *lc) const
+{
+  const int br=wdl_min(lc->bitrate, config_upload_bitrate_max);
+  const int pct=upload_rate_steps[m_upload_level];
+  if (pct >= 100 || br <= config_upload_bitrate_min) return br;
+  return wdl_max(br*pct/100, config_upload_bitrate_min);
+}
+
+// the local copy of an upload references the audio in the outgoing message instead of copying it
+void NJClient::writeUploadCopy(Local_Channel *lc, Net_Message *msg)
+{
+  if (!msg) return;
+  const int offs=mpb_client_upload_interval_write::AUDIO_OFFSET;
+  const int len=msg->get_size()-offs;
+  if (len > 0) lc->m_curwritefile.Write((char *)msg->get_data()+offs,len,msg);
+}
+
+void NJClient::updateUploadRate()
+{
+  const double now=time_precise();
+  if (!m_netcon) return;
+  const Net_Connection::Stats &ns=m_netcon->GetStats();
+  const double dt=now-m_upload_last_time;
+  const WDL_INT64 queued=m_upload_last_queued, sent=m_upload_last_sent;
+  m_upload_last_time=now;
+  m_upload_last_queued=ns.bytes_queued;
+  m_upload_last_sent=ns.bytes_sent;
+  if (sent > ns.bytes_sent || queued > ns.bytes_queued || dt <= 0.0 || dt > 120.0) return; // first boundary, or a new connection
+
+  const double backlog=(double)(ns.bytes_queued - ns.bytes_sent);
+  const double drain=(ns.bytes_sent - sent)/dt, produce=(ns.bytes_queued - queued)/dt; // bytes/sec
+
+  const int maxlevel=(int) (sizeof(upload_rate_steps)/sizeof(upload_rate_steps[0])) - 1;
+  const int oldlevel=m_upload_level;
+  if (!config_upload_adapt)
+  {
+    m_upload_level=0;
+    m_upload_good_intervals=0;
+  }
+  else if (backlog > UPLOAD_BACKLOG_MIN_BYTES && backlog > drain*UPLOAD_BACKLOG_MAX_SEC)
+  {
+    // the uplink isn't keeping up, everyone else will start getting our intervals late
+    if (m_upload_level < maxlevel) m_upload_level++;
+    m_upload_good_intervals=0;
+  }
+  else if (backlog < UPLOAD_BACKLOG_MIN_BYTES)
+  {
+    if (m_upload_level > 0 && ++m_upload_good_intervals >= UPLOAD_GOOD_INTERVALS)
+    {
+      m_upload_level--;
+      m_upload_good_intervals=0;
+    }
+  }
+  else m_upload_good_intervals=0;
+
+  {
+    WDL_MutexLock lock(&m_upload_cs);
+    m_upload_stats.scale_pct=upload_rate_steps[m_upload_level];
+    m_upload_stats.backlog_bytes=(int)wdl_min(backlog,2147483647.0);
+    m_upload_stats.drain_kbps=(int) (drain*0.008);
+    m_upload_stats.produce_kbps=(int) (produce*0.008);
+    m_upload_stats.decisions++;
+    if (m_upload_level > oldlevel) m_upload_stats.steps_down++;
+    else if (m_upload_level < oldlevel) m_upload_stats.steps_up++;
+  }
+
+  if (m_upload_level != oldlevel)
+    writeLog("uploadrate %d%% %d%% backlog=%.0f drain=%.0fkbps produce=%.0fkbps\n",upload_rate_steps[oldlevel],upload_rate_steps[m_upload_level],backlog,drain*0.008,produce*0.008);
+  if (config_debug_level>0)
+    printf("UPLOAD RATE %d%% -> %d%% backlog=%.0f drain=%.0fkbps produce=%.0fkbps\n",upload_rate_steps[oldlevel],upload_rate_steps[m_upload_level],backlog,drain*0.008,produce*0.008);
+}
+
+void NJClient::updateMeter(int idx, double peak_l, double peak_r, double sumsq_l, double sumsq_r, int n,
+                           int clip, int len, int srate, double decay)
+{
+  if (idx < 0 || idx >= NJMeterBank::SIZE) return;
+  NJMeter *m=config_meters->meters+idx;
+
+  const double peak[2]={ peak_l, peak_r }, sumsq[2]={ sumsq_l, sumsq_r };
+  bool moving=false;
+  for (int x = 0; x < 2; x ++)
+  {
+    // RMS of this block, falling no faster than the peak does
+    double rms=m->rms[x].load(std::memory_order_relaxed)*decay;
+    if (n > 0)
+    {
+      const double r=sqrt(sumsq[x]/n);
+      if (r > rms) rms=r;
     }
+    m->peak[x].store((float)peak[x],std::memory_order_relaxed);
+    m->rms[x].store((float)rms,std::memory_order_relaxed);
+    if (peak[x] > NJMeterBank::MOTION_FLOOR || rms > NJMeterBank::MOTION_FLOOR) moving=true;
   }
-#endif
-
-  // Update cached status for lock-free audio thread access
-  cached_status.store(GetStatus(), std::memory_order_release);
 
-  return wantsleep;
+  if (clip)
+  {
+    m->clip_hold=srate*2;
+    const int prev=m->clip.load(std::memory_order_relaxed);
+    if ((prev|clip) != prev) moving=true;
+    m->clip.store(prev|clip,std::memory_order_relaxed);
+  }
+  else if (m->clip_hold > 0 && (m->clip_hold-=len) <= 0)
+  {
+    m->clip.store(0,std::memory_order_relaxed);
+    moving=true;
+  }
 
+  // only this thread writes it, so no read-modify-write is needed
+  if (moving)
+    config_meters->motion.store(config_meters->motion.load(std::memory_order_relaxed)+1,
+                                std::memory_order_relaxed);
 }
 
-
-DecodeState *NJClient::start_decode(unsigned char *guid, int chanflags, unsigned int fourcc, DecodeMediaBuffer *decbuf)
+int NJClient::audioQueueBlocks() const
 {
-  DecodeState *newstate=new DecodeState;
-  if (decbuf)
-  {
-    decbuf->AddRef();
-    newstate->decode_buf=decbuf;
-  }
-  memcpy(newstate->guid,guid,sizeof(newstate->guid));
+  // enough blocks for ~250ms of audio between Run() passes draining the queue
+  int n=m_audio_maxlen > 0 ? m_audio_prep_srate/4/m_audio_maxlen+4 : 0;
+  if (n < 16) n=16;
+  else if (n > BufferQueue::MAX_QUEUED_BLOCKS) n=BufferQueue::MAX_QUEUED_BLOCKS;
+  return n;
+}
 
+void NJClient::prepareLocalChannel(Local_Channel *lc)
+{
+  if (m_audio_maxlen < 1 || !lc) return;
+  lc->m_bq.Prealloc(audioQueueBlocks(),m_audio_maxlen*2*(int)sizeof(float)); // stereo sources
+}
 
-  // todo: make plug-in system to allow encoders to add types allowed
-  // todo: with a preference for 'fourcc' if specified
-  unsigned int types[]={MAKE_NJ_FOURCC('O','G','G','v')}; // only types we understand
+void NJClient::PrepareAudio(int maxlen, int srate)
+{
+  if (maxlen < 1 || srate < 1) return;
 
-  if (!newstate->decode_buf)
-  {
-    WDL_String s;
+  m_audiomem->Release(); // tmpblock may move below
 
-    makeFilenameFromGuid(&s,guid);
-    const int oldl=s.GetLength()+1;
-    s.Append(".XXXXXXXXX");
-    unsigned int x;
-    for (x = 0; !newstate->decode_fp && x < sizeof(types)/sizeof(types[0]); x ++)
-    {
-      char tmp[8];
-      s.SetLen(oldl);
-      type_to_string(types[x],tmp);
-      s.Append(tmp);
-      newstate->decode_fp=fopenUTF8(s.Get(),"rb");
-    }
-  }
+  // mono scratch for processed or silent local channels
+  tmpblock.Prealloc(maxlen*(int)sizeof(float));
+  m_audiomem->Lock(tmpblock.GetFast(),tmpblock.GetAlloc());
 
-  if (newstate->decode_fp||newstate->decode_buf)
-  {
-    newstate->decode_codec= CreateNJDecoder();
-    // run some decoding
+  m_locchan_cs.Enter(); // the Run thread may be adding channels
+  m_audio_maxlen=maxlen;
+  m_audio_prep_srate=srate;
+  for (int x = 0; x < m_locchannels.GetSize(); x ++) prepareLocalChannel(m_locchannels.Get(x));
+  m_locchan_cs.Leave();
 
-    if (newstate->decode_codec)
-    {
-      while (newstate->decode_codec->Available() <= 0)
-      {
-        if (newstate->runDecode()) break;
-      }
-      if (chanflags & 2)
-        newstate->is_voice_firstchk=true;
-    }
-  }
+  // local recording of the mix, if one is set up (see SetOggOutFile())
+  if (waveWrite
+#ifndef NJCLIENT_NO_XMIT_SUPPORT
+      || m_oggWrite
+#endif
+     )
+    m_wavebq->Prealloc(audioQueueBlocks(),maxlen*2*(int)sizeof(float));
 
-  return newstate;
+  if (config_meters) m_audiomem->Lock(config_meters,sizeof(*config_meters));
+  m_audiomem->Lock(this,sizeof(*this));
 }
 
 float NJClient::GetOutputPeak(int ch)
@@ -1867,7 +3379,11 @@ void NJClient::process_samples(float **inbuf, int innch, float **outbuf, int out
     {
       // todo: support stereo on chanmixer, silent, and effect processing stuff
       int bytelen=len*(int)sizeof(float);
-      if (tmpblock.GetSize() < bytelen) tmpblock.Resize(bytelen);
+      if (tmpblock.GetSize() < bytelen)
+      {
+        if (bytelen > tmpblock.GetAlloc()) NJ_AUDIO_GROWTH("tmpblock grew");
+        tmpblock.Resize(bytelen,false);
+      }
 
       if (ChannelMixer && ChannelMixer(ChannelMixer_User,inbuf,offset,innch,sc,(float*)tmpblock.Get(),len))
       {
@@ -1931,6 +3447,7 @@ void NJClient::process_samples(float **inbuf, int innch, float **outbuf, int out
       {
         lc->m_bq.AddBlock(sc_nch,0.0,src,len,src2);
         lc->m_curwritefile_curbuflen += len;
+        m_work_avail.store(true,std::memory_order_relaxed);
       }
     }
 #endif
@@ -1959,6 +3476,7 @@ void NJClient::process_samples(float **inbuf, int innch, float **outbuf, int out
 
         float maxf=(float) (lc->decode_peak_vol[0]*decay);
         float maxf2=(float) (lc->decode_peak_vol[1]*decay);
+        double sumsq=0.0, sumsq2=0.0;
 
         int x=len;
         while (x--)
@@ -1967,6 +3485,7 @@ void NJClient::process_samples(float **inbuf, int innch, float **outbuf, int out
 
           if (f > maxf) maxf=f;
           else if (f < -maxf) maxf=-f;
+          sumsq += f*f;
 
           if (chan_active)
             *out1++ += f * vol1;
@@ -1975,6 +3494,7 @@ void NJClient::process_samples(float **inbuf, int innch, float **outbuf, int out
 
           if (f > maxf2) maxf2=f;
           else if (f < -maxf2) maxf2=-f;
+          sumsq2 += f*f;
 
           if (chan_active)
             *out2++ += f * vol2;
@@ -1984,21 +3504,29 @@ void NJClient::process_samples(float **inbuf, int innch, float **outbuf, int out
         }
         lc->decode_peak_vol[0]=maxf;
         lc->decode_peak_vol[1]=maxf2;
+        if (config_meters)
+          updateMeter(NJMeterBank::Local(lc->channel_idx),maxf,maxf2,sumsq,sumsq2,len,
+                      (maxf >= 1.0f ? NJMeter::CLIP_L : 0)|(maxf2 >= 1.0f ? NJMeter::CLIP_R : 0),len,srate,decay);
       }
       else
       {
         float maxf=(float) (lc->decode_peak_vol[0]*decay);
+        double sumsq=0.0;
         int x=len;
         while (x--)
         {
           float f=(*src++ + *src2++)*0.5f;
           if (f > maxf) maxf=f;
           else if (f < -maxf) maxf=-f;
+          sumsq += f*f;
 
           if (chan_active)
             *out1++ += f * vol1;;
         }
         lc->decode_peak_vol[1]=lc->decode_peak_vol[0]=maxf;
+        if (config_meters)
+          updateMeter(NJMeterBank::Local(lc->channel_idx),maxf,maxf,sumsq,sumsq,len,
+                      maxf >= 1.0f ? NJMeter::CLIP_L|NJMeter::CLIP_R : 0,len,srate,decay);
       }
     }
   }
@@ -2010,21 +3538,6 @@ void NJClient::process_samples(float **inbuf, int innch, float **outbuf, int out
   {
     // mix in all active (subscribed) channels
     m_users_cs.Enter();
-    if (!m_debug_logged_remote && m_remoteusers.GetSize() > 0)
-    {
-      m_debug_logged_remote = true;
-      RemoteUser *user = m_remoteusers.Get(0);
-      int mask = user ? user->chanpresentmask : 0;
-      int out_idx = user ? user->channels[0].out_chan_index : -1;
-      int flags = user ? user->channels[0].flags : 0;
-      FILE* lf = fopen("/tmp/jamwide.log", "a");
-      if (lf)
-      {
-        fprintf(lf, "[NJClient][AudioProc] users=%d mask=0x%x out_idx=%d flags=%d\n",
-                m_remoteusers.GetSize(), mask, out_idx, flags);
-        fclose(lf);
-      }
-    }
     for (u = 0; u < m_remoteusers.GetSize(); u ++)
     {
       RemoteUser *user=m_remoteusers.Get(u);
@@ -2044,9 +3557,21 @@ void NJClient::process_samples(float **inbuf, int innch, float **outbuf, int out
           if (m_issoloactive) muteflag = !(user->solomask & (1u<<ch));
           else muteflag=(user->mutedmask & (1u<<ch)) || user->muted;
 
+          RemoteUser_Channel *chan=&user->channels[ch];
+          const float vol=user->volume*chan->volume;
+          chan->decode_sumsq[0]=chan->decode_sumsq[1]=0.0;
+          chan->decode_meter_n=chan->decode_clip=0;
+
           mixInChannel(user,ch,muteflag,
-            user->volume*user->channels[ch].volume,lpan,
-              outbuf,user->channels[ch].out_chan_index + m_remote_chanoffs,len,srate,outnch,offset,decay,isPlaying,isSeek,cursessionpos);
+            vol,lpan,
+              outbuf,chan->out_chan_index + m_remote_chanoffs,len,srate,outnch,offset,decay,isPlaying,isSeek,cursessionpos);
+
+          if (config_meters)
+          {
+            const int n=chan->decode_meter_n;
+            updateMeter(NJMeterBank::Remote(user->stats_slot,ch),chan->decode_peak_vol[0],chan->decode_peak_vol[1],
+                        chan->decode_sumsq[0]*vol*vol,chan->decode_sumsq[1]*vol*vol,n,chan->decode_clip,len,srate,decay);
+          }
         }
         a>>=1;
       }
@@ -2106,6 +3631,20 @@ void NJClient::process_samples(float **inbuf, int innch, float **outbuf, int out
     }
     output_peaklevel[0]=maxf1;
     output_peaklevel[1]=maxf2;
+
+    if (config_meters)
+    {
+      // after master volume, so RMS is taken over the same samples
+      double sumsq1=0.0, sumsq2=0.0;
+      const float *p1=outbuf[0]+offset, *p2=outbuf[outnch>1]+offset;
+      for (x = 0; x < len; x ++)
+      {
+        sumsq1 += p1[x]*p1[x];
+        sumsq2 += p2[x]*p2[x];
+      }
+      updateMeter(NJMeterBank::MASTER,maxf1,maxf2,sumsq1,sumsq2,len,
+                  (maxf1 >= 1.0f ? NJMeter::CLIP_L : 0)|(maxf2 >= 1.0f ? NJMeter::CLIP_R : 0),len,srate,decay);
+    }
   }
 
   // mix in (super shitty) metronome (fucko!!!!)
@@ -2279,7 +3818,7 @@ void NJClient::mixInChannel(RemoteUser *user, int chanidx,
   {
     if (!isPlaying)
     {
-      delete userchan->ds;
+      retireDecodeState(userchan->ds);
       userchan->ds=0;
       return;
     }
@@ -2289,7 +3828,7 @@ void NJClient::mixInChannel(RemoteUser *user, int chanidx,
       if (userchan->ds)
       {
         userchan->ds->calcOverlap(&fade_state);
-        delete userchan->ds;
+        retireDecodeState(userchan->ds);
         userchan->ds=0;
       }
 
@@ -2300,9 +3839,15 @@ void NJClient::mixInChannel(RemoteUser *user, int chanidx,
   //    sprintf(buf,"querying %f\n",playPos);
 //      OutputDebugString(buf);
       double mediasr=m_srate;
-      if (userchan->GetSessionInfo(playPos,guid,&offs,&userchan->curds_lenleft,1.0/srate) && userchan->curds_lenleft > 16.0/srate)
+      if (userchan->GetSessionInfo(playPos,guid,&offs,&userchan->curds_lenleft,1.0/srate,true) && userchan->curds_lenleft > 16.0/srate)
       {
-        userchan->ds=start_decode(guid, userchan->flags, 0, NULL);
+        userchan->ds=takeSessionDecode(userchan,guid);
+        // have Run() prepare the following interval by the time this one ends, or this one if
+        // it isn't decoded yet (looked for again on the next block)
+        userchan->session_want=userchan->ds ? playPos+userchan->curds_lenleft : playPos;
+        if (!userchan->ds) userchan->curds_lenleft=0.0;
+        m_work_avail.store(true,std::memory_order_relaxed);
+
         if (userchan->ds&&userchan->ds->decode_codec)
         {
           userchan->ds->applyOverlap(&fade_state);
@@ -2322,12 +3867,13 @@ void NJClient::mixInChannel(RemoteUser *user, int chanidx,
         }
         else
         {
-          delete userchan->ds;
+          retireDecodeState(userchan->ds);
           userchan->ds=0;
         }
       }
       else
       {
+        userchan->session_want=playPos; // Run() looks past the gap for the next interval
       }
 
       userchan->curds_lenleft *= mediasr;
@@ -2337,12 +3883,12 @@ void NJClient::mixInChannel(RemoteUser *user, int chanidx,
   }
 
   DecodeState *chan=userchan->ds;
-  if (!chan || !chan->decode_codec || (!chan->decode_fp && !chan->decode_buf))
+  if (!chan || !chan->decode_codec || !chan->HasSource())
   {
     if (llmode && userchan->next_ds[0])
     {
       if (userchan->ds) userchan->ds->calcOverlap(&fade_state);
-      delete userchan->ds;
+      retireDecodeState(userchan->ds);
       chan = userchan->ds = userchan->next_ds[0];
       userchan->next_ds[0]=userchan->next_ds[1]; // advance queue
       userchan->next_ds[1]=0;
@@ -2353,7 +3899,7 @@ void NJClient::mixInChannel(RemoteUser *user, int chanidx,
         writeUserChanLog("v",user,userchan,chanidx);
       }
     }
-    if (!chan || !chan->decode_codec || (!chan->decode_fp&&!chan->decode_buf))
+    if (!chan || !chan->decode_codec || !chan->HasSource())
     {
       userchan->curds_lenleft -= len;
       return;
@@ -2378,6 +3924,7 @@ void NJClient::mixInChannel(RemoteUser *user, int chanidx,
     if (chan->decode_codec->Available() > 0 && chan->is_voice_firstchk)
     {
       chan->is_voice_firstchk=false;
+      AudioGrowthExempt exempt; // decodes everything downloaded so far to find the catch-up point
       while (!chan->runDecode(256))
       {
       }
@@ -2452,40 +3999,51 @@ void NJClient::mixInChannel(RemoteUser *user, int chanidx,
       int l=(needed)*srcnch;
       float maxf=(float) (userchan->decode_peak_vol[0]/vol);
       float maxf2=(float) (userchan->decode_peak_vol[1]/vol);
+      double sumsq=0.0, sumsq2=0.0;
+      int clip=0;
       if (srcnch>=2) // vu meter + clipping
       {
         l/=2;
+        userchan->decode_meter_n += l;
         while (l--)
         {
           float f=*p;
-          if (f<-1.0f) f=*p=-1.0f;
-          else if (f>1.0f) f=*p=1.0f;
+          if (f<-1.0f) { f=*p=-1.0f; clip|=NJMeter::CLIP_L; }
+          else if (f>1.0f) { f=*p=1.0f; clip|=NJMeter::CLIP_L; }
           if (f > maxf) maxf=f;
           else if (f < -maxf) maxf=-f;
+          sumsq += f*f;
 
           f=*++p;
-          if (f<-1.0f) f=*p=-1.0f;
-          else if (f>1.0f) f=*p=1.0f;
+          if (f<-1.0f) { f=*p=-1.0f; clip|=NJMeter::CLIP_R; }
+          else if (f>1.0f) { f=*p=1.0f; clip|=NJMeter::CLIP_R; }
           if (f > maxf2) maxf2=f;
           else if (f < -maxf2) maxf2=-f;
+          sumsq2 += f*f;
           p++;
         }
       }
       else
       {
+        userchan->decode_meter_n += l;
         while (l--)
         {
           float f=*p;
-          if (f<-1.0f) f=*p=-1.0f;
-          else if (f>1.0f) f=*p=1.0f;
+          if (f<-1.0f) { f=*p=-1.0f; clip=NJMeter::CLIP_L|NJMeter::CLIP_R; }
+          else if (f>1.0f) { f=*p=1.0f; clip=NJMeter::CLIP_L|NJMeter::CLIP_R; }
           if (f > maxf) maxf=f;
           else if (f < -maxf) maxf=-f;
+          sumsq += f*f;
           p++;
         }
         maxf2=maxf;
+        sumsq2=sumsq;
       }
       userchan->decode_peak_vol[0]=maxf*vol;
       userchan->decode_peak_vol[1]=maxf2*vol;
+      userchan->decode_sumsq[0]+=sumsq;
+      userchan->decode_sumsq[1]+=sumsq2;
+      userchan->decode_clip|=clip;
 
       int use_nch=2;
       if (outnch < 2 || (out_channel&1024)) use_nch=1;
@@ -2530,7 +4088,7 @@ void NJClient::mixInChannel(RemoteUser *user, int chanidx,
     // call again
     userchan->curds_lenleft=-10000.0;
     if (userchan->ds) userchan->ds->calcOverlap(&fade_state);
-    delete userchan->ds;
+    retireDecodeState(userchan->ds);
     chan = userchan->ds = userchan->next_ds[0];
     userchan->next_ds[0]=userchan->next_ds[1]; // advance queue
     userchan->next_ds[1]=0;
@@ -2540,7 +4098,7 @@ void NJClient::mixInChannel(RemoteUser *user, int chanidx,
       if (llmode)
         writeUserChanLog("v",user,userchan,chanidx);
     }
-    if (sessionmode || (chan && chan->decode_codec && (chan->decode_fp||chan->decode_buf)))
+    if (sessionmode || (chan && chan->decode_codec && chan->HasSource()))
       mixInChannel(user,chanidx,muted,vol,pan,outbuf,out_channel,len-len_out,srate,outnch,offs+len_out,vudecay,
         isPlaying,false,playPos + len_out/(double)srate);
   }
@@ -2564,7 +4122,7 @@ void NJClient::writeUserChanLog(const char *lbl, RemoteUser *user, RemoteUser_Ch
 void NJClient::on_new_interval()
 {
   m_loopcnt++;
-  writeLog("interval %d %.2f %d\n",m_loopcnt,GetActualBPM(),m_active_bpi);
+  writeLog("interval %d %.2f %d\n",m_loopcnt,(float)m_active_bpm,m_active_bpi);
 
   m_metronome_pos=0.0;
 
@@ -2614,10 +4172,10 @@ void NJClient::on_new_interval()
         chan->dump_samples=0;
         overlapFadeState fade_state;
         if (chan->ds) chan->ds->calcOverlap(&fade_state);
-        delete chan->ds;
+        retireDecodeState(chan->ds);
         chan->ds=0;
         if ((user->submask & user->chanpresentmask) & (1u<<ch)) chan->ds = chan->next_ds[0];
-        else delete chan->next_ds[0];
+        else retireDecodeState(chan->next_ds[0]);
         chan->next_ds[0]=chan->next_ds[1]; // advance queue
         chan->next_ds[1]=0;
 
@@ -2653,70 +4211,101 @@ const char *NJClient::GetUserState(int idx, float *vol, float *pan, bool *mute)
   return p->name.Get();
 }
 
-void NJClient::GetRemoteUsersSnapshot(std::vector<RemoteUserInfo>& out)
+static void copyViewName(char *dest, const WDL_String &src)
+{
+  int len=src.GetLength();
+  if (len > NJClient::kRemoteNameMax) len=NJClient::kRemoteNameMax;
+  memcpy(dest,src.Get(),(size_t)len);
+  dest[len]=0;
+}
+
+template<class T> static void growViewArray(std::vector<T> &a, int n)
+{
+  if ((int)a.size() < n) a.resize((size_t)n);
+}
+
+bool NJClient::UpdateRemoteMixerView(RemoteMixerView *view)
 {
   WDL_MutexLock lock2(&m_remotechannel_rd_mutex);
   WDL_MutexLock lock_users(&m_users_cs);
-  out.clear();
-  const int num_users = m_remoteusers.GetSize();
-  if (num_users <= 0) return;
-
-  const int kMaxNameLen = kRemoteNameMax;
-
-  out.reserve(num_users);
-  for (int u = 0; u < num_users; ++u)
-  {
-    RemoteUser *user = m_remoteusers.Get(u);
-    if (!user) continue;
-
-    RemoteUserInfo info;
-    info.name[0] = '\0';
-    info.name_len = 0;
-    const char* user_name = user->name.Get();
-    const int user_name_len = user->name.GetLength();
-    if (user_name && user_name_len > 0) {
-      const int copy_len = user_name_len > kMaxNameLen ? kMaxNameLen : user_name_len;
-      memcpy(info.name, user_name, static_cast<size_t>(copy_len));
-      info.name[copy_len] = '\0';
-      info.name_len = copy_len;
-    }
-    info.mute = user->muted;
-
-    const unsigned int present_mask =
-        static_cast<unsigned int>(user->chanpresentmask);
-    if (present_mask)
-    {
-      for (int ch = 0; ch < MAX_USER_CHANNELS; ++ch)
-      {
-        if (!(present_mask & (1u << ch))) continue;
-        RemoteUser_Channel *chan = user->channels + ch;
-
-        RemoteChannelInfo ch_info;
-        ch_info.name[0] = '\0';
-        ch_info.name_len = 0;
-        ch_info.channel_index = ch;
-        const char* channel_name = chan->name.Get();
-        const int channel_name_len = chan->name.GetLength();
-        if (channel_name && channel_name_len > 0) {
-          const int copy_len = channel_name_len > kMaxNameLen ? kMaxNameLen : channel_name_len;
-          memcpy(ch_info.name, channel_name, static_cast<size_t>(copy_len));
-          ch_info.name[copy_len] = '\0';
-          ch_info.name_len = copy_len;
-        }
-        ch_info.subscribed = (user->submask & (1u << ch)) != 0;
-        ch_info.volume = chan->volume;
-        ch_info.pan = chan->pan;
-        ch_info.mute = (user->mutedmask & (1u << ch)) != 0;
-        ch_info.solo = (user->solomask & (1u << ch)) != 0;
-        ch_info.vu_left = static_cast<float>(chan->decode_peak_vol[0]);
-        ch_info.vu_right = static_cast<float>(chan->decode_peak_vol[1]);
 
-        info.channels.push_back(std::move(ch_info));
-      }
+  const unsigned int version=m_remote_version.load(std::memory_order_relaxed);
+  const bool full = !view->version || view->local_edits || view->layout_version != m_remote_layout_version;
+  const bool changed = full || view->version != version;
+  const int num_users=m_remoteusers.GetSize();
+
+  if (full)
+  {
+    int num_channels=0;
+    for (int u = 0; u < num_users; u ++)
+    {
+      unsigned int m=(unsigned int)m_remoteusers.Get(u)->chanpresentmask;
+      while (m) { num_channels++; m&=m-1; }
+    }
+
+    // the arrays only grow, so a steady session reuses them as is
+    growViewArray(view->user_version,num_users);
+    growViewArray(view->user_name,num_users*RemoteMixerView::NAME_STRIDE);
+    growViewArray(view->user_mute,num_users);
+    growViewArray(view->user_chan_first,num_users);
+    growViewArray(view->user_chan_count,num_users);
+    growViewArray(view->user_meter_slot,num_users);
+    growViewArray(view->chan_version,num_channels);
+    growViewArray(view->chan_name,num_channels*RemoteMixerView::NAME_STRIDE);
+    growViewArray(view->chan_index,num_channels);
+    growViewArray(view->chan_sub,num_channels);
+    growViewArray(view->chan_mute,num_channels);
+    growViewArray(view->chan_solo,num_channels);
+    growViewArray(view->chan_volume,num_channels);
+    growViewArray(view->chan_pan,num_channels);
+
+    view->num_users=num_users;
+    view->num_channels=num_channels;
+    view->layout_version=m_remote_layout_version;
+    view->local_edits=false;
+  }
+
+  int c=0;
+  for (int u = 0; u < num_users; u ++)
+  {
+    RemoteUser *user=m_remoteusers.Get(u);
+    if (full || user->version > view->version)
+    {
+      view->user_version[u]=user->version;
+      copyViewName(view->UserName(u),user->name);
+      view->user_mute[u]=user->muted;
+    }
+    if (full)
+    {
+      view->user_chan_first[u]=c;
+      view->user_chan_count[u]=0;
+      view->user_meter_slot[u]=user->stats_slot;
     }
 
-    out.push_back(std::move(info));
+    const unsigned int present=(unsigned int)user->chanpresentmask;
+    for (int ch = 0; ch < MAX_USER_CHANNELS && present >= (1u<<ch); ch ++)
+    {
+      if (!(present & (1u<<ch))) continue;
+      RemoteUser_Channel *chan=user->channels+ch;
+
+      if (full || chan->version > view->version)
+      {
+        view->chan_version[c]=chan->version;
+        copyViewName(view->ChanName(c),chan->name);
+        view->chan_index[c]=ch;
+        view->chan_sub[c]=(user->submask & (1u<<ch)) != 0;
+        view->chan_volume[c]=chan->volume;
+        view->chan_pan[c]=chan->pan;
+        view->chan_mute[c]=(user->mutedmask & (1u<<ch)) != 0;
+        view->chan_solo[c]=(user->solomask & (1u<<ch)) != 0;
+      }
+      if (full) view->user_chan_count[u]++;
+      c++;
+    }
   }
+
+  view->version=version;
+  return changed;
 }
 
 void NJClient::SetUserState(int idx, bool setvol, float vol, bool setpan, float pan, bool setmute, bool mute)
@@ -2728,6 +4317,7 @@ void NJClient::SetUserState(int idx, bool setvol, float vol, bool setpan, float
   if (setvol) p->volume=vol;
   if (setpan) p->pan=pan;
   if (setmute) p->muted=mute;
+  if (setvol||setpan||setmute) markRemoteChanged(p,-1,false);
 }
 
 int NJClient::EnumUserChannels(int useridx, int i)
@@ -2782,9 +4372,9 @@ void NJClient::SetUserChannelState(int useridx, int channelidx,
     // toggle subscription
     if (!sub)
     {
-      mpb_client_set_usermask su;
-      su.build_add_rec(user->name.Get(),(user->submask&=~(1u<<channelidx)));
-      m_netcon->Send(su.build());
+      user->submask&=~(1u<<channelidx);
+      user->submask_dirty=true;
+      m_submask_dirty=true;
 
       DecodeState *tmp,*tmp2,*tmp3;
       m_users_cs.Enter();
@@ -2802,9 +4392,9 @@ void NJClient::SetUserChannelState(int useridx, int channelidx,
     }
     else
     {
-      mpb_client_set_usermask su;
-      su.build_add_rec(user->name.Get(),(user->submask|=(1u<<channelidx)));
-      m_netcon->Send(su.build());
+      user->submask|=(1u<<channelidx);
+      user->submask_dirty=true;
+      m_submask_dirty=true;
     }
 
   }
@@ -2818,6 +4408,7 @@ void NJClient::SetUserChannelState(int useridx, int channelidx,
     else
       user->mutedmask &= ~(1u<<channelidx);
   }
+  if (setsub||setvol||setpan||setoutch||setmute||setsolo) markRemoteChanged(user,channelidx,false);
   if (setsolo)
   {
     if (solo) user->solomask |= (1u<<channelidx);
@@ -2968,6 +4559,7 @@ void NJClient::SetLocalChannelInfo(int ch, const char *name, bool setsrcch, int
   if (x == m_locchannels.GetSize())
   {
     m_locchannels.Add(new Local_Channel);
+    prepareLocalChannel(m_locchannels.Get(x));
   }
 
   Local_Channel *c=m_locchannels.Get(x);
@@ -3011,6 +4603,7 @@ void NJClient::SetLocalChannelMonitoring(int ch, bool setvol, float vol, bool se
   if (x == m_locchannels.GetSize())
   {
     m_locchannels.Add(new Local_Channel);
+    prepareLocalChannel(m_locchannels.Get(x));
   }
 
   Local_Channel *c=m_locchannels.Get(x);
@@ -3052,6 +4645,50 @@ int NJClient::GetLocalChannelMonitoring(int ch, float *vol, float *pan, bool *mu
 
 
 void NJClient::NotifyServerOfChannelChange()
+{
+  m_chaninfo_dirty=true;
+}
+
+void NJClient::flushControlMessages()
+{
+  if (!m_netcon)
+  {
+    m_chaninfo_dirty=m_submask_dirty=false;
+    return;
+  }
+
+  if (m_submask_dirty)
+  {
+    m_submask_dirty=false;
+    WDL_MutexLock lock(&m_users_cs);
+    mpb_client_set_usermask su;
+    int sz=0;
+    for (int x = 0; x < m_remoteusers.GetSize(); x ++)
+    {
+      RemoteUser *user=m_remoteusers.Get(x);
+      if (!user->submask_dirty) continue;
+      user->submask_dirty=false;
+
+      const int recsz=(int)strlen(user->name.Get())+1+4;
+      if (sz && sz+recsz > NET_MESSAGE_MAX_SIZE)
+      {
+        m_netcon->Send(su.build()); // build() hands over the message, su starts a new one
+        sz=0;
+      }
+      su.build_add_rec(user->name.Get(),user->submask);
+      sz+=recsz;
+    }
+    if (sz) m_netcon->Send(su.build());
+  }
+
+  if (m_chaninfo_dirty)
+  {
+    m_chaninfo_dirty=false;
+    sendChannelInfo();
+  }
+}
+
+void NJClient::sendChannelInfo()
 {
   if (m_netcon)
   {
@@ -3115,9 +4752,12 @@ void NJClient::SetWorkDir(char *path)
 }
 
 
-RemoteUser_Channel::RemoteUser_Channel() : volume(0.25f), pan(0.0f), out_chan_index(0), flags(0), dump_samples(0), ds(NULL)
+RemoteUser_Channel::RemoteUser_Channel() : volume(0.25f), pan(0.0f), out_chan_index(0), flags(0), version(0), dump_samples(0), ds(NULL),
+  session_want(-1.0), session_ready(NULL), session_spare(NULL)
 {
   decode_peak_vol[0]=decode_peak_vol[1]=0.0;
+  decode_sumsq[0]=decode_sumsq[1]=0.0;
+  decode_meter_n=decode_clip=0;
   memset(next_ds,0,sizeof(next_ds));
   curds_lenleft=0.0;
 }
@@ -3129,13 +4769,27 @@ RemoteUser_Channel::~RemoteUser_Channel()
   delete next_ds[0];
   delete next_ds[1];
   memset(next_ds,0,sizeof(next_ds));
+  delete session_ready;
+  delete session_spare;
   sessioninfo.Empty(true);
 }
 
 
-bool RemoteUser_Channel::GetSessionInfo(double time, unsigned char *guid, double *offs, double *len, double mv)
+bool RemoteUser_Channel::GetSessionInfo(double time, unsigned char *guid, double *offs, double *len, double mv, bool nowait)
+{
+  if (!nowait) sessionlist_mutex.Enter();
+  else if (!sessionlist_mutex.TryEnter())
+  {
+    *len=0.0;
+    return false;
+  }
+  const bool ret=findSessionInfo(time,guid,offs,len,mv);
+  sessionlist_mutex.Leave();
+  return ret;
+}
+
+bool RemoteUser_Channel::findSessionInfo(double time, unsigned char *guid, double *offs, double *len, double mv)
 {
-  WDL_MutexLock lock(&sessionlist_mutex);
 
   mv *= 2.0; // allow one sample poot
   // todo: binary search
@@ -3240,7 +4894,213 @@ next_again:
 
 
 
-RemoteDownload::RemoteDownload() : chidx(-1), playtime(0), m_fp(0), m_decbuf(0)
+RemoteUser *NJClient::findRemoteUser(const char *name) const
+{
+  return name ? m_users_byname.Get(name) : NULL;
+}
+
+void NJClient::addDownload(RemoteDownload *ds)
+{
+  RemoteDownload *old=m_downloads.Get(ds->guid);
+  if (old) // server restarted a transfer with the same GUID, drop the stale one
+  {
+    removeDownload(old);
+    old->chidx=-1;
+    delete old;
+  }
+  m_downloads.Insert(ds->guid,ds);
+  scheduleDownload(ds);
+}
+
+void NJClient::removeDownload(RemoteDownload *ds)
+{
+  if (ds->wheel_slot >= 0) m_download_wheel[ds->wheel_slot].DeletePtr(ds);
+  ds->wheel_slot=-1;
+  m_downloads.Delete(ds->guid);
+}
+
+void NJClient::scheduleDownload(RemoteDownload *ds)
+{
+  // a download expires once now-last_time > DOWNLOAD_TIMEOUT, file it under that second
+  const int slot=(int) ((ds->last_time + DOWNLOAD_TIMEOUT + 1) % DOWNLOAD_WHEEL_SLOTS);
+  if (slot == ds->wheel_slot) return;
+  if (ds->wheel_slot >= 0) m_download_wheel[ds->wheel_slot].DeletePtr(ds);
+  m_download_wheel[slot].Add(ds);
+  ds->wheel_slot=slot;
+}
+
+void NJClient::expireDownloads(time_t now)
+{
+  if (now < m_download_wheel_time) m_download_wheel_time=now; // clock went backwards
+  int nslots=(int) wdl_min(now - m_download_wheel_time, (time_t)DOWNLOAD_WHEEL_SLOTS);
+  if (!nslots) return;
+
+  while (nslots-- > 0)
+  {
+    const int slot=(int) (++m_download_wheel_time % DOWNLOAD_WHEEL_SLOTS);
+    WDL_PtrList<RemoteDownload> *bucket=m_download_wheel+slot;
+    int x=bucket->GetSize();
+    while (x-- > 0)
+    {
+      RemoteDownload *ds=bucket->Get(x);
+      if (now - ds->last_time > DOWNLOAD_TIMEOUT)
+      {
+        if (config_debug_level>1) printf("RECV BLOCK TIMEOUT %s\n",guidtostr_tmp(ds->guid));
+        removeDownload(ds);
+        ds->chidx=-1;
+        delete ds;
+      }
+      else
+      {
+        scheduleDownload(ds); // data arrived since it was filed, move it to its new deadline
+      }
+    }
+  }
+  m_download_wheel_time=now;
+}
+
+void NJClient::deleteAllDownloads()
+{
+  for (int x = 0; x < m_downloads.GetSize(); x ++) delete m_downloads.Enumerate(x);
+  m_downloads.DeleteAll();
+  for (int x = 0; x < DOWNLOAD_WHEEL_SLOTS; x ++) m_download_wheel[x].Empty();
+}
+
+const int NJClient::peer_stats_hist_ms[PEER_STATS_HIST_BINS]={ 50, 100, 250, 500, 1000, 2000, 4000, 0 };
+
+static int peer_stats_bin(double ms)
+{
+  int x;
+  for (x = 0; x < NJClient::PEER_STATS_HIST_BINS-1 && ms >= NJClient::peer_stats_hist_ms[x]; x ++);
+  return x;
+}
+
+NJClient::PeerArrivalStats *NJClient::PeerStatsSlot::BeginWrite()
+{
+  // only Run() writes, so a plain odd/even counter is enough
+  seq.store(seq.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  return &st;
+}
+
+void NJClient::PeerStatsSlot::EndWrite()
+{
+  seq.store(seq.load(std::memory_order_relaxed)+1,std::memory_order_release);
+}
+
+bool NJClient::PeerStatsSlot::Read(PeerArrivalStats *out) const
+{
+  for (int tries = 0; tries < 64; tries ++)
+  {
+    const unsigned int a=seq.load(std::memory_order_acquire);
+    if (a&1) continue;
+    memcpy(out,&st,sizeof(*out));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq.load(std::memory_order_relaxed) == a) return true;
+  }
+  return false;
+}
+
+int NJClient::allocPeerStats(const char *name)
+{
+  for (int x = 0; x < PEER_STATS_MAX; x ++)
+  {
+    if (!m_peerstats[x].st.name[0])
+    {
+      PeerArrivalStats *st=m_peerstats[x].BeginWrite();
+      memset(st,0,sizeof(*st));
+      lstrcpyn_safe(st->name,name && *name ? name : "?",sizeof(st->name));
+      m_peerstats[x].EndWrite();
+      if (config_meters)
+      {
+        // the slot's previous user is gone, so the audio thread isn't writing these
+        for (int ch = 0; ch < MAX_USER_CHANNELS; ch ++)
+          config_meters->meters[NJMeterBank::Remote(x,ch)].Reset();
+      }
+      return x;
+    }
+  }
+  return -1;
+}
+
+void NJClient::freePeerStats(int slot)
+{
+  if (slot < 0 || slot >= PEER_STATS_MAX || !m_peerstats[slot].st.name[0]) return;
+  m_peerstats[slot].BeginWrite()->name[0]=0;
+  m_peerstats[slot].EndWrite();
+}
+
+void NJClient::recordArrival(RemoteDownload *ds)
+{
+  WDL_MutexLock lock(&m_users_cs);
+  RemoteUser *theuser=findRemoteUser(ds->username.Get());
+  if (!theuser || theuser->stats_slot < 0) return;
+
+  PeerArrivalStats *st=m_peerstats[theuser->stats_slot].BeginWrite();
+  st->bytes+=ds->bytes;
+  if (!ds->completed)
+  {
+    st->dropped++;
+  }
+  else
+  {
+    const bool first=!st->intervals++;
+    if (ds->t_first > 0.0)
+    {
+      const double fb=(ds->t_first - ds->t_begin)*1000.0;
+      st->avg_first_byte_ms = first ? fb : st->avg_first_byte_ms*0.8 + fb*0.2;
+      if (theuser->arrival.Add(ds->bytes,ds->t_first,ds->t_last,ds->max_gap))
+      {
+        const double rate=ds->bytes / (ds->t_last - ds->t_first);
+        st->kbps = st->kbps <= 0.0 ? rate*0.008 : st->kbps*0.8 + rate*0.008*0.2;
+        if (theuser->arrival.Learned()) st->prebuffer=getPlayPrebuffer(theuser,0);
+      }
+    }
+    if (ds->t_needed > 0.0 && ds->t_play > 0.0)
+    {
+      const double slack=(ds->t_needed - ds->t_play)*1000.0;
+      int timed=st->late;
+      for (int x = 0; x < PEER_STATS_HIST_BINS; x ++) timed+=st->slack_hist[x];
+      if (!timed || slack < st->min_slack_ms) st->min_slack_ms=slack;
+      st->last_slack_ms=slack;
+      if (slack >= 0.0)
+      {
+        st->slack_hist[peer_stats_bin(slack)]++;
+      }
+      else
+      {
+        st->late++;
+        st->late_hist[peer_stats_bin(-slack)]++;
+        if (config_debug_level>0) printf("LATE INTERVAL %s %s by %.0fms\n",ds->username.Get(),guidtostr_tmp(ds->guid),-slack);
+      }
+    }
+  }
+  m_peerstats[theuser->stats_slot].EndWrite();
+}
+
+// playback of an interval can start once it has enough data buffered to ride out the
+// longest stall we've seen from this peer at the rate its data arrives
+int NJClient::getPlayPrebuffer(const RemoteUser *user, int chanflags) const
+{
+  const int def=config_play_prebuffer.load(std::memory_order_relaxed);
+  const bool adaptive=config_adaptive_prebuffer.load(std::memory_order_relaxed);
+  if (!user) return (chanflags&2) ? LIVE_PREBUFFER : def;
+  return user->arrival.Prebuffer(chanflags,def,adaptive);
+}
+
+int NJClient::GetPeerArrivalStats(PeerArrivalStats *list, int maxlist) const
+{
+  int n=0;
+  for (int x = 0; x < PEER_STATS_MAX && n < maxlist; x ++)
+  {
+    if (m_peerstats[x].Read(list+n) && list[n].name[0]) n++;
+  }
+  return n;
+}
+
+RemoteDownload::RemoteDownload() : wheel_slot(-1), chidx(-1), playtime(0),
+  t_begin(0.0), t_first(0.0), t_last(0.0), t_play(0.0), t_needed(0.0), max_gap(0.0), bytes(0), completed(false),
+  m_fp(0), m_decbuf(0), m_cached(false), m_session(false)
 {
   memset(&guid,0,sizeof(guid));
   time(&last_time);
@@ -3256,12 +5116,24 @@ void RemoteDownload::Close()
   if (m_fp) fclose(m_fp);
   m_fp=0;
   startPlaying(1);
+  if (m_parent && t_begin > 0.0) m_parent->recordArrival(this);
+  t_begin=0.0;
+  if (m_cached)
+  {
+    m_parent->m_intervalcache->SetComplete(guid);
+    m_parent->m_intervalcache->Trim(m_parent,m_parent->config_interval_cache_bytes,!!m_parent->config_interval_cache_spill);
+    m_cached=false;
+  }
   if (m_decbuf)
   {
     m_decbuf->Release();
     m_decbuf=0;
   }
-
+  if (m_session)
+  {
+    if (m_parent->config_pcm_cache_bytes > 0) m_parent->m_pcmcache->Request(guid);
+    m_session=false;
+  }
 }
 
 void RemoteDownload::Open(NJClient *parent, unsigned int fourcc, bool forceToDisk)
@@ -3269,7 +5141,21 @@ void RemoteDownload::Open(NJClient *parent, unsigned int fourcc, bool forceToDis
   m_parent=parent;
   Close();
   m_fp=0;
-  m_decbuf=new DecodeMediaBuffer;
+  m_fourcc=fourcc;
+  m_session=forceToDisk && parent;
+
+  // session-mode intervals are only ever read back by GUID, keep them in memory if we can
+  if (forceToDisk && parent && parent->config_interval_cache_bytes > 0)
+  {
+    m_decbuf=parent->m_intervalcache->Insert(guid,fourcc);
+    if (m_decbuf)
+    {
+      m_cached=true;
+      forceToDisk=false;
+    }
+  }
+  if (!m_decbuf) m_decbuf=new DecodeMediaBuffer;
+
   if (!m_decbuf || !parent || parent->config_savelocalaudio>0 || forceToDisk)
   {
     WDL_String s;
@@ -3282,7 +5168,6 @@ void RemoteDownload::Open(NJClient *parent, unsigned int fourcc, bool forceToDis
     s.Append(".");
     s.Append(buf);
 
-    m_fourcc=fourcc;
     m_fp=fopenUTF8(s.Get(),"wb");
   }
 }
@@ -3304,10 +5189,8 @@ void RemoteDownload::startPlaying(int force)
     // wait until we have config_play_prebuffer of data to start playing, or if config_play_prebuffer is 0, we are forced to play (download finished)
   {
     WDL_MutexLock lock(&m_parent->m_users_cs);
-    int x;
-    RemoteUser *theuser;
-    for (x = 0; x < m_parent->m_remoteusers.GetSize() && strcmp((theuser=m_parent->m_remoteusers.Get(x))->name.Get(),username.Get()); x ++);
-    if (x < m_parent->m_remoteusers.GetSize() && chidx >= 0 && chidx < MAX_USER_CHANNELS)
+    RemoteUser *theuser=m_parent->findRemoteUser(username.Get());
+    if (theuser && chidx >= 0 && chidx < MAX_USER_CHANNELS)
     {
     //  char buf[512];
   //    sprintf(buf,"download %s:%d flags=%d\n",username.Get(),chidx,theuser->channels[chidx].flags);
@@ -3315,6 +5198,7 @@ void RemoteDownload::startPlaying(int force)
 
       if (!(theuser->channels[chidx].flags&4)) // only "play" if not a session channel
       {
+        t_play=time_precise();
         DecodeState *tmp=m_parent->start_decode(guid,theuser->channels[chidx].flags,m_fourcc,m_decbuf);
 
 //        OutputDebugString(tmp?"started new decde\n":"tried to start new decode\n");
@@ -3332,8 +5216,14 @@ void RemoteDownload::startPlaying(int force)
   }
 }
 
-void RemoteDownload::Write(const void *buf, int len)
+void RemoteDownload::Write(const void *buf, int len, Net_Message *src)
 {
+  const double now=time_precise();
+  if (t_first <= 0.0) t_first=now;
+  else if (now - t_last > max_gap) max_gap=now - t_last;
+  t_last=now;
+  bytes+=len;
+
   if (m_fp)
   {
     fwrite(buf,1,len,m_fp);
@@ -3341,20 +5231,44 @@ void RemoteDownload::Write(const void *buf, int len)
   }
   if (m_decbuf)
   {
-    m_decbuf->Write(buf,len);
+    if (src) m_decbuf->WriteRef(src,buf,len);
+    else m_decbuf->Write(buf,len);
   }
+  if (m_cached) m_parent->m_intervalcache->NoteWrite(guid,len); // trimmed once in Close()
 
   startPlaying();
 }
 
 
+bool IntervalCache::spillEntry(NJClient *parent, Entry *e)
+{
+  WDL_String s;
+  parent->makeFilenameFromGuid(&s,e->guid);
+
+  char buf[8];
+  type_to_string(e->fourcc, buf);
+  s.Append(".");
+  s.Append(buf);
+
+  FILE *fp=fopenUTF8(s.Get(),"wb");
+  if (!fp) return false;
+  const bool ok=e->buf->WriteToFile(fp);
+  fclose(fp);
+  return ok;
+}
+
+
 Local_Channel::Local_Channel() : channel_idx(0), src_channel(0), volume(1.0f), pan(0.0f),
                 muted(false), solo(false), broadcasting(false),
 #ifndef NJCLIENT_NO_XMIT_SUPPORT
                 m_enc(NULL),
                 m_enc_bitrate_used(0),
                 m_enc_nch_used(0),
+                m_enc_next(NULL),
+                m_enc_next_bitrate(0),
+                m_enc_next_nch(0),
                 m_enc_header_needsend(NULL),
+                m_send_prio(NET_CON_PRIO_BULK),
 #endif
                 bcast_active(false), cbf(NULL), cbf_inst(NULL),
                 bitrate(64), m_need_header(true), out_chan_index(0), flags(0),
@@ -3411,7 +5325,7 @@ void BufferQueue::AddBlock(int attr, double startpos, float *samples, int len, f
   {
     m_cs.Enter();
 
-    if (m_samplequeue.GetSize() > 512*2)
+    if (m_samplequeue.GetSize() > MAX_QUEUED_BLOCKS*2)
     {
       m_cs.Leave();
       return;
@@ -3423,7 +5337,11 @@ void BufferQueue::AddBlock(int attr, double startpos, float *samples, int len, f
       if (mybuf) m_emptybufs.Delete(tmp-1);
     }
     m_cs.Leave();
-    if (!mybuf) mybuf=new WDL_HeapBuf;
+    if (!mybuf)
+    {
+      NJ_AUDIO_GROWTH("BufferQueue ran out of pooled blocks");
+      mybuf=new WDL_HeapBuf;
+    }
 
     int uselen=len*sizeof(float);
     if (samples2)
@@ -3431,7 +5349,8 @@ void BufferQueue::AddBlock(int attr, double startpos, float *samples, int len, f
       uselen+=uselen;
     }
 
-    mybuf->Resize(uselen);
+    if (uselen > mybuf->GetAlloc()) NJ_AUDIO_GROWTH("BufferQueue block grew");
+    mybuf->Resize(uselen,false);
 
     memcpy(mybuf->Get(),samples,len*sizeof(float));
     if (samples2)
@@ -3449,7 +5368,11 @@ void BufferQueue::AddBlock(int attr, double startpos, float *samples, int len, f
     m_emptybufs_attr.Delete(esz-1);
   }
 
-  if (!attrbuf) attrbuf=new WDL_HeapBuf;
+  if (!attrbuf)
+  {
+    NJ_AUDIO_GROWTH("BufferQueue ran out of pooled attributes");
+    attrbuf=new WDL_HeapBuf;
+  }
   AttrStruct *as=(AttrStruct *)attrbuf->Resize(sizeof(AttrStruct));
 
   as->attr=attr;
@@ -3461,11 +5384,50 @@ void BufferQueue::AddBlock(int attr, double startpos, float *samples, int len, f
   m_cs.Leave();
 }
 
+void BufferQueue::Prealloc(int nblocks, int blockbytes)
+{
+  m_cs.Enter();
+  // the lists themselves never need to grow past a full queue
+  const int maxents=MAX_QUEUED_BLOCKS*2+2;
+  m_samplequeue.Prealloc(maxents);
+  m_emptybufs.Prealloc(maxents);
+  m_emptybufs_attr.Prealloc(maxents);
+  m_locked.Release(); // relocked below, lists may have moved
+
+  int x;
+  for (x = 0; x < m_emptybufs.GetSize(); x ++)
+  {
+    WDL_HeapBuf *b=m_emptybufs.Get(x);
+    b->Prealloc(blockbytes);
+    m_locked.Lock(b->GetFast(),b->GetAlloc());
+  }
+  while (m_emptybufs.GetSize() < nblocks)
+  {
+    WDL_HeapBuf *b=new WDL_HeapBuf;
+    b->Prealloc(blockbytes);
+    m_locked.Lock(b->GetFast(),b->GetAlloc());
+    m_emptybufs.Add(b);
+  }
+  while (m_emptybufs_attr.GetSize() < nblocks)
+  {
+    WDL_HeapBuf *b=new WDL_HeapBuf(sizeof(AttrStruct));
+    b->Prealloc(sizeof(AttrStruct));
+    m_locked.Lock(b->GetFast(),b->GetAlloc());
+    m_emptybufs_attr.Add(b);
+  }
+  m_locked.Lock(m_samplequeue.GetList(),maxents*sizeof(WDL_HeapBuf*));
+  m_locked.Lock(m_emptybufs.GetList(),maxents*sizeof(WDL_HeapBuf*));
+  m_locked.Lock(m_emptybufs_attr.GetList(),maxents*sizeof(WDL_HeapBuf*));
+  m_cs.Leave();
+}
+
 Local_Channel::~Local_Channel()
 {
 #ifndef NJCLIENT_NO_XMIT_SUPPORT
   delete m_enc;
   m_enc=0;
+  delete m_enc_next;
+  m_enc_next=0;
   delete m_enc_header_needsend;
   m_enc_header_needsend=0;
 #endif
@@ -71,6 +71,7 @@
 #include <vector>
 #include "../wdl/wdlstring.h"
 #include "../wdl/ptrlist.h"
+#include "../wdl/assocarray.h"
 #include "../wdl/jnetlib/jnetlib.h"
 #include "../wdl/sha.h"
 #include "../wdl/rng.h"
@@ -89,6 +90,10 @@ class Local_Channel;
 class DecodeState;
 class BufferQueue;
 class DecodeMediaBuffer;
+class IntervalCache;
+class PcmCache;
+class AudioMemLock;
+struct NJMeterBank;
 
 // #define NJCLIENT_NO_XMIT_SUPPORT // might want to do this for njcast :)
 //  it also removes mixed ogg writing support
@@ -96,6 +101,8 @@ class DecodeMediaBuffer;
 class NJClient
 {
   friend class RemoteDownload;
+  friend class IntervalCache;
+  friend class PcmCache;
 public:
   static constexpr int kRemoteNameMax = 128;
 
@@ -114,6 +121,11 @@ public:
   // call AudioProc, (and only AudioProc) from your audio thread
   void AudioProc(float **inbuf, int innch, float **outbuf, int outnch, int len, int srate, bool justmonitor=false, bool isPlaying=true, bool isSeek=false, double cursessionpos=-1.0); // len is number of sample pairs or samples
 
+  // call while AudioProc isn't running (e.g. at activate): sizes every buffer AudioProc writes for
+  // blocks of up to maxlen, and locks them in memory where supported (Linux). Local channels added
+  // later are sized the same way. Debug builds then assert if AudioProc grows any of them.
+  void PrepareAudio(int maxlen, int srate);
+
 
   // Basic configuration (non-atomic, require state_mutex)
   int   config_autosubscribe;
@@ -130,15 +142,124 @@ public:
   std::atomic<float> config_masterpan{0.0f};      // master pan
   std::atomic<bool>  config_mastermute{false};
   std::atomic<int>   config_play_prebuffer{8192}; // -1 means play instantly, 0 means play when full file is there
+  std::atomic<bool>  config_adaptive_prebuffer{true}; // size each peer's prebuffer from its measured arrival rate and stalls
+                                                      // once learned. normal channels only adapt while config_play_prebuffer > 0
 
   // Non-atomic config fields (require state_mutex)
   int   config_debug_level;
   int config_remote_autochan; // 1=auto-assign by channel, 2=auto-assign by user
   int config_remote_autochan_nch;
 
+  // session-mode (flags&4) intervals are kept in memory, up to this many bytes, rather than being
+  // forced to disk. 0 disables the cache. if spill is set, evicted intervals are written to disk.
+  int config_interval_cache_bytes;
+  int config_interval_cache_spill;
+
+  struct IntervalCacheStats
+  {
+    int hits, misses;   // start_decode() lookups for session-mode intervals
+    int spills;         // evicted intervals written to disk
+    int entries;
+    WDL_INT64 bytes_resident;
+  };
+  void GetIntervalCacheStats(IntervalCacheStats *st);
+
+  // completed session-mode intervals are decoded in Run() and kept as PCM, up to this many
+  // bytes, so looping playback doesn't decode them again on the audio thread. 0 disables.
+  int config_pcm_cache_bytes;
+
+  struct PcmCacheStats
+  {
+    int hits, misses;   // start_decode() lookups for session-mode intervals
+    int entries, pending;
+    WDL_INT64 bytes_resident;
+  };
+  void GetPcmCacheStats(PcmCacheStats *st);
+
+  // send-side counters of the current connection, call from the Run() thread. false if not connected
+  bool GetNetSendStats(Net_Connection::Stats *st);
+
+  // when the send queue backs up, local channels are encoded below their configured bitrate (but
+  // not below config_upload_bitrate_min kbps), stepping back up once the uplink keeps up again.
+  // no channel is ever encoded above config_upload_bitrate_max kbps, adapting or not.
+  // changes take effect at interval boundaries.
+  int config_upload_adapt;
+  int config_upload_bitrate_min;
+  int config_upload_bitrate_max;
+
+  struct UploadRateStats
+  {
+    int scale_pct;      // encode bitrate as a percentage of each channel's configured bitrate, capped at the max
+    int backlog_bytes;  // queued but not yet sent, at the last interval boundary
+    int drain_kbps, produce_kbps; // over the last interval
+    int steps_down, steps_up, decisions;
+  };
+  void GetUploadRateStats(UploadRateStats *st);
+
+  // a connection that receives nothing for this long is dropped as half-open. 0 uses three
+  // keepalive intervals (the server's, or 3s each). applied at Connect()
+  int config_halfopen_timeout_ms;
+
+  // RTT, jitter and stall counters of the current connection, as of the last Run() pass.
+  // can be called from any thread. false if not connected (rtt fields are -1 until measured)
+  bool GetConnectionHealth(Net_Connection::Health *h);
+
+  // if an established connection drops, reconnect up to this many times (backing off between
+  // attempts) before giving up with NJC_STATUS_DISCONNECTED. remote users with their mixer and
+  // subscription settings, and the decoders, are kept across the drop. 0 disables
+  int config_auto_reconnect;
+  int GetReconnectAttempt() const { return m_reconnect_attempt; } // 0 if not reconnecting
+
+  // name resolver for connections, e.g. a cache shared with other lookups. NULL gives each
+  // connection its own JNL_AsyncDNS. not owned
+  JNL_IAsyncDNS *config_dns;
+
+  // if set, AudioProc() keeps a meter per channel here (see NJMeterBank). set before audio
+  // starts; not owned, so readers can keep using it after the client is gone
+  NJMeterBank *config_meters;
+
+  // open a TCP connection to host ("host:port") ahead of a likely Connect() to it. the server's
+  // auth challenge waits in the socket buffer; Connect() takes the connection over if it comes
+  // within PREWARM_MAX_AGE seconds, otherwise it is dropped. ignored while connected
+  static const int PREWARM_MAX_AGE=10;
+  void PrewarmConnection(const char *host);
+
+  // how long each step of the last connect took, Run() thread only
+  struct ConnectTimings
+  {
+    double resolve_ms, tcp_ms, challenge_ms, auth_ms; // -1 for steps not reached
+    double total_ms; // Connect() to auth reply, -1 until then
+    bool prewarmed;  // used a connection from PrewarmConnection()
+  };
+  bool GetConnectTimings(ConnectTimings *t); // false if no connect has been started
+
+  // per-peer arrival timing of remote intervals, measured with time_precise(). updated by Run(),
+  // GetPeerArrivalStats() can be called from any thread without locking.
+  // slack is how long before the interval boundary it was needed for an interval started
+  // playing, lateness how long after. only normal-mode channels count toward these (live and
+  // session channels aren't tied to a boundary).
+  enum { PEER_STATS_MAX=64, PEER_STATS_HIST_BINS=8 };
+  static const int peer_stats_hist_ms[PEER_STATS_HIST_BINS]; // upper bound of each bin, the last is open-ended
+  struct PeerArrivalStats
+  {
+    char name[kRemoteNameMax];
+    int intervals;    // downloads completed
+    int late;         // started playing after the boundary they were needed for
+    int dropped;      // timed out or replaced before completing
+    int slack_hist[PEER_STATS_HIST_BINS];
+    int late_hist[PEER_STATS_HIST_BINS];
+    double last_slack_ms; // negative if late
+    double min_slack_ms;
+    double avg_first_byte_ms; // DOWNLOAD_INTERVAL_BEGIN to first data, smoothed
+    double kbps;      // first to last byte, smoothed
+    WDL_INT64 bytes;
+    int prebuffer;    // adaptive prebuffer in bytes for this peer's next interval, 0 until learned
+  };
+  int GetPeerArrivalStats(PeerArrivalStats *list, int maxlist) const; // returns the number of peers written
+
   float GetOutputPeak(int ch=-1);
 
-  enum { NJC_STATUS_DISCONNECTED=-3,NJC_STATUS_INVALIDAUTH=-2, NJC_STATUS_CANTCONNECT=-1, NJC_STATUS_OK=0, NJC_STATUS_PRECONNECT};
+  enum { NJC_STATUS_DISCONNECTED=-3,NJC_STATUS_INVALIDAUTH=-2, NJC_STATUS_CANTCONNECT=-1, NJC_STATUS_OK=0, NJC_STATUS_PRECONNECT, NJC_STATUS_RECONNECTING};
   int GetStatus();
 
   // Lock-free status access for audio thread
@@ -150,8 +271,9 @@ public:
   const char *GetUser() { return m_user.Get(); }
   const char *GetHostName() { return m_host.Get(); }
 
-  float GetActualBPM() { return (float) m_active_bpm; }
-  int GetBPI() { return m_active_bpi; }
+  // these read the timing last published by AudioProc(), and never block
+  float GetActualBPM();
+  int GetBPI();
   void GetPosition(int *pos, int *length);  // positions in samples
   int GetLoopCount() { return m_loopcnt; }
   unsigned int GetSessionPosition(); // returns milliseconds
@@ -161,27 +283,45 @@ public:
   const char *GetUserState(int idx, float *vol=0, float *pan=0, bool *mute=0);
   void SetUserState(int idx, bool setvol, float vol, bool setpan, float pan, bool setmute, bool mute);
 
-  struct RemoteChannelInfo {
-    char name[kRemoteNameMax + 1] = {};
-    int name_len = 0;
-    int channel_index = -1;
-    bool subscribed = false;
-    float volume = 1.0f;
-    float pan = 0.0f;
-    bool mute = false;
-    bool solo = false;
-    float vu_left = 0.0f;
-    float vu_right = 0.0f;
-  };
-
-  struct RemoteUserInfo {
-    char name[kRemoteNameMax + 1] = {};
-    int name_len = 0;
-    bool mute = false;
-    std::vector<RemoteChannelInfo> channels;
+  // Flat copy of the remote users and their mixer settings, for other threads. Users and
+  // channels are parallel arrays, channels grouped by user: user u owns
+  // [user_chan_first[u], user_chan_first[u]+user_chan_count[u]). Arrays only ever grow, so
+  // once they fit the session, refreshing a view doesn't allocate.
+  //
+  // Each user and channel carries the GetRemoteVersion() it last changed at, so consumers can
+  // tell what changed since they last looked.
+  struct RemoteMixerView
+  {
+    enum { NAME_STRIDE=kRemoteNameMax+1 };
+
+    unsigned int version = 0;        // GetRemoteVersion() this view is current to, 0 if never filled
+    unsigned int layout_version = 0; // version the user/channel list last changed at
+    bool local_edits = false;        // set by consumers that edit in place, forces a full copy
+
+    int num_users = 0, num_channels = 0;
+
+    std::vector<unsigned int> user_version;
+    std::vector<char> user_name; // NAME_STRIDE per user
+    std::vector<unsigned char> user_mute;
+    std::vector<int> user_chan_first, user_chan_count;
+    std::vector<int> user_meter_slot; // for NJMeterBank::Remote(), -1 if none
+
+    std::vector<unsigned int> chan_version;
+    std::vector<char> chan_name; // NAME_STRIDE per channel
+    std::vector<int> chan_index; // channel index within its user
+    std::vector<unsigned char> chan_sub, chan_mute, chan_solo;
+    std::vector<float> chan_volume, chan_pan;
+
+    char *UserName(int u) { return user_name.data() + u*NAME_STRIDE; }
+    const char *UserName(int u) const { return user_name.data() + u*NAME_STRIDE; }
+    char *ChanName(int c) { return chan_name.data() + c*NAME_STRIDE; }
+    const char *ChanName(int c) const { return chan_name.data() + c*NAME_STRIDE; }
   };
 
-  void GetRemoteUsersSnapshot(std::vector<RemoteUserInfo>& out);
+  unsigned int GetRemoteVersion() const { return m_remote_version.load(std::memory_order_acquire); } // bumped on any remote user/channel change
+  // copies only the users and channels changed since view->version (everything, if users or
+  // channels came or went). meters are in config_meters. returns true if anything changed
+  bool UpdateRemoteMixerView(RemoteMixerView *view);
 
   float GetUserChannelPeak(int useridx, int channelidx, int whichch=-1);
   double GetUserSessionPos(int useridx, time_t *lastupdatetime, double *maxlen);
@@ -199,7 +339,7 @@ public:
   const char *GetLocalChannelInfo(int ch, int *srcch, int *bitrate, bool *broadcast, int *outch=0, int *flags=0);
   void SetLocalChannelMonitoring(int ch, bool setvol, float vol, bool setpan, float pan, bool setmute, bool mute, bool setsolo, bool solo);
   int GetLocalChannelMonitoring(int ch, float *vol, float *pan, bool *mute, bool *solo); // 0 on success
-  void NotifyServerOfChannelChange(); // call after any SetLocalChannel* that occur after initial connect
+  void NotifyServerOfChannelChange(); // call after any SetLocalChannel* that occur after initial connect. sent on the next Run()
 
   void SetMetronomeChannel(int chidx) { 
     config_metronome_channel.store(chidx, std::memory_order_relaxed);
@@ -245,6 +385,16 @@ public:
   int (*ChannelMixer)(void *userData, float **inbuf, int in_offset, int innch, int chidx, float *outbuf, int len);
   void *ChannelMixer_User;
 
+  // true if a broadcasting channel queued captured audio for Run() to encode, or a session-mode
+  // channel asked Run() to decode an interval, since the last call.
+  // the audio thread only sets a flag (no syscalls), so a Run() thread that blocks between calls
+  // should poll this and keep its wait short while it returns true. call from the Run() thread
+  bool TakeWorkAvailable() { return m_work_avail.exchange(false,std::memory_order_acquire); }
+
+  // socket the Run() thread can wait on between Run() calls, INVALID_SOCKET if none yet.
+  // *wantwrite is set if data is waiting to be sent. call from the Run() thread
+  SOCKET GetNetSocket(bool *wantwrite);
+
   WDL_Mutex m_remotechannel_rd_mutex;
 
   bool is_likely_lobby() const {
@@ -257,6 +407,15 @@ protected:
   double output_peaklevel[2];
 
   void _reinit();
+  void startConnection(); // connect to m_host as m_user
+  JNL_Connection *openConnection(const char *hostport);
+  void connectPhaseDone(int phase); // CONNECT_PHASE_*, earlier phases not seen count as 0ms
+  enum { CONNECT_PHASE_RESOLVE=0, CONNECT_PHASE_TCP, CONNECT_PHASE_CHALLENGE, CONNECT_PHASE_AUTH, CONNECT_PHASE_DONE };
+  void closeConnection(); // drop the connection and everything tied to it, but not remote users
+  void beginReconnect();
+  void pruneStaleUsers(); // users/channels the server didn't list again after a reconnect
+  void clearRemoteChannel(RemoteUser *user, int cid); // caller must hold m_users_cs
+  void markRemoteChanged(RemoteUser *user, int cid, bool layout); // caller must hold m_users_cs
 
   void makeFilenameFromGuid(WDL_String *s, unsigned char *guid);
 
@@ -280,27 +439,66 @@ protected:
 #endif
 
   WDL_String m_user, m_pass, m_host;
+  WDL_String m_login_user; // as passed to Connect(), m_user may be changed by the server
+  int m_reconnect_attempt;
+  double m_reconnect_time;  // time_precise() of the next attempt
+  double m_reconnect_prune; // time_precise() to run pruneStaleUsers(), 0 if not pending
+
+  JNL_Connection *m_prewarm_con;
+  WDL_String m_prewarm_host;
+  double m_prewarm_time;
+
+  int m_connect_phase; // CONNECT_PHASE_*, -1 if no connect started
+  double m_connect_start, m_connect_mark;
+  ConnectTimings m_connect_timings;
 
   int m_in_auth;
   int m_bpm,m_bpi;
   int m_beatinfo_updated;
   int m_audio_enable;
   int m_srate;
+  int m_audio_maxlen, m_audio_prep_srate; // from PrepareAudio(), 0 if not prepared
   int m_userinfochange;
   int m_issoloactive;
-  bool m_debug_logged_remote;
 
   unsigned int m_session_pos_ms,m_session_pos_samples; // samples just keeps track of any samples lost to precision errors
 
   int m_loopcnt;
+  std::atomic<bool> m_work_avail;
+  std::atomic<DecodeState*> m_ds_retired; // pushed by the audio thread, freed by Run()
+  void retireDecodeState(DecodeState *ds);
+  void freeRetiredDecodeStates();
   int m_active_bpm, m_active_bpi;
   int m_interval_length;
   int m_interval_pos, m_metronome_state, m_metronome_tmp,m_metronome_interval;
   double m_metronome_pos;
 
+  // The audio thread's interval timing, seqlocked for other threads. only AudioProc() (and the
+  // constructor) publish, so a plain odd/even counter is enough, same as PeerStatsSlot.
+  //
+  // Shared state is split by domain, none of which is held across a whole Run() pass:
+  //   connection     - m_netcon and friends, Run thread only; status via cached_status
+  //   local channels - m_locchan_cs (m_upload_cs for the upload rate stats)
+  //   remote users   - m_users_cs; peer stats are seqlocked per slot
+  //   timing         - m_misc_cs for pending bpm/bpi, m_timing for readers
+  //   health         - m_health_cs
+  struct TimingInfo
+  {
+    int interval_pos, interval_length;
+    int bpm, bpi;
+  };
+  std::atomic<unsigned int> m_timing_seq;
+  TimingInfo m_timing;
+  void publishTiming();
+  void readTiming(TimingInfo *out) const;
+
   int m_metro_chidx, m_remote_chanoffs, m_local_chanoffs;
 
+  // allocates and opens the decoder, Run() thread only. session-mode channels get theirs from
+  // prepareSessionDecodes(), mixInChannel() only takes them (takeSessionDecode())
   DecodeState *start_decode(unsigned char *guid, int chanflags, unsigned int fourcc, DecodeMediaBuffer *decbuf);
+  void prepareSessionDecodes();
+  DecodeState *takeSessionDecode(RemoteUser_Channel *userchan, const unsigned char *guid);
 
   BufferQueue *m_wavebq;
 
@@ -310,12 +508,71 @@ protected:
                     bool muted, float vol, float pan, float **outbuf, int out_channel,
                     int len, int srate, int outnch, int offs, double vudecay, bool isPlaying, bool isSeek, double playPos);
 
-  WDL_Mutex m_users_cs, m_locchan_cs, m_log_cs, m_misc_cs;
+  WDL_Mutex m_users_cs, m_locchan_cs, m_log_cs, m_misc_cs, m_upload_cs, m_health_cs;
   Net_Connection *m_netcon;
   WDL_PtrList<RemoteUser> m_remoteusers;
-  WDL_PtrList<RemoteDownload> m_downloads;
+  WDL_StringKeyedArray<RemoteUser *> m_users_byname; // case-sensitive like the server, protected by m_users_cs
+  RemoteUser *findRemoteUser(const char *name) const; // caller must hold m_users_cs
+  std::atomic<unsigned int> m_remote_version; // written under m_users_cs
+  unsigned int m_remote_layout_version; // protected by m_users_cs
+
+  // downloads in progress, keyed by RemoteDownload::guid. each is also in the
+  // timer wheel slot for the second it would time out, checked lazily by expireDownloads()
+  enum { DOWNLOAD_WHEEL_SLOTS=16 };
+  WDL_AssocArray<const unsigned char *, RemoteDownload *> m_downloads;
+  WDL_PtrList<RemoteDownload> m_download_wheel[DOWNLOAD_WHEEL_SLOTS];
+  time_t m_download_wheel_time;
+  void addDownload(RemoteDownload *ds);
+  void removeDownload(RemoteDownload *ds);
+  void scheduleDownload(RemoteDownload *ds);
+  void expireDownloads(time_t now);
+  void deleteAllDownloads();
+
+  // seqlocked so GetPeerArrivalStats() never blocks Run(). a slot is free when st.name is empty
+  struct PeerStatsSlot
+  {
+    std::atomic<unsigned int> seq;
+    PeerArrivalStats st;
+
+    PeerArrivalStats *BeginWrite();
+    void EndWrite();
+    bool Read(PeerArrivalStats *out) const;
+  };
+  PeerStatsSlot m_peerstats[PEER_STATS_MAX];
+  int allocPeerStats(const char *name);
+  void freePeerStats(int slot);
+  void recordArrival(RemoteDownload *ds);
+  int getPlayPrebuffer(const RemoteUser *user, int chanflags) const;
+
+  // subscription and channel info changes are sent once per Run() pass, as one message each
+  bool m_chaninfo_dirty;
+  bool m_submask_dirty; // at least one RemoteUser::submask_dirty is set
+  void flushControlMessages();
+  void sendChannelInfo();
+
+  int getUploadBitrate(const Local_Channel *lc) const;
+  void writeUploadCopy(Local_Channel *lc, Net_Message *msg); // msg is a built upload interval write, or NULL
+  void updateUploadRate(); // once per local interval boundary, from Run()
+  int m_upload_level; // index into upload_rate_steps
+  int m_upload_good_intervals;
+  double m_upload_last_time;
+  WDL_INT64 m_upload_last_queued, m_upload_last_sent;
+  UploadRateStats m_upload_stats; // protected by m_upload_cs
+  Net_Connection::Health m_health; // protected by m_health_cs
+  bool m_health_valid;
+  double m_auth_sent_time; // time_precise() our auth reply was queued, 0 once answered
+  IntervalCache *m_intervalcache;
+  PcmCache *m_pcmcache;
 
   WDL_HeapBuf tmpblock;
+  AudioMemLock *m_audiomem; // what PrepareAudio() mlock()ed
+
+  int audioQueueBlocks() const;
+  void prepareLocalChannel(Local_Channel *lc);
+
+  // audio thread, when config_meters is set. peaks are already decayed, sumsq covers n samples
+  void updateMeter(int idx, double peak_l, double peak_r, double sumsq_l, double sumsq_r, int n,
+                   int clip, int len, int srate, double decay);
 
   int find_unused_output_channel_pair() const;
 };
@@ -327,4 +584,106 @@ protected:
 #define DOWNLOAD_TIMEOUT 8
 
 
+// One meter per cache line, so the UI reading one never shares a line with the audio thread
+// writing the next. Only the audio thread writes (relaxed); any thread may read.
+struct alignas(64) NJMeter
+{
+  enum { CLIP_L=1, CLIP_R=2 };
+
+  std::atomic<float> peak[2];
+  std::atomic<float> rms[2];
+  std::atomic<int> clip; // CLIP_*, held for a couple of seconds after the last clipped block
+  int clip_hold; // samples left to hold clip, audio thread only
+
+  NJMeter() : clip_hold(0) { Reset(); }
+  void Reset()
+  {
+    for (int x = 0; x < 2; x ++)
+    {
+      peak[x].store(0.0f,std::memory_order_relaxed);
+      rms[x].store(0.0f,std::memory_order_relaxed);
+    }
+    clip.store(0,std::memory_order_relaxed);
+  }
+};
+
+// Every meter the client drives, at fixed indices: master, then the local channels by
+// channel index, then MAX_USER_CHANNELS per remote user by the user's peer stats slot
+// (RemoteMixerView::user_meter_slot).
+struct NJMeterBank
+{
+  enum
+  {
+    MASTER=0,
+    LOCAL_FIRST=1,
+    REMOTE_FIRST=LOCAL_FIRST+MAX_LOCAL_CHANNELS,
+    REMOTE_USERS=NJClient::PEER_STATS_MAX,
+    SIZE=REMOTE_FIRST+REMOTE_USERS*MAX_USER_CHANNELS
+  };
+  static int Local(int ch) { return ch >= 0 && ch < MAX_LOCAL_CHANNELS ? LOCAL_FIRST+ch : -1; }
+  static int Remote(int slot, int ch)
+  {
+    if (slot < 0 || slot >= REMOTE_USERS || ch < 0 || ch >= MAX_USER_CHANNELS) return -1;
+    return REMOTE_FIRST+slot*MAX_USER_CHANNELS+ch;
+  }
+
+  NJMeter meters[SIZE];
+
+  // Bumped by the audio thread whenever any meter is visibly moving (above the floor,
+  // or a clip flag changes), so a UI can tell at a glance whether it needs to redraw.
+  alignas(64) std::atomic<unsigned int> motion;
+  static constexpr float MOTION_FLOOR=0.001f; // -60dB
+
+  NJMeterBank() : motion(0) { }
+
+  const NJMeter *Get(int idx) const { return idx >= 0 && idx < SIZE ? meters+idx : NULL; }
+};
+
+
+#define DEFAULT_CONFIG_PREBUFFER  8192
+#define LIVE_PREBUFFER 128
+#define ADAPTIVE_PREBUFFER_SAMPLES 2 // intervals from a peer before its own prebuffer is used
+#define ADAPTIVE_PREBUFFER_MAX (DEFAULT_CONFIG_PREBUFFER*8)
+#define ADAPTIVE_PREBUFFER_MARGIN 1.5
+
+// A peer's interval data rate and worst stall, learned from completed downloads. Playback
+// of an interval can start once it has enough data buffered to ride out that stall at
+// that rate. Kept per RemoteUser, under NJClient::m_users_cs.
+struct NJArrivalEstimator
+{
+  double rate;  // bytes/sec, smoothed
+  double stall; // longest gap between data messages, seconds, fast attack/slow release
+  int samples;
+
+  NJArrivalEstimator() : rate(0.0), stall(0.0), samples(0) { }
+
+  // a completed download: bytes received between t_first and t_last, max_gap the longest wait
+  // between data messages. returns false if there was nothing to learn from
+  bool Add(WDL_INT64 bytes, double t_first, double t_last, double max_gap)
+  {
+    if (t_first <= 0.0 || t_last <= t_first) return false;
+    const double r=bytes / (t_last - t_first);
+    rate = samples ? rate*0.8 + r*0.2 : r;
+    // one bad stall should raise the prebuffer right away, recovering takes several intervals
+    if (max_gap > stall) stall=max_gap;
+    else stall = stall*0.9 + max_gap*0.1;
+    samples++;
+    return true;
+  }
+
+  bool Learned() const { return samples >= ADAPTIVE_PREBUFFER_SAMPLES; }
+
+  // bytes to buffer before playing an interval. live channels (chanflags&2) start as soon as
+  // possible; def is the configured prebuffer, used as-is until enough has been learned
+  int Prebuffer(int chanflags, int def, bool adaptive) const
+  {
+    if (chanflags&2) return LIVE_PREBUFFER;
+    if (def <= 0 || !adaptive || !Learned()) return def;
+
+    const double sz=rate * stall * ADAPTIVE_PREBUFFER_MARGIN;
+    return (int) wdl_clamp(sz, (double)LIVE_PREBUFFER, (double)ADAPTIVE_PREBUFFER_MAX);
+  }
+};
+
+
 #endif//_NJCLIENT_H_
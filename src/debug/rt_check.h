@@ -0,0 +1,87 @@
+/*
+    JamWide Plugin - rt_check.h
+    Realtime section markers for the rt checker
+
+    With the JAMWIDE_RT_SANITIZER CMake option, JAMWIDE_RT_SCOPE() marks the
+    enclosing block as realtime for libjamwide-rtcheck, which reports any
+    allocation, lock, file or socket call made inside it. Load the checker
+    into the host with LD_PRELOAD (Linux). Without the option, or without
+    the checker loaded, the markers cost nothing.
+
+    JAMWIDE_RT_ALLOW_LOCK(m) tells the checker that the audio thread takes
+    mutex m by design (JAMWIDE_RT_FORBID_LOCK(m) before it is destroyed).
+    JAMWIDE_RT_EXEMPT() hides the enclosing block from the checker. Both are
+    for known cases only; each use says why.
+*/
+
+#ifndef JAMWIDE_RT_CHECK_H
+#define JAMWIDE_RT_CHECK_H
+
+#if defined(JAMWIDE_RT_SANITIZER) && !defined(_WIN32)
+
+#include <dlfcn.h>
+
+namespace jamwide {
+namespace rtcheck {
+
+using HookFn = void (*)();
+using LockHookFn = void (*)(const void*);
+
+// Resolved once by init(); null when the checker isn't loaded
+inline HookFn g_enter = nullptr;
+inline HookFn g_leave = nullptr;
+inline HookFn g_exempt_enter = nullptr;
+inline HookFn g_exempt_leave = nullptr;
+inline LockHookFn g_allow_lock = nullptr;
+inline LockHookFn g_forbid_lock = nullptr;
+
+// Call from a non-realtime thread before audio starts (plugin init), and
+// before creating anything that uses JAMWIDE_RT_ALLOW_LOCK()
+inline void init() {
+    g_enter = reinterpret_cast<HookFn>(dlsym(RTLD_DEFAULT, "jamwide_rtcheck_enter"));
+    g_leave = reinterpret_cast<HookFn>(dlsym(RTLD_DEFAULT, "jamwide_rtcheck_leave"));
+    g_exempt_enter = reinterpret_cast<HookFn>(dlsym(RTLD_DEFAULT, "jamwide_rtcheck_exempt_enter"));
+    g_exempt_leave = reinterpret_cast<HookFn>(dlsym(RTLD_DEFAULT, "jamwide_rtcheck_exempt_leave"));
+    g_allow_lock = reinterpret_cast<LockHookFn>(dlsym(RTLD_DEFAULT, "jamwide_rtcheck_allow_lock"));
+    g_forbid_lock = reinterpret_cast<LockHookFn>(dlsym(RTLD_DEFAULT, "jamwide_rtcheck_forbid_lock"));
+}
+
+struct Scope {
+    Scope() { if (g_enter) g_enter(); }
+    ~Scope() { if (g_leave) g_leave(); }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+};
+
+struct Exempt {
+    Exempt() { if (g_exempt_enter) g_exempt_enter(); }
+    ~Exempt() { if (g_exempt_leave) g_exempt_leave(); }
+    Exempt(const Exempt&) = delete;
+    Exempt& operator=(const Exempt&) = delete;
+};
+
+// m is what gets passed to pthread_mutex_lock(); for a WDL_Mutex on Linux
+// that is the WDL_Mutex itself (its only member)
+inline void allow_lock(const void* m) { if (g_allow_lock) g_allow_lock(m); }
+inline void forbid_lock(const void* m) { if (g_forbid_lock) g_forbid_lock(m); }
+
+} // namespace rtcheck
+} // namespace jamwide
+
+#define JAMWIDE_RT_INIT() jamwide::rtcheck::init()
+#define JAMWIDE_RT_SCOPE() jamwide::rtcheck::Scope jamwide_rt_scope_
+#define JAMWIDE_RT_EXEMPT() jamwide::rtcheck::Exempt jamwide_rt_exempt_
+#define JAMWIDE_RT_ALLOW_LOCK(m) jamwide::rtcheck::allow_lock(m)
+#define JAMWIDE_RT_FORBID_LOCK(m) jamwide::rtcheck::forbid_lock(m)
+
+#else
+
+#define JAMWIDE_RT_INIT() ((void)0)
+#define JAMWIDE_RT_SCOPE() ((void)0)
+#define JAMWIDE_RT_EXEMPT() ((void)0)
+#define JAMWIDE_RT_ALLOW_LOCK(m) ((void)0)
+#define JAMWIDE_RT_FORBID_LOCK(m) ((void)0)
+
+#endif
+
+#endif // JAMWIDE_RT_CHECK_H
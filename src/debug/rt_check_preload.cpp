@@ -0,0 +1,553 @@
+/*
+    JamWide Plugin - rt_check_preload.cpp
+    Realtime-safety checker, preloaded into the host process
+
+    Built as libjamwide-rtcheck when JAMWIDE_RT_SANITIZER is on (Linux/glibc).
+    Run the host or a test harness with
+        LD_PRELOAD=/path/to/libjamwide-rtcheck.so
+    While a thread is inside a JAMWIDE_RT_SCOPE() (plugin_process and
+    NJClient::AudioProc), every call below is a realtime violation: it is
+    counted, and the first time a given call stack shows up it is printed
+    to stderr. At exit the process fails with JAMWIDE_RTCHECK_EXITCODE
+    (default 1) if anything was caught.
+
+    Locking a mutex registered with JAMWIDE_RT_ALLOW_LOCK() is not reported,
+    nor is anything inside a JAMWIDE_RT_EXEMPT() block. Non-blocking
+    pthread_mutex_trylock() is never reported.
+
+    Environment:
+        JAMWIDE_RTCHECK_HALT=1        abort() on the first violation
+        JAMWIDE_RTCHECK_SKIP=a,b      ignore categories: alloc, lock, file,
+                                      socket, sleep
+        JAMWIDE_RTCHECK_EXITCODE=n    exit status when violations were seen
+
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+// glibc's own allocator entry points, so the wrappers never need dlsym
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace {
+
+enum Category {
+    kAlloc = 1 << 0,
+    kLock = 1 << 1,
+    kFile = 1 << 2,
+    kSocket = 1 << 3,
+    kSleep = 1 << 4,
+};
+
+// Initial-exec so reading these never allocates (the checker is loaded at startup)
+__attribute__((tls_model("initial-exec"))) thread_local int t_depth = 0;
+__attribute__((tls_model("initial-exec"))) thread_local bool t_reporting = false;
+__attribute__((tls_model("initial-exec"))) thread_local int t_exempt = 0;
+
+int g_skip = 0;
+bool g_halt = false;
+int g_exit_code = 1;
+std::atomic<unsigned int> g_violations{0};
+std::atomic<unsigned int> g_unique{0};
+
+// Stack signatures already printed; open addressing, 0 = empty
+constexpr int kSeenSlots = 1024;
+std::atomic<uint64_t> g_seen[kSeenSlots];
+
+bool first_time(uint64_t sig) {
+    if (sig == 0) {
+        sig = 1;
+    }
+    for (int i = 0; i < kSeenSlots; ++i) {
+        auto& slot = g_seen[(sig + i) & (kSeenSlots - 1)];
+        uint64_t cur = slot.load(std::memory_order_relaxed);
+        if (cur == sig) {
+            return false;
+        }
+        if (cur == 0 && slot.compare_exchange_strong(cur, sig)) {
+            return true;
+        }
+        if (cur == sig) {
+            return false;
+        }
+    }
+    return false;  // Table full: still counted, just not printed
+}
+
+void write_str(const char* s) {
+    // Plain write(2) resolves to our wrapper, which lets it through while
+    // t_reporting is set
+    size_t len = std::strlen(s);
+    while (len > 0) {
+        const ssize_t n = ::write(2, s, len);
+        if (n <= 0) {
+            return;
+        }
+        s += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+// Mutexes the realtime code may lock; 0 = empty
+constexpr int kAllowSlots = 256;
+std::atomic<uintptr_t> g_allowed[kAllowSlots];
+
+void allow_lock(uintptr_t m) {
+    for (auto& slot : g_allowed) {
+        uintptr_t cur = 0;
+        if (slot.compare_exchange_strong(cur, m)) {
+            return;
+        }
+    }
+    write_str("jamwide-rtcheck: too many allowed locks, reporting the rest\n");
+}
+
+void forbid_lock(uintptr_t m) {
+    for (auto& slot : g_allowed) {
+        uintptr_t cur = m;
+        if (slot.compare_exchange_strong(cur, 0)) {
+            return;
+        }
+    }
+}
+
+bool lock_allowed(uintptr_t m) {
+    for (const auto& slot : g_allowed) {
+        if (slot.load(std::memory_order_relaxed) == m) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void violation(Category cat, const char* what) {
+    if (t_depth <= 0 || t_exempt > 0 || t_reporting || (g_skip & cat)) {
+        return;
+    }
+    t_reporting = true;
+
+    g_violations.fetch_add(1, std::memory_order_relaxed);
+
+    void* frames[32];
+    const int n = backtrace(frames, 32);
+    uint64_t sig = 1469598103934665603ull;  // FNV-1a over the return addresses
+    for (int i = 1; i < n; ++i) {
+        sig = (sig ^ reinterpret_cast<uintptr_t>(frames[i])) * 1099511628211ull;
+    }
+    if (first_time(sig)) {
+        g_unique.fetch_add(1, std::memory_order_relaxed);
+        char line[160];
+        std::snprintf(line, sizeof(line),
+                      "jamwide-rtcheck: %s called from a realtime section\n", what);
+        write_str(line);
+        backtrace_symbols_fd(frames + 1, n > 1 ? n - 1 : 0, 2);
+        write_str("\n");
+    }
+
+    if (g_halt) {
+        write_str("jamwide-rtcheck: JAMWIDE_RTCHECK_HALT set, aborting\n");
+        std::abort();
+    }
+    t_reporting = false;
+}
+
+template <typename Fn>
+Fn next(const char* name) {
+    return reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+}
+
+// Resolved in the constructor, before any realtime section can run
+int (*real_pthread_mutex_lock)(pthread_mutex_t*);
+int (*real_pthread_rwlock_rdlock)(pthread_rwlock_t*);
+int (*real_pthread_rwlock_wrlock)(pthread_rwlock_t*);
+int (*real_open)(const char*, int, ...);
+int (*real_open64)(const char*, int, ...);
+int (*real_openat)(int, const char*, int, ...);
+FILE* (*real_fopen)(const char*, const char*);
+FILE* (*real_fopen64)(const char*, const char*);
+int (*real_fclose)(FILE*);
+size_t (*real_fread)(void*, size_t, size_t, FILE*);
+size_t (*real_fwrite)(const void*, size_t, size_t, FILE*);
+int (*real_fflush)(FILE*);
+ssize_t (*real_read)(int, void*, size_t);
+ssize_t (*real_write)(int, const void*, size_t);
+int (*real_close)(int);
+int (*real_socket)(int, int, int);
+int (*real_connect)(int, const sockaddr*, socklen_t);
+int (*real_accept)(int, sockaddr*, socklen_t*);
+ssize_t (*real_send)(int, const void*, size_t, int);
+ssize_t (*real_sendto)(int, const void*, size_t, int, const sockaddr*, socklen_t);
+ssize_t (*real_recv)(int, void*, size_t, int);
+ssize_t (*real_recvfrom)(int, void*, size_t, int, sockaddr*, socklen_t*);
+ssize_t (*real_sendmsg)(int, const msghdr*, int);
+ssize_t (*real_recvmsg)(int, msghdr*, int);
+ssize_t (*real_writev)(int, const iovec*, int);
+ssize_t (*real_readv)(int, const iovec*, int);
+int (*real_select)(int, fd_set*, fd_set*, fd_set*, timeval*);
+int (*real_poll)(pollfd*, nfds_t, int);
+int (*real_getaddrinfo)(const char*, const char*, const addrinfo*, addrinfo**);
+int (*real_usleep)(useconds_t);
+int (*real_nanosleep)(const timespec*, timespec*);
+unsigned int (*real_sleep)(unsigned int);
+
+__attribute__((constructor)) void rtcheck_init() {
+    real_pthread_mutex_lock = next<decltype(real_pthread_mutex_lock)>("pthread_mutex_lock");
+    real_pthread_rwlock_rdlock = next<decltype(real_pthread_rwlock_rdlock)>("pthread_rwlock_rdlock");
+    real_pthread_rwlock_wrlock = next<decltype(real_pthread_rwlock_wrlock)>("pthread_rwlock_wrlock");
+    real_open = next<decltype(real_open)>("open");
+    real_open64 = next<decltype(real_open64)>("open64");
+    real_openat = next<decltype(real_openat)>("openat");
+    real_fopen = next<decltype(real_fopen)>("fopen");
+    real_fopen64 = next<decltype(real_fopen64)>("fopen64");
+    real_fclose = next<decltype(real_fclose)>("fclose");
+    real_fread = next<decltype(real_fread)>("fread");
+    real_fwrite = next<decltype(real_fwrite)>("fwrite");
+    real_fflush = next<decltype(real_fflush)>("fflush");
+    real_read = next<decltype(real_read)>("read");
+    real_write = next<decltype(real_write)>("write");
+    real_close = next<decltype(real_close)>("close");
+    real_socket = next<decltype(real_socket)>("socket");
+    real_connect = next<decltype(real_connect)>("connect");
+    real_accept = next<decltype(real_accept)>("accept");
+    real_send = next<decltype(real_send)>("send");
+    real_sendto = next<decltype(real_sendto)>("sendto");
+    real_recv = next<decltype(real_recv)>("recv");
+    real_recvfrom = next<decltype(real_recvfrom)>("recvfrom");
+    real_sendmsg = next<decltype(real_sendmsg)>("sendmsg");
+    real_recvmsg = next<decltype(real_recvmsg)>("recvmsg");
+    real_writev = next<decltype(real_writev)>("writev");
+    real_readv = next<decltype(real_readv)>("readv");
+    real_select = next<decltype(real_select)>("select");
+    real_poll = next<decltype(real_poll)>("poll");
+    real_getaddrinfo = next<decltype(real_getaddrinfo)>("getaddrinfo");
+    real_usleep = next<decltype(real_usleep)>("usleep");
+    real_nanosleep = next<decltype(real_nanosleep)>("nanosleep");
+    real_sleep = next<decltype(real_sleep)>("sleep");
+
+    if (const char* halt = std::getenv("JAMWIDE_RTCHECK_HALT")) {
+        g_halt = *halt && std::strcmp(halt, "0") != 0;
+    }
+    if (const char* code = std::getenv("JAMWIDE_RTCHECK_EXITCODE")) {
+        g_exit_code = std::atoi(code);
+    }
+    if (const char* skip = std::getenv("JAMWIDE_RTCHECK_SKIP")) {
+        static const struct { const char* name; int cat; } kNames[] = {
+            { "alloc", kAlloc }, { "lock", kLock }, { "file", kFile },
+            { "socket", kSocket }, { "sleep", kSleep },
+        };
+        for (const auto& n : kNames) {
+            if (std::strstr(skip, n.name)) {
+                g_skip |= n.cat;
+            }
+        }
+    }
+
+    // backtrace() loads libgcc on first use, which allocates; do it now
+    void* frame;
+    backtrace(&frame, 1);
+}
+
+__attribute__((destructor)) void rtcheck_fini() {
+    const unsigned int total = g_violations.load(std::memory_order_relaxed);
+    if (total == 0) {
+        return;
+    }
+    char line[160];
+    std::snprintf(line, sizeof(line),
+                  "jamwide-rtcheck: %u realtime violation(s), %u distinct call stack(s)\n",
+                  total, g_unique.load(std::memory_order_relaxed));
+    write_str(line);
+    if (g_exit_code != 0) {
+        _exit(g_exit_code);
+    }
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+// Hooks for JAMWIDE_RT_SCOPE() (see rt_check.h)
+//------------------------------------------------------------------------------
+
+extern "C" __attribute__((visibility("default"))) void jamwide_rtcheck_enter() {
+    ++t_depth;
+}
+
+extern "C" __attribute__((visibility("default"))) void jamwide_rtcheck_leave() {
+    --t_depth;
+}
+
+extern "C" __attribute__((visibility("default"))) void jamwide_rtcheck_exempt_enter() {
+    ++t_exempt;
+}
+
+extern "C" __attribute__((visibility("default"))) void jamwide_rtcheck_exempt_leave() {
+    --t_exempt;
+}
+
+extern "C" __attribute__((visibility("default"))) void jamwide_rtcheck_allow_lock(const void* m) {
+    allow_lock(reinterpret_cast<uintptr_t>(m));
+}
+
+extern "C" __attribute__((visibility("default"))) void jamwide_rtcheck_forbid_lock(const void* m) {
+    forbid_lock(reinterpret_cast<uintptr_t>(m));
+}
+
+//------------------------------------------------------------------------------
+// Interposed calls
+//------------------------------------------------------------------------------
+
+extern "C" {
+
+void* malloc(size_t size) noexcept {
+    violation(kAlloc, "malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) noexcept {
+    violation(kAlloc, "calloc");
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept {
+    violation(kAlloc, "realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) noexcept {
+    if (ptr) {
+        violation(kAlloc, "free");
+    }
+    __libc_free(ptr);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) noexcept {
+    violation(kAlloc, "posix_memalign");
+    void* p = __libc_memalign(alignment, size);
+    if (!p) {
+        return ENOMEM;
+    }
+    *out = p;
+    return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    violation(kAlloc, "aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* m) noexcept {
+    if (t_depth > 0 && !lock_allowed(reinterpret_cast<uintptr_t>(m))) {
+        violation(kLock, "pthread_mutex_lock");
+    }
+    return real_pthread_mutex_lock(m);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* l) noexcept {
+    violation(kLock, "pthread_rwlock_rdlock");
+    return real_pthread_rwlock_rdlock(l);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* l) noexcept {
+    violation(kLock, "pthread_rwlock_wrlock");
+    return real_pthread_rwlock_wrlock(l);
+}
+
+int open(const char* path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    violation(kFile, "open");
+    return real_open(path, flags, mode);
+}
+
+int open64(const char* path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    violation(kFile, "open64");
+    return real_open64(path, flags, mode);
+}
+
+int openat(int dirfd, const char* path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    violation(kFile, "openat");
+    return real_openat(dirfd, path, flags, mode);
+}
+
+FILE* fopen(const char* path, const char* mode) {
+    violation(kFile, "fopen");
+    return real_fopen(path, mode);
+}
+
+FILE* fopen64(const char* path, const char* mode) {
+    violation(kFile, "fopen64");
+    return real_fopen64(path, mode);
+}
+
+int fclose(FILE* f) {
+    violation(kFile, "fclose");
+    return real_fclose(f);
+}
+
+size_t fread(void* buf, size_t size, size_t n, FILE* f) {
+    violation(kFile, "fread");
+    return real_fread(buf, size, n, f);
+}
+
+size_t fwrite(const void* buf, size_t size, size_t n, FILE* f) {
+    violation(kFile, "fwrite");
+    return real_fwrite(buf, size, n, f);
+}
+
+int fflush(FILE* f) {
+    violation(kFile, "fflush");
+    return real_fflush(f);
+}
+
+ssize_t read(int fd, void* buf, size_t len) {
+    violation(kFile, "read");
+    return real_read(fd, buf, len);
+}
+
+ssize_t write(int fd, const void* buf, size_t len) {
+    violation(kFile, "write");
+    return real_write(fd, buf, len);
+}
+
+int close(int fd) {
+    violation(kFile, "close");
+    return real_close(fd);
+}
+
+int socket(int domain, int type, int protocol) noexcept {
+    violation(kSocket, "socket");
+    return real_socket(domain, type, protocol);
+}
+
+int connect(int fd, const sockaddr* addr, socklen_t len) {
+    violation(kSocket, "connect");
+    return real_connect(fd, addr, len);
+}
+
+int accept(int fd, sockaddr* addr, socklen_t* len) {
+    violation(kSocket, "accept");
+    return real_accept(fd, addr, len);
+}
+
+ssize_t send(int fd, const void* buf, size_t len, int flags) {
+    violation(kSocket, "send");
+    return real_send(fd, buf, len, flags);
+}
+
+ssize_t sendto(int fd, const void* buf, size_t len, int flags,
+               const sockaddr* addr, socklen_t addrlen) {
+    violation(kSocket, "sendto");
+    return real_sendto(fd, buf, len, flags, addr, addrlen);
+}
+
+ssize_t recv(int fd, void* buf, size_t len, int flags) {
+    violation(kSocket, "recv");
+    return real_recv(fd, buf, len, flags);
+}
+
+ssize_t recvfrom(int fd, void* buf, size_t len, int flags,
+                 sockaddr* addr, socklen_t* addrlen) {
+    violation(kSocket, "recvfrom");
+    return real_recvfrom(fd, buf, len, flags, addr, addrlen);
+}
+
+ssize_t sendmsg(int fd, const msghdr* msg, int flags) {
+    violation(kSocket, "sendmsg");
+    return real_sendmsg(fd, msg, flags);
+}
+
+ssize_t recvmsg(int fd, msghdr* msg, int flags) {
+    violation(kSocket, "recvmsg");
+    return real_recvmsg(fd, msg, flags);
+}
+
+ssize_t writev(int fd, const iovec* iov, int iovcnt) {
+    violation(kFile, "writev");
+    return real_writev(fd, iov, iovcnt);
+}
+
+ssize_t readv(int fd, const iovec* iov, int iovcnt) {
+    violation(kFile, "readv");
+    return real_readv(fd, iov, iovcnt);
+}
+
+int select(int nfds, fd_set* r, fd_set* w, fd_set* e, timeval* timeout) {
+    violation(kSocket, "select");
+    return real_select(nfds, r, w, e, timeout);
+}
+
+int poll(pollfd* fds, nfds_t nfds, int timeout) {
+    violation(kSocket, "poll");
+    return real_poll(fds, nfds, timeout);
+}
+
+int getaddrinfo(const char* node, const char* service,
+                const addrinfo* hints, addrinfo** res) {
+    violation(kSocket, "getaddrinfo");
+    return real_getaddrinfo(node, service, hints, res);
+}
+
+int usleep(useconds_t usec) {
+    violation(kSleep, "usleep");
+    return real_usleep(usec);
+}
+
+int nanosleep(const timespec* req, timespec* rem) {
+    violation(kSleep, "nanosleep");
+    return real_nanosleep(req, rem);
+}
+
+unsigned int sleep(unsigned int seconds) {
+    violation(kSleep, "sleep");
+    return real_sleep(seconds);
+}
+
+} // extern "C"
@@ -0,0 +1,211 @@
+/*
+    JamWide Plugin - dns_cache.cpp
+    Process-wide asynchronous DNS cache implementation
+*/
+
+#include "dns_cache.h"
+
+#include <cctype>
+#include <cstring>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#endif
+
+namespace jamwide {
+
+namespace {
+
+std::string make_key(const char* hostname) {
+    std::string key = hostname ? hostname : "";
+    for (auto& c : key) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return key;
+}
+
+} // namespace
+
+DnsCache& DnsCache::instance() {
+    // Leaked on purpose, see the class comment
+    static DnsCache* cache = new DnsCache;
+    return *cache;
+}
+
+DnsCache::DnsCache() = default;
+
+DnsCache::~DnsCache() {
+    stop_worker();
+}
+
+void DnsCache::shutdown() {
+    instance().stop_worker();
+}
+
+void DnsCache::stop_worker() {
+    std::thread worker;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        kill_ = true;
+        worker = std::move(thread_);
+    }
+    cv_.notify_all();
+    // May wait out a lookup in progress
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    kill_ = false;
+    queue_.clear();
+    for (auto& e : entries_) {
+        e.second.pending = false;  // looked up again by the next resolve()
+    }
+}
+
+int DnsCache::resolve(const char* hostname, unsigned int* addr) {
+    if (!hostname || !hostname[0] || !addr) {
+        return -1;
+    }
+    const unsigned int ip = inet_addr(hostname);
+    if (ip != INADDR_NONE) {
+        *addr = ip;
+        return 0;
+    }
+
+    const std::string key = make_key(hostname);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lookup_locked(key, addr);
+}
+
+int DnsCache::reverse(unsigned int addr, char* hostname) {
+    (void)addr;
+    (void)hostname;
+    return -1;  // Nothing here needs reverse lookups
+}
+
+void DnsCache::prefetch(const std::string& host) {
+    if (host.empty() || inet_addr(host.c_str()) != INADDR_NONE) {
+        return;
+    }
+    unsigned int addr = 0;
+    const std::string key = make_key(host.c_str());
+    std::lock_guard<std::mutex> lock(mutex_);
+    lookup_locked(key, &addr);
+}
+
+DnsCache::Stats DnsCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+int DnsCache::lookup_locked(const std::string& key, unsigned int* addr) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        if (entries_.size() >= kMaxEntries) {
+            const auto now = Clock::now();
+            for (auto e = entries_.begin(); e != entries_.end();) {
+                if (!e->second.pending && e->second.expires <= now) {
+                    e = entries_.erase(e);
+                } else {
+                    ++e;
+                }
+            }
+        }
+        ++stats_.misses;
+        Entry& entry = entries_[key];
+        enqueue_locked(key, entry);
+        return 1;
+    }
+
+    Entry& entry = it->second;
+    if (!entry.resolved) {
+        enqueue_locked(key, entry);  // no-op unless a shutdown() dropped it
+        return 1;
+    }
+    if (Clock::now() < entry.expires) {
+        ++stats_.hits;
+        if (!entry.ok) {
+            return -1;
+        }
+        *addr = entry.addr;
+        return 0;
+    }
+
+    // Expired: refresh in the background, and keep connecting to the old
+    // address meanwhile rather than making the caller wait
+    enqueue_locked(key, entry);
+    if (!entry.ok) {
+        return 1;
+    }
+    ++stats_.stale_hits;
+    *addr = entry.addr;
+    return 0;
+}
+
+void DnsCache::enqueue_locked(const std::string& key, Entry& entry) {
+    if (entry.pending) {
+        return;
+    }
+    entry.pending = true;
+    queue_.push_back(key);
+    if (!thread_.joinable() && !kill_) {
+        thread_ = std::thread(&DnsCache::worker, this);
+    }
+    cv_.notify_one();
+}
+
+void DnsCache::worker() {
+    const int nowinsock = JNL::open_socketlib();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!kill_) {
+        if (queue_.empty()) {
+            cv_.wait(lock);
+            continue;
+        }
+        const std::string key = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+
+        const auto start = Clock::now();
+        unsigned int addr = INADDR_NONE;
+        if (!nowinsock) {
+            struct addrinfo hints;
+            std::memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_INET;  // JNetLib connects over IPv4 only
+            hints.ai_socktype = SOCK_STREAM;
+            struct addrinfo* res = nullptr;
+            if (getaddrinfo(key.c_str(), nullptr, &hints, &res) == 0 && res) {
+                const auto* sin = reinterpret_cast<const struct sockaddr_in*>(res->ai_addr);
+                addr = sin->sin_addr.s_addr;
+            }
+            if (res) {
+                freeaddrinfo(res);
+            }
+        }
+        const auto done = Clock::now();
+
+        lock.lock();
+        ++stats_.lookups;
+        stats_.last_lookup_ms =
+            std::chrono::duration<double, std::milli>(done - start).count();
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            Entry& entry = it->second;
+            entry.pending = false;
+            entry.resolved = true;
+            entry.ok = addr != INADDR_NONE;
+            entry.addr = addr;
+            entry.expires = done + std::chrono::seconds(
+                entry.ok ? kTtlSeconds : kNegativeTtlSeconds);
+        }
+    }
+    lock.unlock();
+
+    if (!nowinsock) {
+        JNL::close_socketlib();
+    }
+}
+
+} // namespace jamwide
@@ -0,0 +1,93 @@
+/*
+    JamWide Plugin - dns_cache.h
+    Process-wide asynchronous DNS cache shared by all JNetLib connections
+*/
+
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "wdl/jnetlib/jnetlib.h"
+
+namespace jamwide {
+
+/**
+ * Name cache handed to JNL_Connection/JNL_HTTPGet in place of a private
+ * JNL_AsyncDNS, so the server list, the server browser and NJClient
+ * (including its reconnects) share lookups. Lookups run on one background
+ * thread. getaddrinfo() doesn't report record TTLs, so answers are kept for
+ * a fixed time; an expired address is still returned while it is refreshed.
+ *
+ * The instance is never destroyed: a static destructor would join the
+ * worker at process exit or library unload, which on Windows runs under
+ * the loader lock and can deadlock. The worker starts with the first
+ * lookup and is stopped by shutdown() from the plugin entry's deinit.
+ */
+class DnsCache : public JNL_IAsyncDNS {
+public:
+    static DnsCache& instance();
+    ~DnsCache() override;
+
+    /**
+     * Stop and join the lookup thread, dropping queued lookups. Call when
+     * the plugin library is being deinitialized, with no connections left.
+     * Cached answers are kept; a later lookup starts the thread again.
+     */
+    static void shutdown();
+
+    // JNL_IAsyncDNS: 0 with *addr set, 1 while the lookup runs, -1 if unresolvable
+    int resolve(const char* hostname, unsigned int* addr) override;
+    int reverse(unsigned int addr, char* hostname) override;
+
+    // Start resolving host (without port) if it isn't cached or is stale
+    void prefetch(const std::string& host);
+
+    struct Stats {
+        int hits = 0;
+        int stale_hits = 0;
+        int misses = 0;
+        int lookups = 0;
+        double last_lookup_ms = 0.0;
+    };
+    Stats stats() const;
+
+    static constexpr int kTtlSeconds = 300;
+    static constexpr int kNegativeTtlSeconds = 15;
+    static constexpr size_t kMaxEntries = 256;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        unsigned int addr = 0;
+        bool resolved = false;  // addr/ok hold an answer (possibly expired)
+        bool ok = false;
+        bool pending = false;   // queued or being looked up
+        Clock::time_point expires;
+    };
+
+    DnsCache();
+    int lookup_locked(const std::string& key, unsigned int* addr);
+    void enqueue_locked(const std::string& key, Entry& entry);
+    void stop_worker();
+    void worker();
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::deque<std::string> queue_;
+    bool kill_ = false;
+    Stats stats_;
+    std::thread thread_;
+};
+
+} // namespace jamwide
+
+#endif // DNS_CACHE_H
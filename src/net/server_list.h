@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "wdl/jnetlib/httpget.h"
+#include "net/dns_cache.h"
 #include "ui/server_list_types.h"
 
 namespace jamwide {
@@ -32,7 +33,7 @@ private:
     bool parse_ninjam_format(const std::string& data, ServerListResult& result);
     bool parse_json_format(const std::string& data, ServerListResult& result);
 
-    JNL_HTTPGet http_;
+    JNL_HTTPGet http_{&DnsCache::instance()};
     bool active_ = false;
     std::string buffer_;
     std::string url_;
@@ -0,0 +1,188 @@
+/*
+    JamWide Plugin - server_probe.cpp
+    Latency probing of public servers implementation
+*/
+
+#include "server_probe.h"
+#include "net/dns_cache.h"
+#include "core/mpb.h"
+
+#include <utility>
+
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#endif
+
+namespace jamwide {
+
+namespace {
+
+constexpr int kDefaultPort = 2049;  // as NJClient::Connect() assumes
+
+int elapsed_ms(std::chrono::steady_clock::time_point from,
+               std::chrono::steady_clock::time_point to) {
+    return static_cast<int>(
+        std::chrono::duration<double, std::milli>(to - from).count() + 0.5);
+}
+
+// The kernel has timed the SYN/SYN-ACK exchange exactly, independent of how
+// often poll() gets called. -1 where that isn't available.
+int kernel_rtt_ms(SOCKET sock) {
+    if (sock == INVALID_SOCKET) {
+        return -1;
+    }
+#if defined(__linux__)
+    struct tcp_info ti;
+    socklen_t len = sizeof(ti);
+    if (getsockopt(sock, IPPROTO_TCP, TCP_INFO, &ti, &len) == 0 && ti.tcpi_rtt > 0) {
+        return static_cast<int>((ti.tcpi_rtt + 500) / 1000);
+    }
+#elif defined(__APPLE__) && defined(TCP_CONNECTION_INFO)
+    struct tcp_connection_info ti;
+    socklen_t len = sizeof(ti);
+    if (getsockopt(sock, IPPROTO_TCP, TCP_CONNECTION_INFO, &ti, &len) == 0 && ti.tcpi_srtt > 0) {
+        return static_cast<int>(ti.tcpi_srtt);
+    }
+#else
+    (void)sock;
+#endif
+    return -1;
+}
+
+} // namespace
+
+ServerProber::ServerProber() = default;
+ServerProber::~ServerProber() = default;
+
+void ServerProber::start(const std::vector<ServerListEntry>& servers) {
+    cancel();
+    for (const auto& entry : servers) {
+        if (entry.host.empty()) {
+            continue;
+        }
+        ServerProbeResult target;
+        target.host = entry.host;
+        target.port = entry.port > 0 ? entry.port : kDefaultPort;
+        pending_.push_back(std::move(target));
+    }
+}
+
+void ServerProber::cancel() {
+    pending_.clear();
+    for (auto& probe : active_) {
+        probe.con->close(1);
+    }
+    active_.clear();
+}
+
+bool ServerProber::in_flight() const {
+    return !suspended_ && (!pending_.empty() || !active_.empty());
+}
+
+void ServerProber::set_suspended(bool suspended) {
+    if (suspended == suspended_) {
+        return;
+    }
+    suspended_ = suspended;
+    if (!suspended) {
+        return;
+    }
+    // Timings taken so far would be skewed by the gap, so requeue from scratch
+    for (auto it = active_.rbegin(); it != active_.rend(); ++it) {
+        it->con->close(1);
+        ServerProbeResult target;
+        target.host = std::move(it->result.host);
+        target.port = it->result.port;
+        pending_.push_front(std::move(target));
+    }
+    active_.clear();
+}
+
+void ServerProber::launch(ServerProbeResult target) {
+    Probe probe;
+    probe.con = std::make_unique<JNL_Connection>(&DnsCache::instance(), 256, 4096);
+    probe.started = Clock::now();
+    probe.con->connect(target.host.c_str(), target.port);
+    probe.last_state = probe.con->get_state();
+    probe.result = std::move(target);
+    active_.push_back(std::move(probe));
+}
+
+bool ServerProber::poll(std::vector<ServerProbeResult>& results) {
+    if (suspended_) {
+        return false;
+    }
+    const size_t before = results.size();
+
+    for (size_t i = 0; i < active_.size();) {
+        if (step(active_[i], Clock::now())) {
+            active_[i].con->close(1);
+            results.push_back(std::move(active_[i].result));
+            active_.erase(active_.begin() + static_cast<std::ptrdiff_t>(i));
+        } else {
+            ++i;
+        }
+    }
+
+    while (static_cast<int>(active_.size()) < kMaxConcurrent && !pending_.empty()) {
+        launch(std::move(pending_.front()));
+        pending_.pop_front();
+    }
+
+    return results.size() > before;
+}
+
+bool ServerProber::step(Probe& probe, Clock::time_point now) {
+    // The connect attempt starts inside run() once the name is resolved, so
+    // time it from just before the run() that leaves STATE_RESOLVING
+    probe.con->run();
+    const Clock::time_point after = Clock::now();
+    const int state = probe.con->get_state();
+
+    if (!probe.have_connect_start && state != JNL_Connection::STATE_RESOLVING &&
+        state != JNL_Connection::STATE_NOCONNECTION) {
+        probe.connect_start = probe.last_state == JNL_Connection::STATE_RESOLVING ? now : after;
+        probe.have_connect_start = true;
+    }
+    probe.last_state = state;
+
+    switch (state) {
+        case JNL_Connection::STATE_CONNECTED:
+            if (!probe.have_connected) {
+                probe.connected = after;
+                probe.have_connected = true;
+                probe.result.rtt_ms = kernel_rtt_ms(probe.con->get_socket());
+                if (probe.result.rtt_ms < 0) {
+                    probe.result.rtt_ms = elapsed_ms(probe.connect_start, after);
+                }
+            }
+            if (probe.con->recv_bytes_available() > 0) {
+                unsigned char type = 0xff;
+                probe.con->peek_bytes(&type, 1);
+                if (type == MESSAGE_SERVER_AUTH_CHALLENGE) {
+                    probe.result.handshake_ms = elapsed_ms(probe.connect_start, after);
+                } else {
+                    probe.result.error = "Not a NINJAM server";
+                }
+                return true;
+            }
+            break;
+        case JNL_Connection::STATE_ERROR:
+        case JNL_Connection::STATE_CLOSING:
+        case JNL_Connection::STATE_CLOSED: {
+            const char* err = probe.con->get_errstr();
+            probe.result.error = (err && err[0]) ? err : "Connection closed";
+            return true;
+        }
+        default:
+            break;
+    }
+
+    if (elapsed_ms(probe.started, after) >= kTimeoutMs) {
+        probe.result.error = "Timed out";
+        return true;
+    }
+    return false;
+}
+
+} // namespace jamwide
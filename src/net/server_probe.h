@@ -0,0 +1,84 @@
+/*
+    JamWide Plugin - server_probe.h
+    Latency probing of public servers from the Run thread
+*/
+
+#ifndef SERVER_PROBE_H
+#define SERVER_PROBE_H
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "wdl/jnetlib/jnetlib.h"
+#include "ui/server_list_types.h"
+
+namespace jamwide {
+
+struct ServerProbeResult {
+    std::string host;
+    int port = 0;
+    int rtt_ms = -1;        // TCP round trip (kernel estimate where available)
+    int handshake_ms = -1;  // connect start to the server's auth challenge
+    std::string error;      // empty on success
+};
+
+/**
+ * Opens a non-blocking connection to each server, times the TCP connect and
+ * the arrival of the server's auth challenge, then closes it again without
+ * logging in. At most kMaxConcurrent probes are open at once; the rest wait
+ * their turn. poll() must be called regularly (every few ms while
+ * in_flight() for usable timings).
+ *
+ * While suspended (a session is up), nothing is probed and in_flight() is
+ * false, so the Run loop isn't held at kPollIntervalMs and the session's
+ * traffic doesn't share the link with probes. Open probes are put back on
+ * the queue and start over on resume.
+ */
+class ServerProber {
+public:
+    static constexpr int kMaxConcurrent = 4;
+    static constexpr int kTimeoutMs = 3000;
+    static constexpr int kPollIntervalMs = 5;
+
+    ServerProber();
+    ~ServerProber();
+
+    // Replaces any probes still queued or running
+    void start(const std::vector<ServerListEntry>& servers);
+    void cancel();
+    bool in_flight() const;
+
+    void set_suspended(bool suspended);
+    bool suspended() const { return suspended_; }
+
+    // Appends probes finished since the last call; true if any were added
+    bool poll(std::vector<ServerProbeResult>& results);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Probe {
+        ServerProbeResult result;
+        std::unique_ptr<JNL_Connection> con;
+        int last_state = JNL_Connection::STATE_NOCONNECTION;
+        Clock::time_point started;
+        Clock::time_point connect_start;
+        Clock::time_point connected;
+        bool have_connect_start = false;
+        bool have_connected = false;
+    };
+
+    void launch(ServerProbeResult target);
+    bool step(Probe& probe, Clock::time_point now); // true when finished
+
+    std::deque<ServerProbeResult> pending_;
+    std::vector<Probe> active_;
+    bool suspended_ = false;
+};
+
+} // namespace jamwide
+
+#endif // SERVER_PROBE_H
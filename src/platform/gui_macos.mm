@@ -9,6 +9,7 @@
 #include "gui_context.h"
 #include "plugin/jamwide_plugin.h"
 #include "ui/ui_main.h"
+#include "ui/ui_frame_pacer.h"
 
 #import <Cocoa/Cocoa.h>
 #import <Metal/Metal.h>
@@ -29,6 +30,8 @@ using namespace jamwide;
 @interface JamWideView : MTKView {
 @public
     std::shared_ptr<JamWidePlugin> plugin_;
+    UiFramePacer pacer_;     // Picks which display ticks render
+    id inputMonitor_;        // Local NSEvent monitor feeding pacer_
 }
 @property (nonatomic, strong) id<MTLCommandQueue> commandQueue;
 @property (nonatomic, assign) ImGuiContext* imguiContext;
@@ -85,6 +88,29 @@ using namespace jamwide;
 
         ImGui_ImplOSX_Init(self);
         ImGui_ImplMetal_Init(device);
+
+        // The view keeps ticking at 60 Hz; any input aimed at our window
+        // lets the pacer render the next tick instead of waiting for idle.
+        // Unretained: the monitor is removed in dealloc.
+        __unsafe_unretained JamWideView* view = self;
+        const NSEventMask mask =
+            NSEventMaskLeftMouseDown | NSEventMaskLeftMouseUp |
+            NSEventMaskRightMouseDown | NSEventMaskRightMouseUp |
+            NSEventMaskOtherMouseDown | NSEventMaskOtherMouseUp |
+            NSEventMaskMouseMoved | NSEventMaskLeftMouseDragged |
+            NSEventMaskRightMouseDragged | NSEventMaskOtherMouseDragged |
+            NSEventMaskScrollWheel | NSEventMaskKeyDown | NSEventMaskKeyUp |
+            NSEventMaskFlagsChanged;
+        inputMonitor_ = [NSEvent addLocalMonitorForEventsMatchingMask:mask
+                                                              handler:^NSEvent*(NSEvent* event) {
+            if (event.window && event.window == view.window) {
+                view->pacer_.note_input();
+            }
+            return event;
+        }];
+#if !__has_feature(objc_arc)
+        [inputMonitor_ retain];
+#endif
     }
 
     return self;
@@ -95,6 +121,13 @@ using namespace jamwide;
 }
 
 - (void)dealloc {
+    if (inputMonitor_) {
+        [NSEvent removeMonitor:inputMonitor_];
+#if !__has_feature(objc_arc)
+        [inputMonitor_ release];
+#endif
+        inputMonitor_ = nil;
+    }
     if (_imguiContext) {
         ImGui::SetCurrentContext(_imguiContext);
         ImGui_ImplMetal_Shutdown();
@@ -109,6 +142,7 @@ using namespace jamwide;
 
 - (void)setFrameSize:(NSSize)newSize {
     [super setFrameSize:newSize];
+    pacer_.note_input();
     
     // Update ImGui display size when view is resized
     if (_imguiContext) {
@@ -159,6 +193,13 @@ using namespace jamwide;
             return;
         }
 
+        // Skip the tick before touching the drawable, so an idle editor
+        // costs neither a frame build nor a present.
+        if (!pacer_.should_render(plugin_.get())) {
+            return;
+        }
+        pacer_.begin_frame();
+
         id<MTLCommandBuffer> commandBuffer = [_commandQueue commandBuffer];
         if (!commandBuffer) return;
         
@@ -189,6 +230,8 @@ using namespace jamwide;
         [encoder endEncoding];
         [commandBuffer presentDrawable:self.currentDrawable];
         [commandBuffer commit];
+
+        pacer_.end_frame(plugin_.get());
     }
 }
 
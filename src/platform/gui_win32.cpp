@@ -11,6 +11,7 @@
 #include "gui_context.h"
 #include "plugin/jamwide_plugin.h"
 #include "ui/ui_main.h"
+#include "ui/ui_frame_pacer.h"
 
 #include <d3d11.h>
 #include <dxgi.h>
@@ -102,6 +103,7 @@ public:
 
         // Forward keyboard, IME, and focus messages to ImGui
         if (is_key_msg || is_ime_msg || is_focus_msg) {
+            ctx->pacer_.note_input();
             
             // Handle Tab to keep focus in EDIT when text input is active
             if (msg == WM_KEYDOWN && wParam == VK_TAB) {
@@ -207,7 +209,7 @@ public:
         // Install message hook on GUI thread
         install_message_hook();
 
-        // Start render timer (60 FPS)
+        // Start render timer (60 FPS ticks; pacer_ skips them while idle)
         timer_id_ = SetTimer(hwnd_, 1, 16, nullptr);
 
         return true;
@@ -279,6 +281,11 @@ public:
             return;
         }
 
+        if (!pacer_.should_render(plugin.get())) {
+            return;
+        }
+        pacer_.begin_frame();
+
         // Start ImGui frame
         ImGui_ImplDX11_NewFrame();
         ImGui_ImplWin32_NewFrame();
@@ -323,6 +330,8 @@ public:
 
         // Present
         swap_chain_->Present(1, 0);
+
+        pacer_.end_frame(plugin.get());
     }
 
 private:
@@ -339,6 +348,15 @@ private:
     bool wants_text_input_;      // Tracks io.WantTextInput for focus transitions
     HHOOK message_hook_;         // GUI thread message hook
     DWORD message_hook_thread_;  // Thread id for hook installation
+    UiFramePacer pacer_;         // Picks which timer ticks render
+
+    static bool is_input_message(UINT msg) {
+        return (msg >= WM_MOUSEFIRST && msg <= WM_MOUSELAST) ||
+               (msg >= WM_KEYFIRST && msg <= WM_KEYLAST) ||
+               (msg >= WM_IME_STARTCOMPOSITION && msg <= WM_IME_KEYLAST) ||
+               msg == WM_IME_CHAR || msg == WM_MOUSELEAVE ||
+               msg == WM_SETFOCUS || msg == WM_KILLFOCUS || msg == WM_SIZE;
+    }
 
     void install_message_hook() {
         if (message_hook_ || !hwnd_) {
@@ -492,6 +510,10 @@ private:
             ImGui::SetCurrentContext(ctx->imgui_ctx_);
         }
 
+        if (ctx && is_input_message(msg)) {
+            ctx->pacer_.note_input();
+        }
+
         // Forward to ImGui
         if (ImGui_ImplWin32_WndProcHandler(hwnd, msg, wParam, lParam))
             return TRUE;
@@ -3,6 +3,7 @@
 
 #include <clap/clap.h>
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstring>
 #include <cstdlib>
@@ -12,6 +13,8 @@
 #include "jamwide_plugin.h"
 #include "core/njclient.h"
 #include "debug/logging.h"
+#include "debug/rt_check.h"
+#include "net/dns_cache.h"
 #include "threading/run_thread.h"
 #include "third_party/picojson.h"
 
@@ -134,6 +137,11 @@ static void process_param_events(JamWidePlugin* plugin,
 static bool plugin_init(const clap_plugin_t* clap_plugin) {
     auto* plugin = get_plugin(clap_plugin);
     if (!plugin) return false;
+    const auto start = std::chrono::steady_clock::now();
+
+    // Only cheap defaults here. The Run thread starts with the first UI
+    // command and NJClient with the first connect (see run_thread_post);
+    // ImGui and its fonts come with the editor in gui_create.
 
     // Initialize UI state defaults
     snprintf(plugin->ui_state.server_input,
@@ -150,7 +158,11 @@ static bool plugin_init(const clap_plugin_t* clap_plugin) {
 #else
     plugin->serialize_audio_proc = false;
 #endif
+    JAMWIDE_RT_INIT();
 
+    NLOG("[Init] plugin_init in %.3f ms\n",
+         std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start).count());
     return true;
 }
 
@@ -169,7 +181,7 @@ static void plugin_destroy(const clap_plugin_t* clap_plugin) {
     }
 
     // Ensure teardown even if host skips deactivate()
-    if (plugin->client) {
+    if (plugin->client || plugin->run_thread.joinable()) {
         plugin_deactivate(clap_plugin);
     }
 
@@ -197,16 +209,16 @@ static bool plugin_activate(const clap_plugin_t* clap_plugin,
     plugin->sample_rate = sample_rate;
     plugin->max_frames = max_frames;
 
-    // Create NJClient instance
-    {
-        std::lock_guard<std::mutex> client_lock(plugin->client_mutex);
-        plugin->client = std::make_unique<NJClient>();
+    // Usually no client or Run thread yet: hosts activate every instance
+    // while loading a project, and most never connect. Until the first
+    // connect, process() passes audio through. A client built earlier (a
+    // connect from an editor opened before activate) is resized for these
+    // settings; nothing processes until we return.
+    if (plugin->client_ready.load(std::memory_order_acquire)) {
+        plugin->client->PrepareAudio(static_cast<int>(max_frames),
+                                     static_cast<int>(sample_rate));
     }
-
-    // Start Run thread (which sets up callbacks)
-    auto plugin_shared = get_plugin_shared(clap_plugin);
-    if (!plugin_shared) return false;
-    run_thread_start(plugin, std::move(plugin_shared));
+    NLOG("[Init] activate: %.0f Hz, up to %u frames\n", sample_rate, max_frames);
 
     return true;
 }
@@ -218,10 +230,11 @@ static void plugin_deactivate(const clap_plugin_t* clap_plugin) {
     // Stop Run thread
     run_thread_stop(plugin);
 
-    // Disconnect and destroy NJClient
+    // Disconnect and destroy NJClient; the next connect builds a new one
     {
         std::lock_guard<std::mutex> client_lock(plugin->client_mutex);
         if (plugin->client) {
+            plugin->client_ready.store(false, std::memory_order_release);
             plugin->client->Disconnect();
             plugin->client.reset();
         }
@@ -255,6 +268,7 @@ static void plugin_on_main_thread(const clap_plugin_t* clap_plugin) {
 
 static clap_process_status plugin_process(const clap_plugin_t* clap_plugin,
                                           const clap_process_t* process) {
+    JAMWIDE_RT_SCOPE();
     auto* plugin = get_plugin(clap_plugin);
     if (!plugin) return CLAP_PROCESS_ERROR;
 
@@ -293,10 +307,12 @@ static clap_process_status plugin_process(const clap_plugin_t* clap_plugin,
 
     // Sync CLAP params to NJClient atomics
     std::unique_lock<std::mutex> client_lock;
-    NJClient* client = plugin->client.get();
+    NJClient* client = plugin->client_ready.load(std::memory_order_acquire)
+                           ? plugin->client.get() : nullptr;
     if (plugin->serialize_audio_proc) {
         client_lock = std::unique_lock<std::mutex>(plugin->client_mutex);
-        client = plugin->client.get();
+        client = plugin->client_ready.load(std::memory_order_acquire)
+                     ? plugin->client.get() : nullptr;
     }
 
     if (client) {
@@ -395,6 +411,8 @@ static clap_process_status plugin_process(const clap_plugin_t* clap_plugin,
                                 offset, std::memory_order_relaxed);
                             plugin->ui_snapshot.transient_detected.store(
                                 true, std::memory_order_release);
+                            plugin->ui_snapshot.changes.fetch_add(
+                                1, std::memory_order_relaxed);
 
                             plugin->transient.gate_open = false;
                             plugin->transient.samples_since_trigger = 0;
@@ -425,16 +443,6 @@ static clap_process_status plugin_process(const clap_plugin_t* clap_plugin,
                 just_monitor, is_playing, is_seek, cursor_pos
             );
 
-            // Update VU snapshot for UI
-            plugin->ui_snapshot.master_vu_left.store(
-                client->GetOutputPeak(0), std::memory_order_relaxed);
-            plugin->ui_snapshot.master_vu_right.store(
-                client->GetOutputPeak(1), std::memory_order_relaxed);
-            plugin->ui_snapshot.local_vu_left.store(
-                client->GetLocalChannelPeak(0, 0), std::memory_order_relaxed);
-            plugin->ui_snapshot.local_vu_right.store(
-                client->GetLocalChannelPeak(0, 1), std::memory_order_relaxed);
-
             return CLAP_PROCESS_CONTINUE;
         }
     }
@@ -1119,6 +1127,9 @@ bool jamwide_entry_init(const char* path) {
 }
 
 void jamwide_entry_deinit(void) {
+    // Join background threads here rather than from static destructors,
+    // which run under the loader lock on Windows
+    jamwide::DnsCache::shutdown();
 }
 
 const void* jamwide_entry_get_factory(const char* factory_id) {
@@ -15,38 +15,60 @@
 #include <thread>
 #include <string>
 #include <memory>
+#include <vector>
+#include <cstdint>
 
 #include "clap/clap.h"
+#include "core/njclient.h"
 #include "threading/spsc_ring.h"
+#include "threading/triple_buffer.h"
+#include "threading/command_coalescer.h"
+#include "threading/run_wakeup.h"
 #include "threading/ui_command.h"
 #include "threading/ui_event.h"
 #include "ui/ui_state.h"
 
-// Forward declarations
-class NJClient;
-
 namespace jamwide {
 
 struct GuiContext;
 
+/**
+ * Remote users and their mixer settings, published by the Run thread
+ * so the UI can draw them without taking client_mutex. Each of the
+ * triple buffer's slots is refreshed in place from what changed since
+ * that slot was last written.
+ */
+struct RemoteMixerSnapshot {
+    uint64_t version = 0;
+    NJClient::RemoteMixerView mixer;
+};
+
 /**
  * Main plugin instance structure.
  * One instance per CLAP plugin instance.
  */
-struct JamWidePlugin {
+struct JamWidePlugin : std::enable_shared_from_this<JamWidePlugin> {
     // CLAP references
     const clap_plugin_t* clap_plugin{nullptr};
     const clap_host_t* host{nullptr};
     
-    // NJClient instance
+    // NJClient instance. Built on the main thread by the first connect (or
+    // prewarm) rather than at activate, so instances that never connect don't
+    // pay for it; destroyed at deactivate.
     std::unique_ptr<NJClient> client;
+    // Set (release) once client is ready; the audio and Run threads check it
+    // (acquire) before reading client.
+    std::atomic<bool> client_ready{false};
     
     // =========== Threading Primitives ===========
     
     // Protects plugin/UI state (not NJClient calls).
     std::mutex state_mutex;
 
-    // Serializes all NJClient API calls except AudioProc.
+    // Guards creating and destroying the NJClient. Every other call is made
+    // from the Run thread (or AudioProc from the audio thread), and NJClient
+    // protects its own state per domain, so nothing else takes this - except
+    // the serialize_audio_proc diagnostic, which holds it around Run() passes.
     std::mutex client_mutex;
     
     // Run thread
@@ -59,6 +81,21 @@ struct JamWidePlugin {
 
     // UI command queue (UI → Run)
     SpscRing<UiCommand, 256> cmd_queue;
+
+    // Pending mixer edits (UI → Run), latest value per target and field
+    CommandCoalescer mixer_edits;
+
+    // Wakes the Run thread when commands or captured audio are waiting
+    RunWakeup run_wakeup;
+
+    // Remote mixer state (Run → UI), edits go back through cmd_queue
+    TripleBuffer<RemoteMixerSnapshot> remote_snapshot;
+
+    // Fetched public server list (Run → UI), announced by ServerListEvent
+    TripleBuffer<std::vector<ServerListEntry>> server_list_buffer;
+
+    // Channel meters (audio → UI), lock-free. Outlives the client.
+    NJMeterBank meters;
     
     // License dialog synchronization
     std::mutex license_mutex;
@@ -72,7 +109,7 @@ struct JamWidePlugin {
     std::atomic<bool> audio_active{false};
     double sample_rate{48000.0};
     uint32_t max_frames{512};
-    bool serialize_audio_proc{false}; // Diagnostic: serialize AudioProc with client_mutex.
+    bool serialize_audio_proc{false}; // Diagnostic: serialize AudioProc with Run() via client_mutex.
 
     struct TransientDetector {
         float env{0.0f};
@@ -0,0 +1,109 @@
+/*
+    JamWide Plugin - command_coalescer.cpp
+    Latest-value-wins mailbox for UI mixer edits
+    
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#include "threading/command_coalescer.h"
+
+#include <type_traits>
+
+namespace jamwide {
+
+namespace {
+
+bool same_target(const SetLocalChannelMonitoringCommand& a,
+                 const SetLocalChannelMonitoringCommand& b) {
+    return a.channel == b.channel;
+}
+
+bool same_target(const SetUserStateCommand& a, const SetUserStateCommand& b) {
+    return a.user_name == b.user_name &&
+           (!a.user_name.empty() || a.user_index == b.user_index);
+}
+
+bool same_target(const SetUserChannelStateCommand& a,
+                 const SetUserChannelStateCommand& b) {
+    return a.channel_index == b.channel_index &&
+           a.user_name == b.user_name &&
+           (!a.user_name.empty() || a.user_index == b.user_index);
+}
+
+template <typename T>
+void take(bool& set, T& value, bool from_set, const T& from_value) {
+    if (from_set) {
+        set = true;
+        value = from_value;
+    }
+}
+
+void merge(SetLocalChannelMonitoringCommand& into,
+           const SetLocalChannelMonitoringCommand& from) {
+    take(into.set_volume, into.volume, from.set_volume, from.volume);
+    take(into.set_pan, into.pan, from.set_pan, from.pan);
+    take(into.set_mute, into.mute, from.set_mute, from.mute);
+    take(into.set_solo, into.solo, from.set_solo, from.solo);
+}
+
+void merge(SetUserStateCommand& into, const SetUserStateCommand& from) {
+    into.user_index = from.user_index;  // Latest index hint
+    take(into.set_mute, into.mute, from.set_mute, from.mute);
+}
+
+void merge(SetUserChannelStateCommand& into,
+           const SetUserChannelStateCommand& from) {
+    into.user_index = from.user_index;
+    take(into.set_sub, into.subscribed, from.set_sub, from.subscribed);
+    take(into.set_vol, into.volume, from.set_vol, from.volume);
+    take(into.set_pan, into.pan, from.set_pan, from.pan);
+    take(into.set_mute, into.mute, from.set_mute, from.mute);
+    take(into.set_solo, into.solo, from.set_solo, from.solo);
+}
+
+template <typename T>
+void post_edit(std::vector<UiCommand>& pending, const T& edit) {
+    for (auto& cmd : pending) {
+        if (auto* existing = std::get_if<T>(&cmd)) {
+            if (same_target(*existing, edit)) {
+                merge(*existing, edit);
+                return;
+            }
+        }
+    }
+    pending.emplace_back(edit);
+}
+
+} // namespace
+
+bool CommandCoalescer::post(const UiCommand& cmd) {
+    return std::visit([&](const auto& c) {
+        using T = std::decay_t<decltype(c)>;
+        if constexpr (std::is_same_v<T, SetLocalChannelMonitoringCommand> ||
+                      std::is_same_v<T, SetUserStateCommand> ||
+                      std::is_same_v<T, SetUserChannelStateCommand>) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            post_edit(pending_, c);
+            return true;
+        } else {
+            return false;
+        }
+    }, cmd);
+}
+
+void CommandCoalescer::drain(std::vector<UiCommand>& out) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_.empty()) {
+            return;
+        }
+        pending_.swap(draining_);
+    }
+    for (auto& cmd : draining_) {
+        out.push_back(std::move(cmd));
+    }
+    draining_.clear();
+}
+
+} // namespace jamwide
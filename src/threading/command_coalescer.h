@@ -0,0 +1,57 @@
+/*
+    JamWide Plugin - command_coalescer.h
+    Latest-value-wins mailbox for UI mixer edits
+    
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#ifndef COMMAND_COALESCER_H
+#define COMMAND_COALESCER_H
+
+#include <mutex>
+#include <vector>
+
+#include "threading/ui_command.h"
+
+namespace jamwide {
+
+/**
+ * Holds the latest pending value of every mixer field the UI has edited,
+ * keyed by target: the local channel, the remote user, or the remote
+ * user's channel. A slider dragged for a second leaves one pending edit
+ * per field rather than a command per frame, and edits are never dropped
+ * for lack of queue space.
+ *
+ * Only mixer state goes through here. Connect, disconnect, chat and the
+ * like stay on the ordered command queue; the Run thread applies that
+ * queue first, then whatever is pending here.
+ *
+ * Thread Safety:
+ *   - post() from the UI thread, drain() from the Run thread. Both hold
+ *     an internal mutex just long enough to merge or swap a short list.
+ */
+class CommandCoalescer {
+public:
+    /**
+     * Merge an edit into the pending set. Fields the command sets replace
+     * any pending value for the same target and field.
+     * @return false if cmd is not a mixer edit (post it to the queue instead)
+     */
+    bool post(const UiCommand& cmd);
+
+    /**
+     * Append the pending edits to out, one command per target, and clear
+     * them. Doesn't allocate once the internal lists have grown to size.
+     */
+    void drain(std::vector<UiCommand>& out);
+
+private:
+    std::mutex mutex_;
+    std::vector<UiCommand> pending_;  // Protected by mutex_, one per target
+    std::vector<UiCommand> draining_; // Run thread only
+};
+
+} // namespace jamwide
+
+#endif // COMMAND_COALESCER_H
@@ -0,0 +1,79 @@
+/*
+    JamWide Plugin - inline_string.h
+    Fixed-capacity string stored inline, for queue records
+    
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#ifndef INLINE_STRING_H
+#define INLINE_STRING_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace jamwide {
+
+/**
+ * String with its characters stored inline, so records holding it can be
+ * copied through SpscRing without touching the heap. Text longer than the
+ * capacity is truncated (at a UTF-8 character boundary).
+ *
+ * @tparam N Capacity in bytes, excluding the terminator
+ */
+template <std::size_t N>
+class InlineString {
+public:
+    InlineString() { data_[0] = '\0'; }
+    InlineString(const char* s) { assign(s); }
+
+    void assign(const char* s) { assign(s, s ? std::strlen(s) : 0); }
+    void assign(const char* s, std::size_t len) {
+        size_ = 0;
+        append(s, len);
+    }
+    void assign(std::string_view s) { assign(s.data(), s.size()); }
+
+    void append(const char* s) { append(s, s ? std::strlen(s) : 0); }
+    void append(const char* s, std::size_t len) {
+        if (len > N - size_) {
+            len = N - size_;
+            // Don't leave half of a multi-byte character at the end
+            while (len > 0 &&
+                   (static_cast<unsigned char>(s[len]) & 0xC0) == 0x80) {
+                --len;
+            }
+        }
+        if (len > 0) {
+            std::memcpy(data_ + size_, s, len);
+            size_ += len;
+        }
+        data_[size_] = '\0';
+    }
+    void append(std::string_view s) { append(s.data(), s.size()); }
+
+    InlineString& operator=(const char* s) { assign(s); return *this; }
+    InlineString& operator=(std::string_view s) { assign(s); return *this; }
+
+    void clear() { size_ = 0; data_[0] = '\0'; }
+
+    const char* c_str() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    static constexpr std::size_t capacity() { return N; }
+
+    std::string_view view() const { return std::string_view(data_, size_); }
+    std::string str() const { return std::string(data_, size_); }
+
+    bool operator==(std::string_view s) const { return view() == s; }
+
+private:
+    std::size_t size_ = 0;
+    char data_[N + 1];
+};
+
+} // namespace jamwide
+
+#endif // INLINE_STRING_H
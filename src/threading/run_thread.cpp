@@ -10,9 +10,14 @@
 #include "plugin/jamwide_plugin.h"
 #include "core/njclient.h"
 #include "net/server_list.h"
+#include "net/server_probe.h"
+#include "net/dns_cache.h"
 #include "debug/logging.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <string_view>
 #include <utility>
 #include <memory>
 #include <type_traits>
@@ -29,81 +34,75 @@ void chat_callback(void* user_data, NJClient* client, const char** parms, int np
         return;
     }
 
-    const std::string type = parms[0] ? parms[0] : "";
-    const std::string user = (nparms > 1 && parms[1]) ? parms[1] : "";
-    const std::string text = (nparms > 2 && parms[2]) ? parms[2] : "";
+    // Messages are built straight into fixed-size records, nothing here
+    // allocates
+    const std::string_view type = parms[0] ? parms[0] : "";
+    const char* user = (nparms > 1 && parms[1]) ? parms[1] : "";
+    const char* text = (nparms > 2 && parms[2]) ? parms[2] : "";
 
     ChatMessage message;
 
     if (type == "TOPIC") {
         if (nparms > 2) {
-            std::string line;
-            if (!user.empty()) {
-                if (!text.empty()) {
-                    line = user + " sets topic to: " + text;
-                } else {
-                    line = user + " removes topic.";
-                }
+            if (*user) {
+                message.content.assign(user);
+                message.content.append(*text ? " sets topic to: " : " removes topic.");
+                message.content.append(text);
+            } else if (*text) {
+                message.content.assign("Topic is: ");
+                message.content.append(text);
             } else {
-                if (!text.empty()) {
-                    line = "Topic is: " + text;
-                } else {
-                    line = "No topic is set.";
-                }
+                message.content.assign("No topic is set.");
             }
             message.type = ChatMessageType::Topic;
-            message.sender = user;
-            message.content = line;
-            plugin->chat_queue.try_push(std::move(message));
+            message.sender.assign(user);
+            plugin->chat_queue.try_push(message);
         }
 
         TopicChangedEvent topic_event;
-        topic_event.topic = text;
-        plugin->ui_queue.try_push(std::move(topic_event));
+        topic_event.topic.assign(text);
+        plugin->ui_queue.try_push(topic_event);
         return;
     }
 
     if (type == "MSG") {
-        if (!user.empty() && !text.empty()) {
-            if (text.rfind("/me ", 0) == 0) {
-                std::string action = text.substr(3);
-                std::size_t pos = action.find_first_not_of(' ');
-                if (pos != std::string::npos) {
-                    action = action.substr(pos);
+        if (*user && *text) {
+            if (std::strncmp(text, "/me ", 4) == 0) {
+                const char* action = text + 3;
+                while (*action == ' ') {
+                    ++action;
                 }
                 message.type = ChatMessageType::Action;
-                message.sender = user;
-                message.content = action;
+                message.content.assign(action);
             } else {
                 message.type = ChatMessageType::Message;
-                message.sender = user;
-                message.content = text;
+                message.content.assign(text);
             }
-            plugin->chat_queue.try_push(std::move(message));
+            message.sender.assign(user);
+            plugin->chat_queue.try_push(message);
         }
         return;
     }
 
     if (type == "PRIVMSG") {
-        if (!user.empty() && !text.empty()) {
+        if (*user && *text) {
             message.type = ChatMessageType::PrivateMessage;
-            message.sender = user;
-            message.content = text;
-            plugin->chat_queue.try_push(std::move(message));
+            message.sender.assign(user);
+            message.content.assign(text);
+            plugin->chat_queue.try_push(message);
         }
         return;
     }
 
     if (type == "JOIN" || type == "PART") {
-        if (!user.empty()) {
-            message.type = (type == "JOIN")
-                ? ChatMessageType::Join
-                : ChatMessageType::Part;
-            message.sender = user;
-            message.content = user + (type == "JOIN"
-                ? " has joined the server"
-                : " has left the server");
-            plugin->chat_queue.try_push(std::move(message));
+        if (*user) {
+            const bool join = type == "JOIN";
+            message.type = join ? ChatMessageType::Join : ChatMessageType::Part;
+            message.sender.assign(user);
+            message.content.assign(user);
+            message.content.append(join ? " has joined the server"
+                                        : " has left the server");
+            plugin->chat_queue.try_push(message);
         }
         return;
     }
@@ -127,8 +126,11 @@ int license_callback(void* user_data, const char* license_text) {
     plugin->license_pending.store(true, std::memory_order_release);
     plugin->license_cv.notify_one();
 
-    // Release client mutex while waiting for UI response (ReaNINJAM pattern).
-    plugin->client_mutex.unlock();
+    // The serialize_audio_proc diagnostic holds client_mutex across Run();
+    // don't stall the audio thread for as long as the dialog is up.
+    if (plugin->serialize_audio_proc) {
+        plugin->client_mutex.unlock();
+    }
 
     std::unique_lock<std::mutex> lock(plugin->license_mutex);
     const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
@@ -145,7 +147,9 @@ int license_callback(void* user_data, const char* license_text) {
         plugin->license_response.store(response, std::memory_order_release);
     }
     plugin->license_pending.store(false, std::memory_order_release);
-    plugin->client_mutex.lock();
+    if (plugin->serialize_audio_proc) {
+        plugin->client_mutex.lock();
+    }
     NLOG("[License] Returning %d (1=accept, 0=reject)\n", response > 0 ? 1 : 0);
     return response > 0 ? 1 : 0;
 }
@@ -162,11 +166,145 @@ void setup_callbacks(JamWidePlugin* plugin) {
     plugin->client->ChatMessage_User = plugin;
     plugin->client->LicenseAgreementCallback = license_callback;
     plugin->client->LicenseAgreement_User = plugin;
+    plugin->client->config_dns = &DnsCache::instance();
+}
+
+// Build the client on first use. Runs on the main thread, like activate and
+// deactivate, so nothing else creates or destroys it meanwhile; the Run
+// thread may already be up and only picks it up once client_ready is set.
+void ensure_client(JamWidePlugin* plugin) {
+    if (plugin->client_ready.load(std::memory_order_relaxed)) {
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> client_lock(plugin->client_mutex);
+        plugin->client = std::make_unique<NJClient>();
+        plugin->client->config_meters = &plugin->meters;
+        plugin->client->PrepareAudio(static_cast<int>(plugin->max_frames),
+                                     static_cast<int>(plugin->sample_rate));
+    }
+    setup_callbacks(plugin);
+    plugin->client_ready.store(true, std::memory_order_release);
+    NLOG("[Init] NJClient created on demand in %.2f ms\n",
+         std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start).count());
+}
+
+// Deliver a fetched server list and start probing it, then report any
+// probes that have finished
+void poll_server_list(JamWidePlugin* plugin,
+                      ServerListFetcher& server_list,
+                      ServerProber& prober) {
+    ServerListResult list_result;
+    if (server_list.poll(list_result)) {
+        prober.start(list_result.servers);
+        plugin->server_list_buffer.write_buffer() = std::move(list_result.servers);
+        plugin->server_list_buffer.publish();
+        ServerListEvent event;
+        event.error.assign(list_result.error);
+        plugin->ui_queue.try_push(event);
+    }
+
+    std::vector<ServerProbeResult> results;
+    if (prober.poll(results)) {
+        for (auto& r : results) {
+            ServerProbeEvent event;
+            event.host.assign(r.host);
+            event.port = r.port;
+            event.rtt_ms = r.rtt_ms;
+            event.handshake_ms = r.handshake_ms;
+            event.error.assign(r.error);
+            plugin->ui_queue.try_push(event);
+        }
+    }
+}
+
+// Index of the user a remote edit was meant for, or -1 if they have left
+int resolve_user_index(NJClient* client, int hint, const std::string& name) {
+    if (name.empty()) {
+        return hint;
+    }
+    const int num_users = client->GetNumUsers();
+    if (hint >= 0 && hint < num_users) {
+        const char* user_name = client->GetUserState(hint);
+        if (user_name && name == user_name) {
+            return hint;
+        }
+    }
+    for (int u = 0; u < num_users; ++u) {
+        const char* user_name = client->GetUserState(u);
+        if (user_name && name == user_name) {
+            return u;
+        }
+    }
+    return -1;
+}
+
+// While connected, the UI's interval position is refreshed at least this often
+constexpr int kPositionRefreshMs = 33;
+
+// While a local channel is broadcasting, captured audio is picked up at least this often
+constexpr int kEncodePollMs = 10;
+
+void publish_remote_snapshot(JamWidePlugin* plugin, NJClient* client,
+                             uint64_t version) {
+    RemoteMixerSnapshot& snapshot = plugin->remote_snapshot.write_buffer();
+    client->UpdateRemoteMixerView(&snapshot.mixer);
+    snapshot.version = version;
+    plugin->remote_snapshot.publish();
+}
+
+// Without a client, commands are held until one exists. Later commands
+// supersede held ones of the same kind so the list stays bounded however
+// long that takes: at most one connect, one prewarm and one channel-info
+// command per channel. Mixer edits never get here, run_thread_post() sends
+// them to mixer_edits, which keeps them until there is a client.
+void hold_without_client(std::vector<UiCommand>& held, UiCommand&& cmd) {
+    const auto drop_held = [&](auto pred) {
+        held.erase(std::remove_if(held.begin(), held.end(), pred), held.end());
+    };
+
+    if (std::holds_alternative<DisconnectCommand>(cmd)) {
+        // Nothing to disconnect yet; just don't connect
+        drop_held([](const UiCommand& c) {
+            return std::holds_alternative<ConnectCommand>(c) ||
+                   std::holds_alternative<PrewarmCommand>(c);
+        });
+        return;
+    }
+    if (std::holds_alternative<SendChatCommand>(cmd)) {
+        return;  // No session to send it in
+    }
+    if (std::holds_alternative<ConnectCommand>(cmd)) {
+        drop_held([](const UiCommand& c) { return std::holds_alternative<ConnectCommand>(c); });
+    } else if (std::holds_alternative<PrewarmCommand>(cmd)) {
+        drop_held([](const UiCommand& c) { return std::holds_alternative<PrewarmCommand>(c); });
+    } else if (auto* info = std::get_if<SetLocalChannelInfoCommand>(&cmd)) {
+        for (auto& h : held) {
+            auto* prev = std::get_if<SetLocalChannelInfoCommand>(&h);
+            if (!prev || prev->channel != info->channel) {
+                continue;
+            }
+            prev->name = std::move(info->name);
+            if (info->set_bitrate) {
+                prev->set_bitrate = true;
+                prev->bitrate = info->bitrate;
+            }
+            if (info->set_transmit) {
+                prev->set_transmit = true;
+                prev->transmit = info->transmit;
+            }
+            return;
+        }
+    }
+    held.push_back(std::move(cmd));
 }
 
 void process_commands(JamWidePlugin* plugin,
                       ServerListFetcher& server_list,
-                      std::vector<UiCommand>& client_cmds) {
+                      std::vector<UiCommand>& client_cmds,
+                      bool have_client) {
     if (!plugin) {
         return;
     }
@@ -182,8 +320,18 @@ void process_commands(JamWidePlugin* plugin,
             plugin->username = connect->username;
             plugin->password = connect->password;
         }
-        client_cmds.push_back(std::move(cmd));
+        if (have_client) {
+            client_cmds.push_back(std::move(cmd));
+        } else {
+            hold_without_client(client_cmds, std::move(cmd));
+        }
     });
+
+    // Mixer edits go after the ordered commands, latest value per field.
+    // Without a client they stay coalesced in mixer_edits instead.
+    if (have_client) {
+        plugin->mixer_edits.drain(client_cmds);
+    }
 }
 
 void execute_client_commands(JamWidePlugin* plugin,
@@ -215,6 +363,8 @@ void execute_client_commands(JamWidePlugin* plugin,
                 client->cached_status.store(NJClient::NJC_STATUS_DISCONNECTED,
                                             std::memory_order_release);
                 client->Disconnect();
+            } else if constexpr (std::is_same_v<T, PrewarmCommand>) {
+                client->PrewarmConnection(c.server.c_str());
             } else if constexpr (std::is_same_v<T, SetLocalChannelInfoCommand>) {
                 client->SetLocalChannelInfo(
                     c.channel,
@@ -222,6 +372,8 @@ void execute_client_commands(JamWidePlugin* plugin,
                     false, 0,
                     c.set_bitrate, c.bitrate,
                     c.set_transmit, c.transmit);
+                // Coalesced by NJClient, sent once on the next Run() pass
+                client->NotifyServerOfChannelChange();
             } else if constexpr (std::is_same_v<T, SetLocalChannelMonitoringCommand>) {
                 client->SetLocalChannelMonitoring(
                     c.channel,
@@ -230,14 +382,22 @@ void execute_client_commands(JamWidePlugin* plugin,
                     c.set_mute, c.mute,
                     c.set_solo, c.solo);
             } else if constexpr (std::is_same_v<T, SetUserStateCommand>) {
+                const int user_index = resolve_user_index(client, c.user_index, c.user_name);
+                if (user_index < 0) {
+                    return;
+                }
                 client->SetUserState(
-                    c.user_index,
+                    user_index,
                     false, 0.0f,
                     false, 0.0f,
                     c.set_mute, c.mute);
             } else if constexpr (std::is_same_v<T, SetUserChannelStateCommand>) {
+                const int user_index = resolve_user_index(client, c.user_index, c.user_name);
+                if (user_index < 0) {
+                    return;
+                }
                 client->SetUserChannelState(
-                    c.user_index, c.channel_index,
+                    user_index, c.channel_index,
                     c.set_sub, c.subscribed,
                     c.set_vol, c.volume,
                     c.set_pan, c.pan,
@@ -273,12 +433,21 @@ void run_thread_func(std::shared_ptr<JamWidePlugin> plugin) {
     NLOG("[RunThread] Started\n");
     int last_status = NJClient::NJC_STATUS_DISCONNECTED;
     ServerListFetcher server_list;
+    ServerProber prober;
     std::vector<UiCommand> client_cmds;
+    int last_recv_stalls = 0;
+    uint64_t snapshot_version = 0;
+    unsigned int last_remote_version = 0;
+    int last_send_stalls = 0;
+#ifdef JAMWIDE_DEV_BUILD
+    Net_Connection::Stats last_send_stats{};
+    auto last_send_stats_time = std::chrono::steady_clock::now();
+#endif
 
     while (!plugin->shutdown.load(std::memory_order_acquire)) {
         bool status_changed = false;
         int current_status = last_status;
-        std::string error_msg;
+        InlineString<255> error_msg;
         int pos = 0;
         int len = 0;
         int bpi = 0;
@@ -286,21 +455,33 @@ void run_thread_func(std::shared_ptr<JamWidePlugin> plugin) {
         int beat_pos = 0;
         bool have_position = false;
 
-        client_cmds.clear();
-        process_commands(plugin.get(), server_list, client_cmds);
+        // Commands stay in client_cmds until there is a client to run them
+        process_commands(plugin.get(), server_list, client_cmds,
+                         plugin->client_ready.load(std::memory_order_acquire));
 
-        plugin->client_mutex.lock();
-        NJClient* client = plugin->client.get();
+        // The client outlives this thread (run_thread_stop comes before it's
+        // destroyed), so a pass only locks for the serialization diagnostic.
+        std::unique_lock<std::mutex> client_lock(plugin->client_mutex, std::defer_lock);
+        if (plugin->serialize_audio_proc) {
+            client_lock.lock();
+        }
+        NJClient* client = plugin->client_ready.load(std::memory_order_acquire)
+                               ? plugin->client.get() : nullptr;
         if (!client) {
-            plugin->client_mutex.unlock();
-            ServerListResult list_result;
-            if (server_list.poll(list_result)) {
-                ServerListEvent event;
-                event.servers = std::move(list_result.servers);
-                event.error = std::move(list_result.error);
-                plugin->ui_queue.try_push(std::move(event));
+            if (client_lock.owns_lock()) {
+                client_lock.unlock();
+            }
+            prober.set_suspended(false);
+            poll_server_list(plugin.get(), server_list, prober);
+            // Nothing to do until a command arrives, unless a list fetch or
+            // server probes are in flight
+            int idle_timeout_ms = -1;
+            if (prober.in_flight()) {
+                idle_timeout_ms = ServerProber::kPollIntervalMs;
+            } else if (server_list.in_flight()) {
+                idle_timeout_ms = 50;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            plugin->run_wakeup.wait(INVALID_SOCKET, false, idle_timeout_ms);
             continue;
         }
         
@@ -313,25 +494,48 @@ void run_thread_func(std::shared_ptr<JamWidePlugin> plugin) {
             // Check shutdown between iterations
             if (plugin->shutdown.load(std::memory_order_acquire)) {
                 NLOG("[RunThread] Shutdown requested\n");
-                plugin->client_mutex.unlock();
                 return;
             }
         }
         NLOG_VERBOSE("[RunThread] client->Run() returned %d\n", run_result);
 
+        // The audio thread doesn't wake us; while it keeps queuing audio, poll for it
+        const bool encoding = client->TakeWorkAvailable();
+
+        // Meters come from the meter bank, so only publish when something changed
+        const unsigned int remote_version = client->GetRemoteVersion();
+        if (remote_version != last_remote_version) {
+            publish_remote_snapshot(plugin.get(), client, ++snapshot_version);
+            last_remote_version = remote_version;
+        }
+
+        bool want_write = false;
+        const SOCKET net_socket = client->GetNetSocket(&want_write);
+
         current_status = client->GetStatus();
         if (current_status != last_status) {
+            const int prev_status = last_status;
             status_changed = true;
             NLOG("[RunThread] Status changed: %d -> %d\n", last_status, current_status);
             last_status = current_status;
             const char* err = client->GetErrorStr();
             if (err && err[0]) {
-                error_msg = err;
+                error_msg.assign(err);
                 NLOG("[RunThread] Error: %s\n", err);
             }
             
+            NJClient::ConnectTimings timings;
+            if (current_status == NJClient::NJC_STATUS_OK && client->GetConnectTimings(&timings)) {
+                NLOG("[RunThread] Connect took %.1fms: resolve %.1fms, tcp %.1fms, challenge %.1fms, auth %.1fms%s\n",
+                     timings.total_ms, timings.resolve_ms, timings.tcp_ms,
+                     timings.challenge_ms, timings.auth_ms,
+                     timings.prewarmed ? " (prewarmed)" : "");
+            }
+
             // Initialize default local channel when connection succeeds
-            if (current_status == NJClient::NJC_STATUS_OK) {
+            // (a reconnect keeps whatever the user has set up)
+            if (current_status == NJClient::NJC_STATUS_OK &&
+                prev_status != NJClient::NJC_STATUS_RECONNECTING) {
                 NLOG("[RunThread] Connection established, initializing local channel 0\n");
                 std::lock_guard<std::mutex> state_lock(plugin->state_mutex);
                 const char* ch_name = plugin->ui_state.local_name_input[0] ? 
@@ -352,11 +556,59 @@ void run_thread_func(std::shared_ptr<JamWidePlugin> plugin) {
                 beat_pos = (pos * bpi) / len;
             }
             have_position = true;
+
+            Net_Connection::Health health{};
+            if (client->GetConnectionHealth(&health)) {
+                if (health.recv_stalls > last_recv_stalls) {
+                    NLOG("[RunThread] Receive stall: nothing from server for %dms (rtt %.1fms)\n",
+                         health.recv_gap_ms, health.rtt_ms);
+                }
+                if (health.send_stalls > last_send_stalls) {
+                    NLOG("[RunThread] Send stall: upload backlog not draining (retransmits %d)\n",
+                         health.tcp_retransmits);
+                }
+                last_recv_stalls = health.recv_stalls;
+                last_send_stalls = health.send_stalls;
+            }
+
+#ifdef JAMWIDE_DEV_BUILD
+            // Send path cost: system calls and bytes copied per second of audio
+            Net_Connection::Stats send_stats;
+            const auto now = std::chrono::steady_clock::now();
+            const double secs = std::chrono::duration<double>(now - last_send_stats_time).count();
+            if (secs >= 10.0 && client->GetNetSendStats(&send_stats)) {
+                if (send_stats.bytes_sent >= last_send_stats.bytes_sent) {
+                    NLOG_VERBOSE("[RunThread] send: %.1f syscalls/s, %.0f bytes/s sent, %.0f bytes/s copied\n",
+                                 (send_stats.send_calls - last_send_stats.send_calls) / secs,
+                                 (send_stats.bytes_sent - last_send_stats.bytes_sent) / secs,
+                                 (send_stats.bytes_copied - last_send_stats.bytes_copied) / secs);
+                    static const char* const prio_names[NET_CON_NUM_PRIO] = {"control", "voice", "bulk"};
+                    for (int p = 0; p < NET_CON_NUM_PRIO; ++p) {
+                        const auto& ps = send_stats.prio[p];
+                        NLOG_VERBOSE("[RunThread] send %s: %d queued, delay avg %.1fms max %.1fms\n",
+                                     prio_names[p], ps.queued, ps.delay_avg_ms, ps.delay_max_ms);
+                    }
+                    NLOG_VERBOSE("[RunThread] health: rtt %.1fms (min %.1fms) jitter %.1fms, max recv gap %dms, %d/%d recv/send stalls\n",
+                                 health.rtt_ms, health.rtt_min_ms, health.jitter_ms,
+                                 health.max_recv_gap_ms, health.recv_stalls, health.send_stalls);
+                }
+                last_send_stats = send_stats;
+                last_send_stats_time = now;
+            }
+#endif
         }
 
-        plugin->client_mutex.unlock();
+        if (client_lock.owns_lock()) {
+            client_lock.unlock();
+        }
 
         if (have_position) {
+            auto& snap = plugin->ui_snapshot;
+            if (snap.beat_position.load(std::memory_order_relaxed) != beat_pos ||
+                snap.bpi.load(std::memory_order_relaxed) != bpi ||
+                snap.bpm.load(std::memory_order_relaxed) != bpm) {
+                snap.changes.fetch_add(1, std::memory_order_relaxed);
+            }
             plugin->ui_snapshot.bpm.store(bpm, std::memory_order_relaxed);
             plugin->ui_snapshot.bpi.store(bpi, std::memory_order_relaxed);
             plugin->ui_snapshot.interval_position.store(pos, std::memory_order_relaxed);
@@ -368,27 +620,38 @@ void run_thread_func(std::shared_ptr<JamWidePlugin> plugin) {
             StatusChangedEvent event;
             event.status = current_status;
             event.error_msg = error_msg;
-            plugin->ui_queue.try_push(std::move(event));
+            plugin->ui_queue.try_push(event);
         }
 
-        {
-            ServerListResult list_result;
-            if (server_list.poll(list_result)) {
-                ServerListEvent event;
-                event.servers = std::move(list_result.servers);
-                event.error = std::move(list_result.error);
-                plugin->ui_queue.try_push(std::move(event));
-            }
-        }
-        
-        // Adaptive sleep based on connection state
-        // Connected: faster polling for responsiveness
-        // Disconnected: slower polling to save resources
-        auto sleep_time = (current_status == NJClient::NJC_STATUS_DISCONNECTED)
-            ? std::chrono::milliseconds(50)  // Disconnected: 20 Hz
-            : std::chrono::milliseconds(20); // Connected/connecting: 50 Hz
+        // No probing during a session: it would cap the wait at 5 ms and compete for the link
+        prober.set_suspended(current_status == NJClient::NJC_STATUS_OK);
+        poll_server_list(plugin.get(), server_list, prober);
         
-        std::this_thread::sleep_for(sleep_time);
+        // Block until there is something to do: server traffic, a UI command,
+        // or a timer (keepalives, timeouts, polling for captured audio).
+        int timeout_ms;
+        if (net_socket != INVALID_SOCKET) {
+            timeout_ms = 250;   // Connected: socket readiness drives us
+        } else if (current_status == NJClient::NJC_STATUS_PRECONNECT ||
+                   current_status == NJClient::NJC_STATUS_RECONNECTING ||
+                   current_status == NJClient::NJC_STATUS_OK) {
+            timeout_ms = 20;    // Resolving/connecting/backing off: no socket to wait on yet
+        } else {
+            // Disconnected or failed: idle until a command arrives
+            timeout_ms = server_list.in_flight() ? 50 : -1;
+        }
+        if (current_status == NJClient::NJC_STATUS_OK &&
+            timeout_ms > kPositionRefreshMs) {
+            timeout_ms = kPositionRefreshMs;  // Keep the interval position moving
+        }
+        if (encoding && (timeout_ms < 0 || timeout_ms > kEncodePollMs)) {
+            timeout_ms = kEncodePollMs;  // Captured audio is arriving, encode and send it promptly
+        }
+        if (prober.in_flight() &&
+            (timeout_ms < 0 || timeout_ms > ServerProber::kPollIntervalMs)) {
+            timeout_ms = ServerProber::kPollIntervalMs;  // Probe timings need frequent polls
+        }
+        plugin->run_wakeup.wait(net_socket, want_write, timeout_ms);
     }
 }
 
@@ -411,6 +674,7 @@ void run_thread_start(JamWidePlugin* plugin,
 void run_thread_stop(JamWidePlugin* plugin) {
     // Signal shutdown
     plugin->shutdown.store(true, std::memory_order_release);
+    plugin->run_wakeup.signal();
     
     // Wake up license wait if blocked
     // This prevents deadlock if Run thread is waiting for license response
@@ -427,4 +691,27 @@ void run_thread_stop(JamWidePlugin* plugin) {
     }
 }
 
+bool run_thread_post(JamWidePlugin* plugin, UiCommand&& cmd) {
+    if (!plugin) {
+        return false;
+    }
+
+    // Staged start: the Run thread comes up with the first command and the
+    // client with the first connect, instead of both at activate
+    if (std::holds_alternative<ConnectCommand>(cmd) ||
+        std::holds_alternative<PrewarmCommand>(cmd)) {
+        ensure_client(plugin);
+    }
+    if (!plugin->run_thread.joinable()) {
+        run_thread_start(plugin, plugin->shared_from_this());
+    }
+
+    if (!plugin->mixer_edits.post(cmd) &&
+        !plugin->cmd_queue.try_push(std::move(cmd))) {
+        return false;
+    }
+    plugin->run_wakeup.signal();
+    return true;
+}
+
 } // namespace jamwide
@@ -11,13 +11,15 @@
 
 #include <memory>
 
+#include "threading/ui_command.h"
+
 namespace jamwide {
 
 struct JamWidePlugin;
 
 /**
  * Start the Run thread.
- * Called from plugin activate.
+ * Called by run_thread_post() when the first command arrives.
  * 
  * @param plugin Plugin instance
  */
@@ -26,13 +28,27 @@ void run_thread_start(JamWidePlugin* plugin,
 
 /**
  * Stop the Run thread.
- * Called from plugin deactivate.
+ * Called from plugin deactivate; the next command starts it again.
  * Blocks until thread terminates.
  * 
  * @param plugin Plugin instance
  */
 void run_thread_stop(JamWidePlugin* plugin);
 
+/**
+ * Queue a command for the Run thread and wake it.
+ * Called from the UI (main) thread (single producer). Starts the Run thread
+ * if it isn't running, and builds the NJClient on the first connect or
+ * prewarm. Commands queued before that wait for the client.
+ * Mixer edits are merged with any still pending for the same target
+ * (see CommandCoalescer); everything else is queued in order.
+ *
+ * @param plugin Plugin instance
+ * @param cmd Command to queue
+ * @return false if the command queue is full
+ */
+bool run_thread_post(JamWidePlugin* plugin, UiCommand&& cmd);
+
 } // namespace jamwide
 
 #endif // RUN_THREAD_H
@@ -0,0 +1,160 @@
+/*
+    JamWide Plugin - run_wakeup.cpp
+    Wakeup primitive for the event-driven Run thread
+    
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#include "run_wakeup.h"
+
+#ifdef _WIN32
+#include "wdl/jnetlib/util.h"
+#elif defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+namespace jamwide {
+
+#ifdef _WIN32
+
+RunWakeup::RunWakeup() {
+    JNL::open_socketlib();
+    sock_ = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock_ == INVALID_SOCKET) {
+        return;
+    }
+    addr_.sin_family = AF_INET;
+    addr_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr_.sin_port = 0;
+    int addr_len = sizeof(addr_);
+    if (::bind(sock_, reinterpret_cast<sockaddr*>(&addr_), sizeof(addr_)) != 0 ||
+        ::getsockname(sock_, reinterpret_cast<sockaddr*>(&addr_), &addr_len) != 0) {
+        closesocket(sock_);
+        sock_ = INVALID_SOCKET;
+        return;
+    }
+    SET_SOCK_BLOCK(sock_, 0);
+}
+
+RunWakeup::~RunWakeup() {
+    if (sock_ != INVALID_SOCKET) {
+        closesocket(sock_);
+    }
+    JNL::close_socketlib();
+}
+
+void RunWakeup::signal() {
+    if (pending_.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+    if (sock_ != INVALID_SOCKET) {
+        const char b = 0;
+        ::sendto(sock_, &b, 1, 0, reinterpret_cast<const sockaddr*>(&addr_), sizeof(addr_));
+    }
+}
+
+void RunWakeup::drain() {
+    char buf[64];
+    while (::recv(sock_, buf, sizeof(buf), 0) > 0) {
+    }
+}
+
+void RunWakeup::wait(SOCKET sock, bool want_write, int timeout_ms) {
+    if (sock_ == INVALID_SOCKET) {
+        // No wakeup socket, fall back to a short sleep.
+        Sleep(timeout_ms < 0 || timeout_ms > 20 ? 20 : timeout_ms);
+        pending_.store(false, std::memory_order_release);
+        return;
+    }
+    WSAPOLLFD fds[2] = {};
+    fds[0].fd = sock_;
+    fds[0].events = POLLRDNORM;
+    ULONG nfds = 1;
+    if (sock != INVALID_SOCKET) {
+        fds[1].fd = sock;
+        fds[1].events = POLLRDNORM | (want_write ? POLLWRNORM : 0);
+        nfds = 2;
+    }
+    WSAPoll(fds, nfds, timeout_ms);
+    pending_.store(false, std::memory_order_release);
+    if (fds[0].revents) {
+        drain();
+    }
+}
+
+#else
+
+RunWakeup::RunWakeup() {
+#ifdef __linux__
+    read_fd_ = write_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    int fds[2];
+    if (pipe(fds) == 0) {
+        read_fd_ = fds[0];
+        write_fd_ = fds[1];
+        for (int fd : fds) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+#endif
+}
+
+RunWakeup::~RunWakeup() {
+    if (read_fd_ >= 0) {
+        close(read_fd_);
+    }
+    if (write_fd_ >= 0 && write_fd_ != read_fd_) {
+        close(write_fd_);
+    }
+}
+
+void RunWakeup::signal() {
+    if (pending_.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+    if (write_fd_ >= 0) {
+#ifdef __linux__
+        const uint64_t one = 1;
+        ssize_t r = ::write(write_fd_, &one, sizeof(one));
+#else
+        const char b = 0;
+        ssize_t r = ::write(write_fd_, &b, 1);
+#endif
+        (void)r;
+    }
+}
+
+void RunWakeup::drain() {
+    char buf[64];
+    while (::read(read_fd_, buf, sizeof(buf)) > 0) {
+    }
+}
+
+void RunWakeup::wait(SOCKET sock, bool want_write, int timeout_ms) {
+    if (read_fd_ < 0) {
+        // No wakeup descriptor, fall back to a short sleep.
+        poll(nullptr, 0, timeout_ms < 0 || timeout_ms > 20 ? 20 : timeout_ms);
+        pending_.store(false, std::memory_order_release);
+        return;
+    }
+    struct pollfd fds[2] = {};
+    fds[0].fd = read_fd_;
+    fds[0].events = POLLIN;
+    nfds_t nfds = 1;
+    if (sock != INVALID_SOCKET) {
+        fds[1].fd = sock;
+        fds[1].events = POLLIN | (want_write ? POLLOUT : 0);
+        nfds = 2;
+    }
+    poll(fds, nfds, timeout_ms);
+    pending_.store(false, std::memory_order_release);
+    if (fds[0].revents) {
+        drain();
+    }
+}
+
+#endif
+
+} // namespace jamwide
@@ -0,0 +1,69 @@
+/*
+    JamWide Plugin - run_wakeup.h
+    Wakeup primitive for the event-driven Run thread
+    
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#ifndef RUN_WAKEUP_H
+#define RUN_WAKEUP_H
+
+#include <atomic>
+
+#include "wdl/jnetlib/netinc.h"
+
+namespace jamwide {
+
+/**
+ * Lets the Run thread block on the server socket and still be woken
+ * promptly by other threads (UI commands, plugin lifecycle).
+ *
+ * Backed by an eventfd on Linux, a pipe on other POSIX systems and a
+ * loopback UDP socket on Windows, so it can be polled alongside sockets.
+ *
+ * Thread Safety:
+ *   - signal() may be called from any non-realtime thread. It writes to a
+ *     descriptor, so the audio thread must not call it; NJClient instead
+ *     raises a flag the Run thread polls (NJClient::TakeWorkAvailable).
+ *     Repeated signals before the next wait() cost a single atomic exchange.
+ *   - wait() must only be called from the Run thread.
+ */
+class RunWakeup {
+public:
+    RunWakeup();
+    ~RunWakeup();
+
+    RunWakeup(const RunWakeup&) = delete;
+    RunWakeup& operator=(const RunWakeup&) = delete;
+
+    /**
+     * Wake the Run thread (or make its next wait() return immediately).
+     */
+    void signal();
+
+    /**
+     * Block until signalled, sock becomes readable (or writable, if
+     * want_write), or timeout_ms elapses.
+     * @param sock Socket to watch, or INVALID_SOCKET for none
+     * @param want_write Also wake when sock is writable
+     * @param timeout_ms Timeout in milliseconds, -1 to wait indefinitely
+     */
+    void wait(SOCKET sock, bool want_write, int timeout_ms);
+
+private:
+    void drain();
+
+    std::atomic<bool> pending_{false};
+#ifdef _WIN32
+    SOCKET sock_ = INVALID_SOCKET;
+    struct sockaddr_in addr_ {};
+#else
+    int read_fd_ = -1;
+    int write_fd_ = -1;
+#endif
+};
+
+} // namespace jamwide
+
+#endif // RUN_WAKEUP_H
@@ -25,6 +25,7 @@ namespace jamwide {
  *   - One thread may call try_push() (producer)
  *   - One thread may call try_pop()/drain() (consumer)
  *   - Different threads for producer and consumer is safe
+ *   - dropped() may be read from any thread
  * 
  * @tparam T      Element type (must be trivially copyable or movable)
  * @tparam N      Capacity (must be power of 2 for efficient masking)
@@ -54,6 +55,7 @@ public:
         
         // Check if full (next head would catch up to tail)
         if (next_head == tail_.load(std::memory_order_acquire)) {
+            count_drop();
             return false;  // Full
         }
         
@@ -72,6 +74,7 @@ public:
         const std::size_t next_head = (head + 1) & mask_;
         
         if (next_head == tail_.load(std::memory_order_acquire)) {
+            count_drop();
             return false;
         }
         
@@ -137,14 +140,28 @@ public:
      */
     static constexpr std::size_t capacity() { return N; }
 
+    /**
+     * Number of pushes refused because the queue was full.
+     */
+    std::size_t dropped() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
 private:
     static constexpr std::size_t mask_ = N - 1;
+
+    // Producer only, so a relaxed read-modify-store is enough
+    void count_drop() {
+        dropped_.store(dropped_.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+    }
     
     std::array<T, N> buffer_;
     
     // Separate cache lines to avoid false sharing
     alignas(64) std::atomic<std::size_t> head_;
     alignas(64) std::atomic<std::size_t> tail_;
+    std::atomic<std::size_t> dropped_{0};  // Written by the producer only
 };
 
 } // namespace jamwide
@@ -0,0 +1,90 @@
+/*
+    JamWide Plugin - triple_buffer.h
+    Lock-free triple buffer for publishing snapshots between two threads
+    
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+namespace jamwide {
+
+/**
+ * Lock-free triple buffer: one writer publishes whole snapshots, one reader
+ * picks up the newest whenever it likes. Neither side ever waits, and a
+ * snapshot is never modified while the reader holds it.
+ *
+ * Thread Safety:
+ *   - One thread may call write_buffer()/publish() (writer)
+ *   - One thread may call update()/read_buffer() (reader)
+ *
+ * The buffers are recycled, so the writer must overwrite everything it
+ * uses in write_buffer() before publishing; containers keep their capacity.
+ *
+ * @tparam T  Snapshot type
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+
+    // Non-copyable, non-movable
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /**
+     * Buffer to fill before publish() (writer only).
+     */
+    T& write_buffer() { return buffers_[write_]; }
+
+    /**
+     * Make the write buffer the newest snapshot (writer only).
+     */
+    void publish() {
+        const int prev = middle_.exchange(write_ | kFresh, std::memory_order_acq_rel);
+        write_ = prev & kIndexMask;
+    }
+
+    /**
+     * Switch to the newest published snapshot, if there is one (reader only).
+     * @return true if read_buffer() changed
+     */
+    bool update() {
+        if (!(middle_.load(std::memory_order_relaxed) & kFresh)) {
+            return false;
+        }
+        const int prev = middle_.exchange(read_, std::memory_order_acq_rel);
+        read_ = prev & kIndexMask;
+        return true;
+    }
+
+    /**
+     * Whether a snapshot is waiting that update() would switch to (reader only).
+     */
+    bool has_update() const {
+        return (middle_.load(std::memory_order_relaxed) & kFresh) != 0;
+    }
+
+    /**
+     * Current snapshot (reader only). The reader may modify it, e.g. to
+     * show an edit before the writer publishes it back.
+     */
+    T& read_buffer() { return buffers_[read_]; }
+
+private:
+    static constexpr int kIndexMask = 3;
+    static constexpr int kFresh = 4;
+
+    T buffers_[3];
+    std::atomic<int> middle_{1};  // Index of the spare buffer, plus kFresh if unread
+    int write_ = 0;
+    int read_ = 2;
+};
+
+} // namespace jamwide
+
+#endif // TRIPLE_BUFFER_H
@@ -20,6 +20,11 @@ struct ConnectCommand {
 struct DisconnectCommand {
 };
 
+// Open the TCP connection to a server the user is likely to join
+struct PrewarmCommand {
+    std::string server;
+};
+
 struct SetLocalChannelInfoCommand {
     int channel = 0;
     std::string name;
@@ -41,14 +46,19 @@ struct SetLocalChannelMonitoringCommand {
     bool solo = false;
 };
 
+// Remote user edits name the user as well as the index seen in the UI's
+// snapshot; the Run thread looks the user up by name if the index has
+// moved on since, and drops the edit if they have left
 struct SetUserStateCommand {
     int user_index = 0;
+    std::string user_name;
     bool set_mute = false;
     bool mute = false;
 };
 
 struct SetUserChannelStateCommand {
     int user_index = 0;
+    std::string user_name;
     int channel_index = 0;
     bool set_sub = false;
     bool subscribed = false;
@@ -75,6 +85,7 @@ struct SendChatCommand {
 using UiCommand = std::variant<
     ConnectCommand,
     DisconnectCommand,
+    PrewarmCommand,
     SetLocalChannelInfoCommand,
     SetLocalChannelMonitoringCommand,
     SetUserStateCommand,
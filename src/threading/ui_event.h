@@ -9,28 +9,20 @@
 #ifndef UI_EVENT_H
 #define UI_EVENT_H
 
-#include <string>
 #include <variant>
-#include <vector>
-#include "ui/server_list_types.h"
+#include "threading/inline_string.h"
 
 namespace jamwide {
 
-/**
- * Chat message received from server or other users.
- */
-struct ChatMessageEvent {
-    std::string type;   // "MSG", "PRIVMSG", "JOIN", "PART", "TOPIC", etc.
-    std::string user;   // Username (empty for server messages)
-    std::string text;   // Message content
-};
+// Events are fixed-size records, so queueing one never allocates on the
+// Run thread. Chat messages travel separately (ChatMessage, chat_queue).
 
 /**
  * Connection status changed.
  */
 struct StatusChangedEvent {
-    int status;             // NJC_STATUS_* value
-    std::string error_msg;  // Error description (if any)
+    int status;                        // NJC_STATUS_* value
+    InlineString<255> error_msg;       // Error description (if any)
 };
 
 /**
@@ -45,15 +37,26 @@ struct UserInfoChangedEvent {
  * Server topic changed.
  */
 struct TopicChangedEvent {
-    std::string topic;
+    InlineString<511> topic;
 };
 
 /**
- * Public server list update.
+ * Public server list update. The entries themselves are handed over in
+ * JamWidePlugin::server_list_buffer, which the UI swaps its own list with.
  */
 struct ServerListEvent {
-    std::vector<ServerListEntry> servers;
-    std::string error;
+    InlineString<255> error;
+};
+
+/**
+ * Latency probe of one listed server finished.
+ */
+struct ServerProbeEvent {
+    InlineString<255> host;
+    int port = 0;
+    int rtt_ms = -1;
+    int handshake_ms = -1;
+    InlineString<127> error;
 };
 
 /**
@@ -64,11 +67,11 @@ struct ServerListEvent {
  * to support blocking wait in the Run thread callback.
  */
 using UiEvent = std::variant<
-    ChatMessageEvent,
     StatusChangedEvent,
     UserInfoChangedEvent,
     TopicChangedEvent,
-    ServerListEvent
+    ServerListEvent,
+    ServerProbeEvent
 >;
 
 } // namespace jamwide
@@ -19,6 +19,11 @@ struct ServerListEntry {
     int bpm = 0;             // parsed BPM (0 for lobby)
     int bpi = 0;             // parsed BPI (0 for lobby)
     bool is_lobby = false;   // lobby flag
+    // Filled in by latency probes after the list arrives
+    bool probed = false;
+    int rtt_ms = -1;         // TCP round trip, -1 if unknown
+    int handshake_ms = -1;   // connect to auth challenge, -1 if unknown
+    std::string probe_error;
 };
 
 #endif // SERVER_LIST_TYPES_H
@@ -6,6 +6,7 @@
 #include "ui_chat.h"
 #include "plugin/jamwide_plugin.h"
 #include "threading/ui_command.h"
+#include "threading/run_thread.h"
 #include "core/njclient.h"
 #include "imgui.h"
 
@@ -86,23 +87,30 @@ bool parse_chat_input(const char* input, jamwide::SendChatCommand& cmd) {
 }
 
 std::string format_line(const ChatMessage& message) {
-    const std::string prefix = message.timestamp.empty()
-        ? ""
-        : (message.timestamp + " ");
+    std::string line;
+    if (!message.timestamp.empty()) {
+        line.append(message.timestamp.view()).append(" ");
+    }
     switch (message.type) {
         case ChatMessageType::Action:
-            return prefix + "* " + message.sender + " " + message.content;
+            line.append("* ").append(message.sender.view()).append(" ");
+            break;
         case ChatMessageType::Join:
         case ChatMessageType::Part:
         case ChatMessageType::Topic:
         case ChatMessageType::System:
-            return prefix + "*** " + message.content;
+            line.append("*** ");
+            break;
         case ChatMessageType::PrivateMessage:
-            return prefix + "[PM from " + message.sender + "] " + message.content;
+            line.append("[PM from ").append(message.sender.view()).append("] ");
+            break;
         case ChatMessageType::Message:
         default:
-            return prefix + "<" + message.sender + "> " + message.content;
+            line.append("<").append(message.sender.view()).append("> ");
+            break;
     }
+    line.append(message.content.view());
+    return line;
 }
 
 std::string make_timestamp() {
@@ -199,7 +207,7 @@ void ui_render_chat(jamwide::JamWidePlugin* plugin) {
         } else {
             jamwide::SendChatCommand cmd;
             if (parse_chat_input(state.chat_input, cmd)) {
-                plugin->cmd_queue.try_push(std::move(cmd));
+                jamwide::run_thread_post(plugin, std::move(cmd));
             } else {
                 ChatMessage msg;
                 msg.type = ChatMessageType::System;
@@ -5,6 +5,7 @@
 
 #include "ui_connection.h"
 #include "threading/ui_command.h"
+#include "threading/run_thread.h"
 #include "plugin/jamwide_plugin.h"
 #include "core/njclient.h"
 #include "imgui.h"
@@ -40,7 +41,8 @@ void ui_render_connection_panel(jamwide::JamWidePlugin* plugin) {
 
     const bool is_connected =
         (state.status == NJClient::NJC_STATUS_OK ||
-         state.status == NJClient::NJC_STATUS_PRECONNECT);
+         state.status == NJClient::NJC_STATUS_PRECONNECT ||
+         state.status == NJClient::NJC_STATUS_RECONNECTING);
 
     // Show current status for debugging
     ImGui::TextDisabled("Status: %d", state.status);
@@ -54,7 +56,7 @@ void ui_render_connection_panel(jamwide::JamWidePlugin* plugin) {
             cmd.server = state.server_input;
             cmd.username = state.username_input;
             cmd.password = state.password_input;
-            if (!plugin->cmd_queue.try_push(std::move(cmd))) {
+            if (!jamwide::run_thread_post(plugin, std::move(cmd))) {
                 state.connection_error = "Connect request queue full";
             } else {
                 state.connection_error.clear();
@@ -63,7 +65,7 @@ void ui_render_connection_panel(jamwide::JamWidePlugin* plugin) {
     } else {
         if (ImGui::Button("Disconnect")) {
             jamwide::DisconnectCommand cmd;
-            if (!plugin->cmd_queue.try_push(std::move(cmd))) {
+            if (!jamwide::run_thread_post(plugin, std::move(cmd))) {
                 state.connection_error = "Disconnect request queue full";
             }
         }
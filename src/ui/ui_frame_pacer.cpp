@@ -0,0 +1,119 @@
+/*
+    JamWide Plugin - ui_frame_pacer.cpp
+    Adaptive frame pacing and UI thread CPU accounting
+
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#include "ui_frame_pacer.h"
+#include "plugin/jamwide_plugin.h"
+#include "debug/logging.h"
+#include "imgui.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace jamwide;
+
+namespace {
+
+// CPU time consumed by the calling thread, in seconds
+double thread_cpu_seconds() {
+#ifdef _WIN32
+    FILETIME creation, exit_time, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit_time, &kernel, &user)) {
+        return 0.0;
+    }
+    auto to_100ns = [](const FILETIME& ft) {
+        return (static_cast<unsigned long long>(ft.dwHighDateTime) << 32) |
+               ft.dwLowDateTime;
+    };
+    return static_cast<double>(to_100ns(kernel) + to_100ns(user)) * 1e-7;
+#else
+    timespec ts{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0.0;
+    }
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+#endif
+}
+
+} // namespace
+
+bool UiFramePacer::should_render(JamWidePlugin* plugin) {
+    const auto now = Clock::now();
+
+    // Anything the next frame would show differently wakes it up right away
+    bool wake = input_pending_;
+    input_pending_ = false;
+
+    const unsigned int changes =
+        plugin->ui_snapshot.changes.load(std::memory_order_relaxed);
+    if (changes != last_changes_) {
+        last_changes_ = changes;
+        wake = true;
+    }
+    if (!plugin->ui_queue.empty() || !plugin->chat_queue.empty() ||
+        plugin->remote_snapshot.has_update() ||
+        plugin->license_pending.load(std::memory_order_relaxed)) {
+        wake = true;
+    }
+
+    // Moving meters keep the full rate without needing a wake per block
+    const unsigned int motion = plugin->meters.motion.load(std::memory_order_relaxed);
+    if (motion != last_motion_) {
+        last_motion_ = motion;
+        wake = true;
+    }
+
+    if (wake) {
+        active_until_ = now + std::chrono::milliseconds(kActiveHoldMs);
+    }
+    if (!wake && now >= active_until_ &&
+        now - last_frame_ < std::chrono::milliseconds(kIdleIntervalMs)) {
+        return false;
+    }
+
+    last_frame_ = now;
+    return true;
+}
+
+void UiFramePacer::begin_frame() {
+    frame_cpu_start_ = thread_cpu_seconds();
+}
+
+void UiFramePacer::end_frame(JamWidePlugin* plugin) {
+    const auto now = Clock::now();
+    cpu_seconds_ += thread_cpu_seconds() - frame_cpu_start_;
+    ++frames_;
+
+    // Dragging a slider or holding a button keeps the full rate even when the
+    // mouse is still
+    if (ImGui::IsAnyItemActive()) {
+        active_until_ = now + std::chrono::milliseconds(kActiveHoldMs);
+    }
+
+    if (stats_start_ == Clock::time_point{}) {
+        stats_start_ = now;
+        return;
+    }
+    const double window =
+        std::chrono::duration<double>(now - stats_start_).count();
+    if (window < 1.0) {
+        return;
+    }
+
+    plugin->ui_state.ui_fps = static_cast<float>(frames_ / window);
+    plugin->ui_state.ui_cpu_ms_per_sec =
+        static_cast<float>(cpu_seconds_ * 1000.0 / window);
+    NLOG_VERBOSE("[UI] %.1f fps, %.2f ms CPU/s\n",
+                 plugin->ui_state.ui_fps, plugin->ui_state.ui_cpu_ms_per_sec);
+
+    stats_start_ = now;
+    cpu_seconds_ = 0.0;
+    frames_ = 0;
+}
@@ -0,0 +1,57 @@
+/*
+    JamWide Plugin - ui_frame_pacer.h
+    Decides which platform timer ticks actually render a frame
+
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#ifndef UI_FRAME_PACER_H
+#define UI_FRAME_PACER_H
+
+#include <chrono>
+
+namespace jamwide {
+struct JamWidePlugin;
+}
+
+/**
+ * Adaptive frame pacing for the editor.
+ *
+ * The platform layer keeps ticking at display rate and asks should_render()
+ * on every tick. Frames run at full rate while the user interacts, meters
+ * move or events arrive, and fall back to kIdleIntervalMs once nothing has
+ * changed for kActiveHoldMs. All methods are UI thread only.
+ */
+class UiFramePacer {
+public:
+    static constexpr int kIdleIntervalMs = 200;   // 5 fps when nothing changes
+    static constexpr int kActiveHoldMs = 500;     // full rate after the last change
+
+    /** Platform input (mouse, key, focus, resize) arrived; render promptly. */
+    void note_input() { input_pending_ = true; }
+
+    /** Called on every platform tick; true if this tick should build a frame. */
+    bool should_render(jamwide::JamWidePlugin* plugin);
+
+    /** Bracket the frame (NewFrame through Present) to measure UI thread CPU. */
+    void begin_frame();
+    void end_frame(jamwide::JamWidePlugin* plugin);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    bool input_pending_ = false;
+    unsigned int last_changes_ = 0;
+    unsigned int last_motion_ = 0;
+    Clock::time_point last_frame_{};
+    Clock::time_point active_until_{};
+
+    // Stats over the current one-second window
+    Clock::time_point stats_start_{};
+    double frame_cpu_start_ = 0.0;
+    double cpu_seconds_ = 0.0;
+    int frames_ = 0;
+};
+
+#endif // UI_FRAME_PACER_H
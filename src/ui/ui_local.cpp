@@ -8,6 +8,7 @@
 #include "ui_latency_guide.h"
 #include "ui_util.h"
 #include "threading/ui_command.h"
+#include "threading/run_thread.h"
 #include "plugin/jamwide_plugin.h"
 #include "core/njclient.h"
 #include "imgui.h"
@@ -49,7 +50,7 @@ void ui_render_local_channel(jamwide::JamWidePlugin* plugin) {
             jamwide::SetLocalChannelInfoCommand cmd;
             cmd.channel = 0;
             cmd.name = state.local_name_input;
-            plugin->cmd_queue.try_push(std::move(cmd));
+            jamwide::run_thread_post(plugin, std::move(cmd));
         }
     }
 
@@ -67,7 +68,7 @@ void ui_render_local_channel(jamwide::JamWidePlugin* plugin) {
             cmd.name = state.local_name_input;
             cmd.set_bitrate = true;
             cmd.bitrate = bitrate;
-            plugin->cmd_queue.try_push(std::move(cmd));
+            jamwide::run_thread_post(plugin, std::move(cmd));
         }
     }
 
@@ -80,7 +81,7 @@ void ui_render_local_channel(jamwide::JamWidePlugin* plugin) {
             cmd.name = state.local_name_input;
             cmd.set_transmit = true;
             cmd.transmit = state.local_transmit;
-            plugin->cmd_queue.try_push(std::move(cmd));
+            jamwide::run_thread_post(plugin, std::move(cmd));
         }
     }
 
@@ -93,7 +94,7 @@ void ui_render_local_channel(jamwide::JamWidePlugin* plugin) {
             cmd.channel = 0;
             cmd.set_volume = true;
             cmd.volume = state.local_volume;
-            plugin->cmd_queue.try_push(std::move(cmd));
+            jamwide::run_thread_post(plugin, std::move(cmd));
         }
     }
 
@@ -107,7 +108,7 @@ void ui_render_local_channel(jamwide::JamWidePlugin* plugin) {
             cmd.channel = 0;
             cmd.set_pan = true;
             cmd.pan = state.local_pan;
-            plugin->cmd_queue.try_push(std::move(cmd));
+            jamwide::run_thread_post(plugin, std::move(cmd));
         }
     }
 
@@ -119,7 +120,7 @@ void ui_render_local_channel(jamwide::JamWidePlugin* plugin) {
             cmd.channel = 0;
             cmd.set_mute = true;
             cmd.mute = state.local_mute;
-            plugin->cmd_queue.try_push(std::move(cmd));
+            jamwide::run_thread_post(plugin, std::move(cmd));
         }
     }
 
@@ -131,18 +132,15 @@ void ui_render_local_channel(jamwide::JamWidePlugin* plugin) {
             cmd.channel = 0;
             cmd.set_solo = true;
             cmd.solo = state.local_solo;
-            plugin->cmd_queue.try_push(std::move(cmd));
+            jamwide::run_thread_post(plugin, std::move(cmd));
         }
         ui_update_solo_state(plugin);
     }
 
     ImGui::SameLine();
 
-    float vu_left = plugin->ui_snapshot.local_vu_left.load(
-        std::memory_order_relaxed);
-    float vu_right = plugin->ui_snapshot.local_vu_right.load(
-        std::memory_order_relaxed);
-    render_vu_meter("##local_vu", vu_left, vu_right);
+    render_vu_meter("##local_vu",
+                    plugin->meters.Get(NJMeterBank::Local(0)));
 
     if (state.status == NJClient::NJC_STATUS_OK) {
         ImGui::Spacing();
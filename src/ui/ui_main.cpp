@@ -16,6 +16,7 @@
 #include "ui_master.h"
 #include "ui_remote.h"
 #include "ui_server_browser.h"
+#include "ui_network.h"
 #include "debug/logging.h"
 #include "imgui.h"
 #include <chrono>
@@ -46,9 +47,12 @@ void ui_render_frame(JamWidePlugin* plugin) {
             if constexpr (std::is_same_v<T, StatusChangedEvent>) {
                 const int prev_status = plugin->ui_state.status;
                 plugin->ui_state.status = e.status;
-                plugin->ui_state.connection_error = e.error_msg;
-                if (prev_status == NJClient::NJC_STATUS_OK &&
-                    e.status != NJClient::NJC_STATUS_OK) {
+                plugin->ui_state.connection_error = e.error_msg.str();
+                // A reconnect keeps the session, so only clear once it is really over
+                if ((prev_status == NJClient::NJC_STATUS_OK ||
+                     prev_status == NJClient::NJC_STATUS_RECONNECTING) &&
+                    e.status != NJClient::NJC_STATUS_OK &&
+                    e.status != NJClient::NJC_STATUS_RECONNECTING) {
                     plugin->ui_state.latency_history.fill(0.0f);
                     plugin->ui_state.latency_history_index = 0;
                     plugin->ui_state.latency_history_count = 0;
@@ -62,17 +66,28 @@ void ui_render_frame(JamWidePlugin* plugin) {
                 plugin->ui_state.users_dirty = true;
             }
             else if constexpr (std::is_same_v<T, TopicChangedEvent>) {
-                plugin->ui_state.server_topic = e.topic;
-            }
-            else if constexpr (std::is_same_v<T, ChatMessageEvent>) {
-                // ChatMessageEvent ignored (no chat in MVP)
-                (void)e;
+                plugin->ui_state.server_topic = e.topic.str();
             }
             else if constexpr (std::is_same_v<T, ServerListEvent>) {
-                plugin->ui_state.server_list = std::move(e.servers);
-                plugin->ui_state.server_list_error = e.error;
+                // Hand the old list back for the Run thread to reuse
+                if (plugin->server_list_buffer.update()) {
+                    plugin->ui_state.server_list.swap(
+                        plugin->server_list_buffer.read_buffer());
+                }
+                plugin->ui_state.server_list_error = e.error.str();
                 plugin->ui_state.server_list_loading = false;
             }
+            else if constexpr (std::is_same_v<T, ServerProbeEvent>) {
+                for (auto& entry : plugin->ui_state.server_list) {
+                    if (e.host == entry.host &&
+                        (entry.port == e.port || entry.port <= 0)) {
+                        entry.probed = true;
+                        entry.rtt_ms = e.rtt_ms;
+                        entry.handshake_ms = e.handshake_ms;
+                        entry.probe_error = e.error.str();
+                    }
+                }
+            }
         }, std::move(event));
     });
 
@@ -108,6 +123,11 @@ void ui_render_frame(JamWidePlugin* plugin) {
         plugin->ui_state.chat_scroll_to_bottom = true;
     });
 
+    // Pick up the newest remote mixer snapshot here rather than in the Remote
+    // Users panel, so it is consumed even while that panel is collapsed and the
+    // frame pacer doesn't keep seeing it as pending.
+    plugin->remote_snapshot.update();
+
     // Check for license prompt (dedicated slot)
     if (plugin->license_pending.load(std::memory_order_acquire)) {
         plugin->ui_state.show_license_dialog = true;
@@ -181,6 +201,8 @@ void ui_render_frame(JamWidePlugin* plugin) {
     ui_render_local_channel(plugin);
     ImGui::Separator();
     ui_render_remote_channels(plugin);
+    ImGui::Separator();
+    ui_render_network_panel(plugin);
 
     ImGui::End();
 
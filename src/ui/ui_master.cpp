@@ -33,11 +33,7 @@ void ui_render_master_panel(jamwide::JamWidePlugin* plugin) {
 
     ImGui::SameLine();
 
-    float master_vu_l = plugin->ui_snapshot.master_vu_left.load(
-        std::memory_order_relaxed);
-    float master_vu_r = plugin->ui_snapshot.master_vu_right.load(
-        std::memory_order_relaxed);
-    render_vu_meter("##master_vu", master_vu_l, master_vu_r);
+    render_vu_meter("##master_vu", plugin->meters.Get(NJMeterBank::MASTER));
 
     ImGui::Spacing();
 
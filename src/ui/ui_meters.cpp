@@ -4,6 +4,7 @@
 */
 
 #include "ui_meters.h"
+#include "core/njclient.h"
 
 #include <algorithm>
 
@@ -25,12 +26,14 @@ ImVec4 vu_color(float value) {
     return ImVec4(0.9f, 0.2f, 0.2f, 1.0f);
 }
 
+const ImVec2 kMeterSize(70.0f, 6.0f);
+
 } // namespace
 
 void render_vu_meter(const char* label, float left, float right) {
     const float level_left = clamp01(left);
     const float level_right = clamp01(right);
-    const ImVec2 size(70.0f, 6.0f);
+    const ImVec2 size = kMeterSize;
 
     ImGui::PushID(label ? label : "##vu_meter");
     ImGui::BeginGroup();
@@ -46,3 +49,41 @@ void render_vu_meter(const char* label, float left, float right) {
     ImGui::EndGroup();
     ImGui::PopID();
 }
+
+void render_vu_meter(const char* label, const NJMeter* meter) {
+    float peak[2] = {0.0f, 0.0f};
+    float rms[2] = {0.0f, 0.0f};
+    int clip = 0;
+    if (meter) {
+        for (int side = 0; side < 2; ++side) {
+            peak[side] = meter->peak[side].load(std::memory_order_relaxed);
+            rms[side] = meter->rms[side].load(std::memory_order_relaxed);
+        }
+        clip = meter->clip.load(std::memory_order_relaxed);
+    }
+
+    ImGui::PushID(label ? label : "##vu_meter");
+    ImGui::BeginGroup();
+
+    auto* draw_list = ImGui::GetWindowDrawList();
+    const ImU32 rms_col = ImGui::GetColorU32(ImVec4(1.0f, 1.0f, 1.0f, 0.8f));
+    for (int side = 0; side < 2; ++side) {
+        const float level = clamp01(peak[side]);
+        const bool clipped = (clip & (side ? NJMeter::CLIP_R : NJMeter::CLIP_L)) != 0;
+
+        ImGui::PushStyleColor(ImGuiCol_PlotHistogram,
+                              clipped ? ImVec4(0.9f, 0.2f, 0.2f, 1.0f) : vu_color(level));
+        ImGui::ProgressBar(level, kMeterSize, "");
+        ImGui::PopStyleColor();
+
+        if (rms[side] > 0.0f) {
+            const ImVec2 min = ImGui::GetItemRectMin();
+            const ImVec2 max = ImGui::GetItemRectMax();
+            const float x = min.x + (max.x - min.x) * clamp01(rms[side]);
+            draw_list->AddLine(ImVec2(x, min.y), ImVec2(x, max.y), rms_col, 1.0f);
+        }
+    }
+
+    ImGui::EndGroup();
+    ImGui::PopID();
+}
@@ -8,7 +8,13 @@
 
 #include "imgui.h"
 
+struct NJMeter;
+
 // Render a stereo VU meter (left/right stacked).
 void render_vu_meter(const char* label, float left, float right);
 
+// Render a meter from the realtime meter bank: peak bars with an RMS tick,
+// red while the channel has clipped recently. Null draws an idle meter.
+void render_vu_meter(const char* label, const NJMeter* meter);
+
 #endif // UI_METERS_H
@@ -0,0 +1,203 @@
+/*
+    JamWide Plugin - ui_network.cpp
+    Per-peer network arrival statistics panel
+*/
+
+#include "ui_network.h"
+#include "plugin/jamwide_plugin.h"
+#include "core/njclient.h"
+#include "imgui.h"
+#include <cfloat>
+#include <string>
+
+namespace {
+
+void render_histogram(const char* title, const int* bins) {
+    float values[NJClient::PEER_STATS_HIST_BINS];
+    int total = 0;
+    for (int i = 0; i < NJClient::PEER_STATS_HIST_BINS; ++i) {
+        values[i] = static_cast<float>(bins[i]);
+        total += bins[i];
+    }
+
+    ImGui::Text("%s (%d)", title, total);
+    if (total == 0) {
+        return;
+    }
+    ImGui::PlotHistogram("##hist", values, NJClient::PEER_STATS_HIST_BINS,
+                         0, nullptr, 0.0f, FLT_MAX, ImVec2(240.0f, 40.0f));
+
+    // Bin edges underneath, e.g. "<50 <100 ... 4000+"
+    for (int i = 0; i < NJClient::PEER_STATS_HIST_BINS; ++i) {
+        const int edge = NJClient::peer_stats_hist_ms[i];
+        if (i > 0) {
+            ImGui::SameLine();
+        }
+        if (edge > 0) {
+            ImGui::TextDisabled("<%d", edge);
+        } else {
+            ImGui::TextDisabled("%d+", NJClient::peer_stats_hist_ms[i - 1]);
+        }
+    }
+}
+
+} // namespace
+
+void ui_render_network_panel(jamwide::JamWidePlugin* plugin) {
+    if (!plugin) return;
+
+    if (!ImGui::CollapsingHeader("Network")) {
+        return;
+    }
+
+    ImGui::Indent();
+
+    // Queues refuse rather than block when full; show if that has happened
+    const std::size_t events_dropped = plugin->ui_queue.dropped();
+    const std::size_t chat_dropped = plugin->chat_queue.dropped();
+    const std::size_t commands_dropped = plugin->cmd_queue.dropped();
+    if (events_dropped || chat_dropped || commands_dropped) {
+        ImGui::TextColored(ImVec4(0.9f, 0.7f, 0.2f, 1.0f),
+                           "Queue drops: %zu events, %zu chat, %zu commands",
+                           events_dropped, chat_dropped, commands_dropped);
+    }
+
+    ImGui::TextDisabled("UI: %.0f fps, %.1f ms CPU/s",
+                        plugin->ui_state.ui_fps, plugin->ui_state.ui_cpu_ms_per_sec);
+
+    // client is only created (first connect) and destroyed (deactivate) on
+    // this (main) thread. The upload and health getters take m_upload_cs and
+    // m_health_cs, which the Run thread holds only while updating them; the
+    // per-peer stats are seqlocked.
+    NJClient* client = plugin->client.get();
+    if (!client || plugin->ui_state.status != NJClient::NJC_STATUS_OK) {
+        ImGui::TextDisabled("Not connected");
+        ImGui::Unindent();
+        return;
+    }
+
+    NJClient::UploadRateStats upload{};
+    client->GetUploadRateStats(&upload);
+    ImGui::Text("Upload: %d%% of channel bitrate, backlog %.1f KB, %d kbps sent / %d kbps encoded",
+                upload.scale_pct, upload.backlog_bytes / 1024.0,
+                upload.drain_kbps, upload.produce_kbps);
+    if (ImGui::IsItemHovered() && upload.decisions > 0) {
+        ImGui::SetTooltip("%d steps down, %d steps up over %d intervals",
+                          upload.steps_down, upload.steps_up, upload.decisions);
+    }
+
+    Net_Connection::Health health;
+    if (client->GetConnectionHealth(&health)) {
+        if (health.rtt_ms >= 0.0) {
+            ImGui::Text("Server: RTT %.1f ms (min %.1f), jitter %.1f ms, stalls %d recv / %d send",
+                        health.rtt_ms, health.rtt_min_ms, health.jitter_ms,
+                        health.recv_stalls, health.send_stalls);
+        } else {
+            ImGui::Text("Server: RTT not measured yet, stalls %d recv / %d send",
+                        health.recv_stalls, health.send_stalls);
+        }
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("RTT from %s\nLongest silence from server: %d ms\nTCP retransmits: %s",
+                              health.rtt_source == Net_Connection::RTT_TCPINFO ? "TCP stack" : "login handshake",
+                              health.max_recv_gap_ms,
+                              health.tcp_retransmits >= 0 ? std::to_string(health.tcp_retransmits).c_str() : "n/a");
+        }
+    }
+    ImGui::Spacing();
+
+    NJClient::PeerArrivalStats stats[NJClient::PEER_STATS_MAX];
+    const int count = client->GetPeerArrivalStats(stats, NJClient::PEER_STATS_MAX);
+    if (count <= 0) {
+        ImGui::TextDisabled("No remote users connected");
+        ImGui::Unindent();
+        return;
+    }
+
+    if (ImGui::BeginTable("PeerArrivalTable", 8,
+                          ImGuiTableFlags_RowBg |
+                          ImGuiTableFlags_BordersInnerH |
+                          ImGuiTableFlags_Resizable)) {
+        ImGui::TableSetupColumn("User");
+        ImGui::TableSetupColumn("Intervals");
+        ImGui::TableSetupColumn("Late");
+        ImGui::TableSetupColumn("Dropped");
+        ImGui::TableSetupColumn("Slack ms (last/min)");
+        ImGui::TableSetupColumn("First byte ms");
+        ImGui::TableSetupColumn("kbps");
+        ImGui::TableSetupColumn("Prebuffer");
+        ImGui::TableHeadersRow();
+
+        for (int i = 0; i < count; ++i) {
+            const NJClient::PeerArrivalStats& st = stats[i];
+            const int timed = st.late + [&st] {
+                int n = 0;
+                for (int b = 0; b < NJClient::PEER_STATS_HIST_BINS; ++b) {
+                    n += st.slack_hist[b];
+                }
+                return n;
+            }();
+
+            ImGui::TableNextRow();
+            ImGui::PushID(i);
+
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted(st.name);
+            if (ImGui::IsItemHovered() && timed > 0) {
+                ImGui::BeginTooltip();
+                render_histogram("Slack (ms)", st.slack_hist);
+                ImGui::Separator();
+                render_histogram("Lateness (ms)", st.late_hist);
+                ImGui::EndTooltip();
+            }
+
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%d", st.intervals);
+
+            ImGui::TableSetColumnIndex(2);
+            if (st.late > 0) {
+                ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%d", st.late);
+            } else {
+                ImGui::Text("0");
+            }
+
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("%d", st.dropped);
+
+            ImGui::TableSetColumnIndex(4);
+            if (timed > 0) {
+                ImGui::Text("%.0f / %.0f", st.last_slack_ms, st.min_slack_ms);
+            } else {
+                ImGui::TextDisabled("-");
+            }
+
+            ImGui::TableSetColumnIndex(5);
+            if (st.intervals > 0) {
+                ImGui::Text("%.0f", st.avg_first_byte_ms);
+            } else {
+                ImGui::TextDisabled("-");
+            }
+
+            ImGui::TableSetColumnIndex(6);
+            if (st.kbps > 0.0) {
+                ImGui::Text("%.0f", st.kbps);
+            } else {
+                ImGui::TextDisabled("-");
+            }
+
+            ImGui::TableSetColumnIndex(7);
+            if (st.prebuffer > 0) {
+                ImGui::Text("%.1f KB", st.prebuffer / 1024.0);
+            } else {
+                ImGui::TextDisabled("default");
+            }
+
+            ImGui::PopID();
+        }
+
+        ImGui::EndTable();
+    }
+
+    ImGui::TextDisabled("Hover a user for slack/lateness histograms");
+
+    ImGui::Unindent();
+}
@@ -0,0 +1,15 @@
+/*
+    JamWide Plugin - ui_network.h
+    Per-peer network arrival statistics panel
+*/
+
+#ifndef UI_NETWORK_H
+#define UI_NETWORK_H
+
+namespace jamwide {
+struct JamWidePlugin;
+}
+
+void ui_render_network_panel(jamwide::JamWidePlugin* plugin);
+
+#endif // UI_NETWORK_H
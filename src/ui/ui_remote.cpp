@@ -7,6 +7,7 @@
 #include "ui_meters.h"
 #include "ui_util.h"
 #include "threading/ui_command.h"
+#include "threading/run_thread.h"
 #include "plugin/jamwide_plugin.h"
 #include "core/njclient.h"
 #include "imgui.h"
@@ -28,30 +29,22 @@ void ui_render_remote_channels(jamwide::JamWidePlugin* plugin) {
         return;
     }
 
-    bool solo_changed = false;
-
-    {
-    std::unique_lock<std::mutex> client_lock(plugin->client_mutex);
-    NJClient* client = plugin->client.get();
-    if (!client) {
-        ImGui::TextDisabled("Not connected");
-        ImGui::Unindent();
-        return;
-    }
-
-    const int num_users = client->GetNumUsers();
-    if (num_users <= 0) {
+    // Drawn from the Run thread's latest snapshot (picked up once per frame in
+    // ui_render_frame), without client_mutex. Edits are applied to the snapshot
+    // copy right away so the widgets don't snap back before the Run thread
+    // publishes them.
+    auto& mixer = plugin->remote_snapshot.read_buffer().mixer;
+    if (mixer.num_users <= 0) {
         ImGui::TextDisabled("No remote users connected");
         ImGui::Unindent();
         return;
     }
 
-    for (int u = 0; u < num_users; ++u) {
-        float user_vol = 0.0f;
-        float user_pan = 0.0f;
-        bool user_mute = false;
-        const char* user_name = client->GetUserState(u, &user_vol, &user_pan, &user_mute);
-        const char* label = (user_name && *user_name) ? user_name : "User";
+    bool solo_changed = false;
+
+    for (int u = 0; u < mixer.num_users; ++u) {
+        const char* user_name = mixer.UserName(u);
+        const char* label = user_name[0] ? user_name : "User";
 
         ImGui::PushID(u);
 
@@ -59,47 +52,39 @@ void ui_render_remote_channels(jamwide::JamWidePlugin* plugin) {
             label, ImGuiTreeNodeFlags_DefaultOpen);
 
         ImGui::SameLine();
+        bool user_mute = mixer.user_mute[u] != 0;
         if (ImGui::Checkbox("M##user", &user_mute)) {
+            mixer.user_mute[u] = user_mute;
+            mixer.local_edits = true;
             jamwide::SetUserStateCommand cmd;
             cmd.user_index = u;
+            cmd.user_name = user_name;
             cmd.set_mute = true;
             cmd.mute = user_mute;
-            plugin->cmd_queue.try_push(std::move(cmd));
+            jamwide::run_thread_post(plugin, std::move(cmd));
         }
 
         if (user_open) {
             ImGui::Indent();
 
-            for (int c = 0; ; ++c) {
-                const int channel_index = client->EnumUserChannels(u, c);
-                if (channel_index < 0) {
-                    break;
-                }
-
-                bool subscribed = false;
-                float volume = 1.0f;
-                float pan = 0.0f;
-                bool mute = false;
-                bool solo = false;
-                int out_channel = 0;
-                int flags = 0;
-                const char* channel_name = client->GetUserChannelState(
-                    u, channel_index, &subscribed, &volume, &pan,
-                    &mute, &solo, &out_channel, &flags);
-                if (!channel_name) {
-                    continue;
-                }
-
-                const char* channel_label = (*channel_name) ? channel_name : "Channel";
+            const int first = mixer.user_chan_first[u];
+            const int last = first + mixer.user_chan_count[u];
+            for (int c = first; c < last; ++c) {
+                const int channel_index = mixer.chan_index[c];
+                const char* channel_name = mixer.ChanName(c);
+                const char* channel_label = channel_name[0] ? channel_name : "Channel";
                 ImGui::PushID(channel_index);
 
+                jamwide::SetUserChannelStateCommand cmd;
+                cmd.user_index = u;
+                cmd.user_name = user_name;
+                cmd.channel_index = channel_index;
+
+                bool subscribed = mixer.chan_sub[c] != 0;
                 if (ImGui::Checkbox("##sub", &subscribed)) {
-                    jamwide::SetUserChannelStateCommand cmd;
-                    cmd.user_index = u;
-                    cmd.channel_index = channel_index;
+                    mixer.chan_sub[c] = subscribed;
                     cmd.set_sub = true;
                     cmd.subscribed = subscribed;
-                    plugin->cmd_queue.try_push(std::move(cmd));
                 }
 
                 ImGui::SameLine();
@@ -107,53 +92,46 @@ void ui_render_remote_channels(jamwide::JamWidePlugin* plugin) {
 
                 ImGui::SameLine();
                 ImGui::SetNextItemWidth(120.0f);
-                if (ImGui::SliderFloat("##vol", &volume,
+                if (ImGui::SliderFloat("##vol", &mixer.chan_volume[c],
                                        0.0f, 2.0f, "%.2f")) {
-                    jamwide::SetUserChannelStateCommand cmd;
-                    cmd.user_index = u;
-                    cmd.channel_index = channel_index;
                     cmd.set_vol = true;
-                    cmd.volume = volume;
-                    plugin->cmd_queue.try_push(std::move(cmd));
+                    cmd.volume = mixer.chan_volume[c];
                 }
 
                 ImGui::SameLine();
                 ImGui::SetNextItemWidth(80.0f);
-                if (ImGui::SliderFloat("##pan", &pan,
+                if (ImGui::SliderFloat("##pan", &mixer.chan_pan[c],
                                        -1.0f, 1.0f, "%.2f")) {
-                    jamwide::SetUserChannelStateCommand cmd;
-                    cmd.user_index = u;
-                    cmd.channel_index = channel_index;
                     cmd.set_pan = true;
-                    cmd.pan = pan;
-                    plugin->cmd_queue.try_push(std::move(cmd));
+                    cmd.pan = mixer.chan_pan[c];
                 }
 
                 ImGui::SameLine();
+                bool mute = mixer.chan_mute[c] != 0;
                 if (ImGui::Checkbox("M##chan_mute", &mute)) {
-                    jamwide::SetUserChannelStateCommand cmd;
-                    cmd.user_index = u;
-                    cmd.channel_index = channel_index;
+                    mixer.chan_mute[c] = mute;
                     cmd.set_mute = true;
                     cmd.mute = mute;
-                    plugin->cmd_queue.try_push(std::move(cmd));
                 }
 
                 ImGui::SameLine();
+                bool solo = mixer.chan_solo[c] != 0;
                 if (ImGui::Checkbox("S##chan_solo", &solo)) {
-                    jamwide::SetUserChannelStateCommand cmd;
-                    cmd.user_index = u;
-                    cmd.channel_index = channel_index;
+                    mixer.chan_solo[c] = solo;
                     cmd.set_solo = true;
                     cmd.solo = solo;
-                    plugin->cmd_queue.try_push(std::move(cmd));
                     solo_changed = true;
                 }
 
+                if (cmd.set_sub || cmd.set_vol || cmd.set_pan ||
+                    cmd.set_mute || cmd.set_solo) {
+                    mixer.local_edits = true;
+                    jamwide::run_thread_post(plugin, std::move(cmd));
+                }
+
                 ImGui::SameLine();
-                const float vu_left = client->GetUserChannelPeak(u, channel_index, 0);
-                const float vu_right = client->GetUserChannelPeak(u, channel_index, 1);
-                render_vu_meter("##chan_vu", vu_left, vu_right);
+                render_vu_meter("##chan_vu", plugin->meters.Get(
+                    NJMeterBank::Remote(mixer.user_meter_slot[u], channel_index)));
 
                 ImGui::PopID();
             }
@@ -165,8 +143,6 @@ void ui_render_remote_channels(jamwide::JamWidePlugin* plugin) {
         ImGui::PopID();
     }
 
-    } // Release client_mutex before updating solo state
-
     if (solo_changed) {
         ui_update_solo_state(plugin);
     }
@@ -5,13 +5,72 @@
 
 #include "ui_server_browser.h"
 #include "threading/ui_command.h"
+#include "threading/run_thread.h"
 #include "plugin/jamwide_plugin.h"
+#include "core/njclient.h"
+#include "net/dns_cache.h"
 #include "imgui.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <vector>
 
 namespace {
 
+enum ServerColumn {
+    kColServer = 0,
+    kColLatency,
+    kColTempo,
+    kColUsers,
+    kColWho,
+    kColAction,
+    kColCount
+};
+
+// Unprobed and failed servers (unreachable, or answering but not as a
+// NINJAM server) sort after every measured one
+int sort_latency(const ServerListEntry& entry) {
+    return entry.rtt_ms >= 0 && entry.probe_error.empty() ? entry.rtt_ms : 1 << 30;
+}
+
+// Display order of state.server_list under the table's current sort
+void sort_server_order(const std::vector<ServerListEntry>& servers,
+                       const ImGuiTableSortSpecs* specs,
+                       std::vector<int>& order) {
+    order.resize(servers.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = static_cast<int>(i);
+    }
+    if (!specs || specs->SpecsCount < 1) {
+        return;
+    }
+    const int column = specs->Specs[0].ColumnIndex;
+    const bool descending =
+        specs->Specs[0].SortDirection == ImGuiSortDirection_Descending;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        const ServerListEntry& ea = servers[static_cast<size_t>(a)];
+        const ServerListEntry& eb = servers[static_cast<size_t>(b)];
+        int cmp = 0;
+        if (column == kColLatency) {
+            cmp = sort_latency(ea) - sort_latency(eb);
+            if (cmp != 0) {
+                // Keep unmeasured servers last in either direction
+                if (sort_latency(ea) == (1 << 30) || sort_latency(eb) == (1 << 30)) {
+                    return cmp < 0;
+                }
+            }
+        } else if (column == kColUsers) {
+            cmp = ea.users - eb.users;
+        } else if (column == kColServer) {
+            cmp = ea.host.compare(eb.host);
+            if (cmp == 0) {
+                cmp = ea.port - eb.port;
+            }
+        }
+        return descending ? cmp > 0 : cmp < 0;
+    });
+}
+
 void format_server_address(const ServerListEntry& entry,
                            char* buffer,
                            size_t size) {
@@ -42,7 +101,7 @@ void ui_render_server_browser(jamwide::JamWidePlugin* plugin) {
     if (ImGui::Button("Refresh")) {
         jamwide::RequestServerListCommand cmd;
         cmd.url = state.server_list_url;
-        if (!plugin->cmd_queue.try_push(std::move(cmd))) {
+        if (!jamwide::run_thread_post(plugin, std::move(cmd))) {
             state.server_list_error = "Server list request queue full";
         } else {
             state.server_list_loading = true;
@@ -55,6 +114,13 @@ void ui_render_server_browser(jamwide::JamWidePlugin* plugin) {
         ImGui::TextDisabled("Loading...");
     }
 
+    ImGui::SameLine();
+    ImGui::Checkbox("Pre-connect on Use", &state.server_prewarm);
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Open the connection as soon as a server is picked,\n"
+                          "so Connect only has to log in");
+    }
+
     if (!state.server_list_error.empty()) {
         ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f),
                            "Error: %s", state.server_list_error.c_str());
@@ -66,29 +132,58 @@ void ui_render_server_browser(jamwide::JamWidePlugin* plugin) {
         return;
     }
 
-    if (ImGui::BeginTable("ServerListTable", 5,
+    if (ImGui::BeginTable("ServerListTable", kColCount,
                           ImGuiTableFlags_RowBg |
                           ImGuiTableFlags_BordersInnerH |
-                          ImGuiTableFlags_Resizable)) {
+                          ImGuiTableFlags_Resizable |
+                          ImGuiTableFlags_Sortable)) {
         ImGui::TableSetupColumn("Server");
-        ImGui::TableSetupColumn("Tempo");
-        ImGui::TableSetupColumn("Users");
-        ImGui::TableSetupColumn("Who's There");
-        ImGui::TableSetupColumn("##Action", ImGuiTableColumnFlags_WidthFixed, 40.0f);
+        ImGui::TableSetupColumn("Latency", ImGuiTableColumnFlags_PreferSortAscending);
+        ImGui::TableSetupColumn("Tempo", ImGuiTableColumnFlags_NoSort);
+        ImGui::TableSetupColumn("Users", ImGuiTableColumnFlags_PreferSortDescending);
+        ImGui::TableSetupColumn("Who's There", ImGuiTableColumnFlags_NoSort);
+        ImGui::TableSetupColumn("##Action",
+                                ImGuiTableColumnFlags_WidthFixed |
+                                ImGuiTableColumnFlags_NoSort, 40.0f);
         ImGui::TableHeadersRow();
 
-        int idx = 0;
-        for (const auto& entry : state.server_list) {
+        // Re-sorted every frame since probe results keep arriving
+        static std::vector<int> order;
+        sort_server_order(state.server_list, ImGui::TableGetSortSpecs(), order);
+
+        for (const int idx : order) {
+            const auto& entry = state.server_list[static_cast<size_t>(idx)];
             ImGui::TableNextRow();
 
             // Server name/address
-            ImGui::TableSetColumnIndex(0);
+            ImGui::TableSetColumnIndex(kColServer);
             char addr[256];
             format_server_address(entry, addr, sizeof(addr));
             ImGui::TextUnformatted(addr);
+            // Resolve ahead of a likely click; a no-op once cached
+            if (ImGui::IsItemHovered()) {
+                jamwide::DnsCache::instance().prefetch(entry.host);
+            }
+
+            // Latency: TCP round trip, handshake in the tooltip
+            ImGui::TableSetColumnIndex(kColLatency);
+            if (!entry.probed) {
+                ImGui::TextDisabled("...");
+            } else if (!entry.probe_error.empty()) {
+                ImGui::TextDisabled("n/a");
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("%s", entry.probe_error.c_str());
+                }
+            } else {
+                ImGui::Text("%d / %d ms", entry.rtt_ms, entry.handshake_ms);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Round trip: %d ms\nConnect to login prompt: %d ms",
+                                      entry.rtt_ms, entry.handshake_ms);
+                }
+            }
 
             // Tempo (BPM/BPI or Lobby)
-            ImGui::TableSetColumnIndex(1);
+            ImGui::TableSetColumnIndex(kColTempo);
             if (entry.is_lobby) {
                 ImGui::TextDisabled("Lobby");
             } else if (entry.bpm > 0) {
@@ -98,7 +193,7 @@ void ui_render_server_browser(jamwide::JamWidePlugin* plugin) {
             }
 
             // Users (current/max)
-            ImGui::TableSetColumnIndex(2);
+            ImGui::TableSetColumnIndex(kColUsers);
             if (entry.max_users > 0) {
                 ImGui::Text("%d/%d", entry.users, entry.max_users);
             } else {
@@ -106,7 +201,7 @@ void ui_render_server_browser(jamwide::JamWidePlugin* plugin) {
             }
 
             // Usernames - truncated with tooltip
-            ImGui::TableSetColumnIndex(3);
+            ImGui::TableSetColumnIndex(kColWho);
             if (!entry.user_list.empty()) {
                 // Truncate for display
                 std::string display = entry.user_list;
@@ -123,12 +218,19 @@ void ui_render_server_browser(jamwide::JamWidePlugin* plugin) {
             }
 
             // Use button
-            ImGui::TableSetColumnIndex(4);
-            ImGui::PushID(idx++);
+            ImGui::TableSetColumnIndex(kColAction);
+            ImGui::PushID(idx);
             if (ImGui::SmallButton("Use")) {
                 format_server_address(entry,
                                       state.server_input,
                                       sizeof(state.server_input));
+                jamwide::DnsCache::instance().prefetch(entry.host);
+                if (state.server_prewarm &&
+                    state.status != NJClient::NJC_STATUS_OK) {
+                    jamwide::PrewarmCommand cmd;
+                    cmd.server = state.server_input;
+                    jamwide::run_thread_post(plugin, std::move(cmd));
+                }
             }
             ImGui::PopID();
         }
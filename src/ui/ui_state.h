@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include "ui/server_list_types.h"
+#include "threading/inline_string.h"
 
 struct UiRemoteChannel {
     std::string name;
@@ -36,11 +37,16 @@ enum class ChatMessageType {
     System
 };
 
+// Fixed-size so the Run thread can queue it without allocating;
+// longer text is truncated.
 struct ChatMessage {
+    static constexpr std::size_t kSenderMax = 128;   // NJClient::kRemoteNameMax
+    static constexpr std::size_t kContentMax = 1024;
+
     ChatMessageType type{ChatMessageType::Message};
-    std::string sender;
-    std::string content;
-    std::string timestamp;
+    jamwide::InlineString<kSenderMax> sender;
+    jamwide::InlineString<kContentMax> content;
+    jamwide::InlineString<7> timestamp;  // "HH:MM"
 };
 
 struct UiState {
@@ -103,10 +109,15 @@ struct UiState {
     std::vector<ServerListEntry> server_list;
     bool server_list_loading = false;
     std::string server_list_error;
+    bool server_prewarm = false;  // Open a connection to a server when it is picked
 
     // Solo state
     bool any_solo_active = false;
 
+    // UI thread cost, refreshed once a second by the frame pacer
+    float ui_fps = 0.0f;
+    float ui_cpu_ms_per_sec = 0.0f;
+
     // Host detection (for platform-specific hints)
     bool is_reaper_host = false;
     bool reaper_keyboard_hint_dismissed = false;
@@ -123,11 +134,11 @@ struct UiAtomicSnapshot {
     std::atomic<bool>  transient_detected{false};
     std::atomic<float> transient_threshold{0.12f};
 
-    // VU levels (audio thread writes)
-    std::atomic<float> master_vu_left{0.0f};
-    std::atomic<float> master_vu_right{0.0f};
-    std::atomic<float> local_vu_left{0.0f};
-    std::atomic<float> local_vu_right{0.0f};
+    // Bumped whenever a value above changes in a way the UI should redraw for
+    // (tempo, beat, transient); the frame pacer compares it between ticks.
+    std::atomic<unsigned int> changes{0};
+
+    // VU levels live in JamWidePlugin::meters
 };
 
 #endif // UI_STATE_H
@@ -39,6 +39,10 @@ void ui_render_status_bar(jamwide::JamWidePlugin* plugin) {
             color = ImVec4(0.8f, 0.8f, 0.2f, 1.0f);
             status_text = "Connecting...";
             break;
+        case NJClient::NJC_STATUS_RECONNECTING:
+            color = ImVec4(0.9f, 0.6f, 0.2f, 1.0f);
+            status_text = "Reconnecting...";
+            break;
         default:
             color = ImVec4(0.5f, 0.5f, 0.5f, 1.0f);
             status_text = "Disconnected";
@@ -12,26 +12,11 @@ void ui_update_solo_state(jamwide::JamWidePlugin* plugin) {
 
     bool any_solo_active = plugin->ui_state.local_solo;
 
-    std::unique_lock<std::mutex> client_lock(plugin->client_mutex);
-    NJClient* client = plugin->client.get();
-    if (client) {
-        const int num_users = client->GetNumUsers();
-        for (int u = 0; u < num_users && !any_solo_active; ++u) {
-            for (int c = 0; ; ++c) {
-                const int channel_index = client->EnumUserChannels(u, c);
-                if (channel_index < 0) {
-                    break;
-                }
-                bool solo = false;
-                if (client->GetUserChannelState(u, channel_index, nullptr, nullptr,
-                                                nullptr, nullptr, &solo, nullptr,
-                                                nullptr)) {
-                    if (solo) {
-                        any_solo_active = true;
-                        break;
-                    }
-                }
-            }
+    // The UI's copy of the remote mixer already includes edits just made
+    const auto& mixer = plugin->remote_snapshot.read_buffer().mixer;
+    for (int c = 0; c < mixer.num_channels && !any_solo_active; ++c) {
+        if (mixer.chan_solo[c]) {
+            any_solo_active = true;
         }
     }
 
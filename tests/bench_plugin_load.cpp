@@ -0,0 +1,167 @@
+/*
+    JamWide Plugin - bench_plugin_load.cpp
+    Times loading the built .clap and cycling plugin instances through
+    create / init / activate / deactivate / destroy, as a host scanning or
+    opening a project does.
+
+    Usage: bench_plugin_load <path to JamWide.clap> [instances]
+    
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#include <clap/clap.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point t) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+}
+
+const clap_plugin_entry_t* load_entry(const char* path) {
+#ifdef _WIN32
+    HMODULE lib = LoadLibraryA(path);
+    if (!lib) {
+        return nullptr;
+    }
+    return reinterpret_cast<const clap_plugin_entry_t*>(GetProcAddress(lib, "clap_entry"));
+#else
+    void* lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!lib) {
+        std::fprintf(stderr, "dlopen: %s\n", dlerror());
+        return nullptr;
+    }
+    return static_cast<const clap_plugin_entry_t*>(dlsym(lib, "clap_entry"));
+#endif
+}
+
+// A host that offers no extensions
+const void* host_get_extension(const clap_host_t*, const char*) { return nullptr; }
+void host_request(const clap_host_t*) {}
+
+const clap_host_t kHost = {
+    CLAP_VERSION,
+    nullptr,
+    "bench_plugin_load",
+    "JamWide",
+    "",
+    "1.0",
+    host_get_extension,
+    host_request,
+    host_request,
+    host_request,
+};
+
+struct Phase {
+    const char* name;
+    std::vector<double> ms;
+};
+
+void report(const Phase& p) {
+    if (p.ms.empty()) {
+        return;
+    }
+    std::vector<double> v = p.ms;
+    std::sort(v.begin(), v.end());
+    double sum = 0.0;
+    for (double x : v) {
+        sum += x;
+    }
+    std::printf("  %-12s min %8.3f  median %8.3f  max %8.3f  total %9.3f ms\n",
+                p.name, v.front(), v[v.size() / 2], v.back(), sum);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <plugin.clap> [instances]\n", argv[0]);
+        return 2;
+    }
+    const char* path = argv[1];
+    const int instances = argc > 2 ? std::max(1, std::atoi(argv[2])) : 50;
+
+    auto t = Clock::now();
+    const clap_plugin_entry_t* entry = load_entry(path);
+    if (!entry || !entry->init(path)) {
+        std::fprintf(stderr, "could not load %s\n", path);
+        return 1;
+    }
+    const auto* factory = static_cast<const clap_plugin_factory_t*>(
+        entry->get_factory(CLAP_PLUGIN_FACTORY_ID));
+    if (!factory || factory->get_plugin_count(factory) < 1) {
+        std::fprintf(stderr, "no plugin factory\n");
+        return 1;
+    }
+    const std::string id = factory->get_plugin_descriptor(factory, 0)->id;
+    const double load_ms = ms_since(t);
+
+    Phase create{"create"}, init{"init"}, activate{"activate"};
+    Phase deactivate{"deactivate"}, destroy{"destroy"};
+    int failures = 0;
+
+    for (int i = 0; i < instances; ++i) {
+        t = Clock::now();
+        const clap_plugin_t* plugin = factory->create_plugin(factory, &kHost, id.c_str());
+        create.ms.push_back(ms_since(t));
+        if (!plugin) {
+            ++failures;
+            continue;
+        }
+
+        t = Clock::now();
+        const bool ok = plugin->init(plugin);
+        init.ms.push_back(ms_since(t));
+
+        if (ok) {
+            t = Clock::now();
+            const bool active = plugin->activate(plugin, 48000.0, 32, 1024);
+            activate.ms.push_back(ms_since(t));
+            if (active) {
+                t = Clock::now();
+                plugin->deactivate(plugin);
+                deactivate.ms.push_back(ms_since(t));
+            } else {
+                ++failures;
+            }
+        } else {
+            ++failures;
+        }
+
+        t = Clock::now();
+        plugin->destroy(plugin);
+        destroy.ms.push_back(ms_since(t));
+    }
+
+    t = Clock::now();
+    entry->deinit();
+    const double deinit_ms = ms_since(t);
+
+    std::printf("%s, %d instance(s)\n", path, instances);
+    std::printf("  %-12s %8.3f ms\n", "load+init", load_ms);
+    for (const Phase* p : {&create, &init, &activate, &deactivate, &destroy}) {
+        report(*p);
+    }
+    std::printf("  %-12s %8.3f ms\n", "deinit", deinit_ms);
+
+    if (failures) {
+        std::fprintf(stderr, "%d instance(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
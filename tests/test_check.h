@@ -0,0 +1,51 @@
+/*
+    JamWide Plugin - test_check.h
+    Minimal assertions for the standalone test programs
+    
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <cstdio>
+
+namespace jamwide_test {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+/** Exit code for main(): 0 if every CHECK passed. */
+inline int result(const char* name) {
+    if (failures()) {
+        std::fprintf(stderr, "%s: %d check(s) failed\n", name, failures());
+        return 1;
+    }
+    std::printf("%s: ok\n", name);
+    return 0;
+}
+
+} // namespace jamwide_test
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++jamwide_test::failures(); \
+        } \
+    } while (0)
+
+#define CHECK_MSG(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed: ", __FILE__, __LINE__, #cond); \
+            std::fprintf(stderr, __VA_ARGS__); \
+            std::fprintf(stderr, "\n"); \
+            ++jamwide_test::failures(); \
+        } \
+    } while (0)
+
+#endif // TEST_CHECK_H
@@ -0,0 +1,149 @@
+/*
+    JamWide Plugin - test_command_coalescer.cpp
+    CommandCoalescer merging and the ordered command queue beside it
+    
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#include "threading/command_coalescer.h"
+#include "threading/spsc_ring.h"
+#include "test_check.h"
+
+#include <string>
+#include <variant>
+#include <vector>
+
+using namespace jamwide;
+
+namespace {
+
+using Queue = SpscRing<UiCommand, 8>;  // holds 7
+
+// The same routing as run_thread_post()
+bool post(CommandCoalescer& edits, Queue& queue, UiCommand cmd) {
+    return edits.post(cmd) || queue.try_push(std::move(cmd));
+}
+
+SetUserChannelStateCommand channel_volume(const char* user, int channel, float volume) {
+    SetUserChannelStateCommand cmd;
+    cmd.user_name = user;
+    cmd.channel_index = channel;
+    cmd.set_vol = true;
+    cmd.volume = volume;
+    return cmd;
+}
+
+void test_last_write_wins() {
+    CommandCoalescer edits;
+    for (int i = 0; i <= 100; ++i) {
+        CHECK(edits.post(channel_volume("alice", 0, i / 100.0f)));
+    }
+    CHECK(edits.post(channel_volume("alice", 1, 0.25f)));
+    CHECK(edits.post(channel_volume("bob", 0, 0.5f)));
+
+    // A later edit of another field keeps the pending volume
+    SetUserChannelStateCommand pan;
+    pan.user_name = "alice";
+    pan.set_pan = true;
+    pan.pan = -0.5f;
+    CHECK(edits.post(pan));
+
+    SetLocalChannelMonitoringCommand mute;
+    mute.channel = 2;
+    mute.set_mute = true;
+    mute.mute = true;
+    CHECK(edits.post(mute));
+    mute.mute = false;
+    CHECK(edits.post(mute));
+
+    std::vector<UiCommand> out;
+    edits.drain(out);
+    CHECK_MSG(out.size() == 4, "%zu pending edits", out.size());
+    for (const auto& cmd : out) {
+        if (const auto* c = std::get_if<SetUserChannelStateCommand>(&cmd)) {
+            if (c->user_name == "alice" && c->channel_index == 0) {
+                CHECK(c->set_vol && c->volume == 1.0f);
+                CHECK(c->set_pan && c->pan == -0.5f);
+            } else if (c->user_name == "alice") {
+                CHECK(c->channel_index == 1 && c->volume == 0.25f && !c->set_pan);
+            } else {
+                CHECK(c->user_name == "bob" && c->volume == 0.5f);
+            }
+        } else if (const auto* m = std::get_if<SetLocalChannelMonitoringCommand>(&cmd)) {
+            CHECK(m->channel == 2 && m->set_mute && !m->mute && !m->set_volume);
+        } else {
+            CHECK(false);
+        }
+    }
+
+    out.clear();
+    edits.drain(out);
+    CHECK(out.empty());
+}
+
+void test_ordered_commands_keep_order() {
+    CommandCoalescer edits;
+    Queue queue;
+
+    SendChatCommand chat;
+    chat.type = "MSG";
+    chat.text = "one";
+    CHECK(post(edits, queue, ConnectCommand{"host:2049", "me", ""}));
+    CHECK(post(edits, queue, channel_volume("alice", 0, 0.1f)));
+    CHECK(post(edits, queue, chat));
+    CHECK(post(edits, queue, channel_volume("alice", 0, 0.2f)));
+    chat.text = "two";
+    CHECK(post(edits, queue, chat));
+    CHECK(post(edits, queue, DisconnectCommand{}));
+
+    std::vector<UiCommand> out;
+    queue.drain([&](UiCommand&& cmd) { out.push_back(std::move(cmd)); });
+    CHECK_MSG(out.size() == 4, "%zu queued commands", out.size());
+    if (out.size() == 4) {
+        CHECK(std::holds_alternative<ConnectCommand>(out[0]));
+        CHECK(std::get_if<SendChatCommand>(&out[1]) && std::get<SendChatCommand>(out[1]).text == "one");
+        CHECK(std::get_if<SendChatCommand>(&out[2]) && std::get<SendChatCommand>(out[2]).text == "two");
+        CHECK(std::holds_alternative<DisconnectCommand>(out[3]));
+    }
+
+    out.clear();
+    edits.drain(out);
+    CHECK(out.size() == 1);
+}
+
+void test_overflow_counts_drops() {
+    CommandCoalescer edits;
+    Queue queue;
+
+    SendChatCommand chat;
+    chat.type = "MSG";
+    for (std::size_t i = 0; i < Queue::capacity() - 1; ++i) {
+        chat.text = std::to_string(i);
+        CHECK(post(edits, queue, chat));
+    }
+    CHECK(queue.dropped() == 0);
+
+    CHECK(!post(edits, queue, chat));
+    CHECK(!post(edits, queue, DisconnectCommand{}));
+    CHECK_MSG(queue.dropped() == 2, "%zu dropped", queue.dropped());
+
+    // Mixer edits don't use the queue, so a full queue doesn't lose them
+    CHECK(post(edits, queue, channel_volume("alice", 0, 0.5f)));
+    CHECK(queue.dropped() == 2);
+
+    // The first commands are still there, in order, and there is room again
+    auto first = queue.try_pop();
+    CHECK(first && std::get<SendChatCommand>(*first).text == "0");
+    CHECK(post(edits, queue, chat));
+    CHECK(queue.dropped() == 2);
+}
+
+} // namespace
+
+int main() {
+    test_last_write_wins();
+    test_ordered_commands_keep_order();
+    test_overflow_counts_drops();
+    return jamwide_test::result("test_command_coalescer");
+}
@@ -0,0 +1,136 @@
+/*
+    JamWide Plugin - test_prebuffer.cpp
+    Replays interval arrival traces through the adaptive prebuffer estimator
+
+    The traces are synthetic (steady, bursty, one stall): there are no
+    recorded arrival traces from real sessions to check against yet. A
+    recorded fixture belongs next to these once one has been captured.
+    
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#include "core/njclient.h"
+#include "test_check.h"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+constexpr double kRate = 16000.0;       // bytes/sec, ~128 kbit/s
+constexpr double kIntervalSec = 8.0;
+constexpr double kSteadyGap = 0.1;      // seconds between data messages
+constexpr int kDef = DEFAULT_CONFIG_PREBUFFER;
+
+struct Interval {
+    double rate;
+    double max_gap;
+};
+
+// Feeds the trace and returns the prebuffer after each completed interval
+std::vector<int> replay(NJArrivalEstimator& est, const std::vector<Interval>& trace) {
+    std::vector<int> out;
+    double t = 1000.0;
+    for (const Interval& iv : trace) {
+        const double t_first = t + 0.05;
+        const double t_last = t_first + kIntervalSec;
+        const WDL_INT64 bytes = (WDL_INT64)(iv.rate * kIntervalSec);
+        est.Add(bytes, t_first, t_last, iv.max_gap);
+        out.push_back(est.Prebuffer(0, kDef, true));
+        t += kIntervalSec;
+    }
+    return out;
+}
+
+bool in_bounds(const std::vector<int>& v, size_t from) {
+    for (size_t i = from; i < v.size(); ++i) {
+        if (v[i] < LIVE_PREBUFFER || v[i] > ADAPTIVE_PREBUFFER_MAX) {
+            std::fprintf(stderr, "  interval %zu: prebuffer %d out of bounds\n", i, v[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Largest relative step over the last n intervals
+double last_swing(const std::vector<int>& v, size_t n) {
+    double swing = 0.0;
+    for (size_t i = v.size() - n; i + 1 < v.size(); ++i) {
+        swing = std::fmax(swing, std::fabs((double)v[i + 1] - v[i]) / v[i]);
+    }
+    return swing;
+}
+
+void test_steady() {
+    NJArrivalEstimator est;
+    const auto pb = replay(est, std::vector<Interval>(40, Interval{kRate, kSteadyGap}));
+
+    CHECK(pb[0] == kDef); // not learned after one interval
+    CHECK(in_bounds(pb, ADAPTIVE_PREBUFFER_SAMPLES - 1));
+    CHECK_MSG(last_swing(pb, 10) < 0.01, "swing %.3f", last_swing(pb, 10));
+
+    const double expect = kRate * kSteadyGap * ADAPTIVE_PREBUFFER_MARGIN;
+    CHECK_MSG(std::fabs(pb.back() - expect) < expect * 0.05, "got %d, want ~%.0f", pb.back(), expect);
+}
+
+void test_bursty() {
+    // Data arrives in clumps: the gap alternates between short and long, rate wobbles
+    std::vector<Interval> trace;
+    for (int i = 0; i < 60; ++i) {
+        trace.push_back(i & 1 ? Interval{kRate * 1.2, 0.5} : Interval{kRate * 0.8, 0.05});
+    }
+    NJArrivalEstimator est;
+    const auto pb = replay(est, trace);
+
+    CHECK(in_bounds(pb, ADAPTIVE_PREBUFFER_SAMPLES - 1));
+    // fast attack keeps it covering the long gaps rather than the average
+    const double floor = kRate * 0.8 * 0.5 * ADAPTIVE_PREBUFFER_MARGIN;
+    CHECK_MSG(pb.back() >= floor, "got %d, want >= %.0f", pb.back(), floor);
+    // settles into a narrow band instead of chasing every interval
+    CHECK_MSG(last_swing(pb, 10) < 0.15, "swing %.3f", last_swing(pb, 10));
+}
+
+void test_stalled() {
+    std::vector<Interval> trace(20, Interval{kRate, kSteadyGap});
+    trace.push_back(Interval{kRate, 3.0}); // the peer's upload stalled for 3 s
+    trace.insert(trace.end(), 60, Interval{kRate, kSteadyGap});
+
+    NJArrivalEstimator est;
+    const auto pb = replay(est, trace);
+    CHECK(in_bounds(pb, ADAPTIVE_PREBUFFER_SAMPLES - 1));
+
+    const int before = pb[19];
+    CHECK_MSG(pb[20] == ADAPTIVE_PREBUFFER_MAX, "stall gave %d", pb[20]); // clamped, and immediate
+    for (size_t i = 21; i < pb.size(); ++i) {
+        CHECK_MSG(pb[i] <= pb[i - 1], "interval %zu grew while recovering", i);
+    }
+    CHECK_MSG(std::fabs((double)pb.back() - before) < before * 0.1,
+              "recovered to %d, was %d", pb.back(), before);
+}
+
+void test_rules() {
+    NJArrivalEstimator est;
+    CHECK(!est.Add(1000, 0.0, 5.0, 0.1));   // never got data
+    CHECK(!est.Add(1000, 5.0, 5.0, 0.1));   // no duration to measure a rate over
+    CHECK(!est.Learned());
+    CHECK(est.Prebuffer(0, kDef, true) == kDef);
+
+    replay(est, std::vector<Interval>(5, Interval{kRate, 1.0}));
+    CHECK(est.Learned());
+    CHECK(est.Prebuffer(0, kDef, true) != kDef);
+    CHECK(est.Prebuffer(0, kDef, false) == kDef); // adaptive prebuffering turned off
+    CHECK(est.Prebuffer(0, 0, true) == 0);        // prebuffering turned off
+    CHECK(est.Prebuffer(2, kDef, true) == LIVE_PREBUFFER); // live channels stay minimal
+    CHECK(est.Prebuffer(2 | 4, kDef, false) == LIVE_PREBUFFER);
+}
+
+} // namespace
+
+int main() {
+    test_steady();
+    test_bursty();
+    test_stalled();
+    test_rules();
+    return jamwide_test::result("test_prebuffer");
+}
@@ -0,0 +1,338 @@
+/*
+    JamWide Plugin - test_rt_audio.cpp
+    Drives NJClient::AudioProc against a loopback NINJAM server with the
+    realtime checker preloaded
+
+    Run with LD_PRELOAD=libjamwide-rtcheck.so (ctest does). A remote user
+    streams a sine in one-second intervals while a local channel
+    broadcasts, and the audio thread is paced like a host's. The checker
+    fails the process at exit if AudioProc made any call it reports.
+
+    --session plays the remote channel in session mode instead, seeking
+    back once so the loop comes out of the PCM cache.
+
+    --selftest makes one such call on purpose and otherwise succeeds, so
+    only the checker can fail it.
+    
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#include "core/njclient.h"
+#include "core/mpb.h"
+#include "debug/rt_check.h"
+#include "wdl/jnetlib/jnetlib.h"
+#include "test_check.h"
+
+// the same way njclient.cpp includes it
+#define VorbisEncoderInterface I_NJEncoder
+#define VorbisDecoderInterface I_NJDecoder
+#include "wdl/vorbisencdec.h"
+#undef VorbisEncoderInterface
+#undef VorbisDecoderInterface
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <dlfcn.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kSrate = 48000;
+constexpr int kBlock = 256;
+constexpr int kBpm = 240;
+constexpr int kBpi = 4;  // one-second intervals
+constexpr int kIntervals = 6;
+constexpr char kRemoteUser[] = "sine@127.0.0.1";
+constexpr unsigned int kFourccOggv = 'O' | ('G' << 8) | ('G' << 16) | ('v' << 24);
+
+// One interval of a 440 Hz sine as Ogg Vorbis
+std::vector<unsigned char> encode_interval(int serial) {
+    VorbisEncoder enc(kSrate, 1, 64, serial, nullptr);
+    std::vector<float> pcm(kSrate);
+    for (int i = 0; i < kSrate; ++i) {
+        pcm[i] = 0.5f * static_cast<float>(std::sin(2.0 * M_PI * 440.0 * i / kSrate));
+    }
+    std::vector<unsigned char> out;
+    auto drain = [&] {
+        const int n = enc.Available();
+        if (n > 0) {
+            const auto* p = static_cast<const unsigned char*>(enc.Get());
+            out.insert(out.end(), p, p + n);
+            enc.Advance(n);
+            enc.Compact();
+        }
+    };
+    for (int i = 0; i < kSrate; i += 1024) {
+        enc.Encode(pcm.data() + i, std::min(1024, kSrate - i));
+        drain();
+    }
+    enc.Encode(nullptr, 0);
+    drain();
+    return out;
+}
+
+// Accepts one client, welcomes it and sends it an interval every second.
+// In session mode the channel is flagged as such and each interval is
+// followed by its SESSION placement, interval n at n seconds.
+class FakeServer {
+public:
+    explicit FakeServer(bool session) : session_(session) {
+        JNL::open_socketlib();
+        std::mt19937 rng(std::random_device{}());
+        for (int tries = 0; tries < 50 && !listen_; ++tries) {
+            const short port = static_cast<short>(20000 + rng() % 12000);
+            auto listen = std::make_unique<JNL_Listen>(port);
+            if (!listen->is_error()) {
+                port_ = port;
+                listen_ = std::move(listen);
+            }
+        }
+    }
+    ~FakeServer() {
+        stop_ = true;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        con_.reset();
+        listen_.reset();
+        JNL::close_socketlib();
+    }
+
+    int port() const { return port_; }
+    int intervals_sent() const { return sent_.load(); }
+
+    void start() { thread_ = std::thread([this] { run(); }); }
+
+private:
+    void welcome() {
+        mpb_server_auth_challenge ch;
+        ch.protocol_version = PROTO_VER_CUR;
+        ch.server_caps = 3 << 8;  // keepalive seconds
+        con_->Send(ch.build());
+    }
+
+    void accept_user() {
+        mpb_server_auth_reply reply;
+        reply.flag = 1;
+        reply.maxchan = 2;
+        con_->Send(reply.build());
+
+        mpb_server_config_change_notify cfg;
+        cfg.beats_minute = kBpm;
+        cfg.beats_interval = kBpi;
+        con_->Send(cfg.build());
+
+        mpb_server_userinfo_change_notify users;
+        users.build_add_rec(1, 0, 0, 0, session_ ? 4 : 0, kRemoteUser, "sine");
+        con_->Send(users.build());
+        joined_ = true;
+        next_interval_ = Clock::now();
+    }
+
+    void send_interval() {
+        const int n = sent_.load();
+        const std::vector<unsigned char> ogg = encode_interval(1000 + n);
+
+        mpb_server_download_interval_begin begin;
+        for (int i = 0; i < 16; ++i) {
+            begin.guid[i] = static_cast<unsigned char>(n * 31 + i + 1);
+        }
+        begin.estsize = static_cast<int>(ogg.size());
+        begin.fourcc = kFourccOggv;
+        begin.chidx = 0;
+        begin.username = kRemoteUser;
+        con_->Send(begin.build());
+
+        size_t pos = 0;
+        do {
+            mpb_server_download_interval_write wr;
+            std::memcpy(wr.guid, begin.guid, sizeof(wr.guid));
+            const size_t chunk = std::min<size_t>(4096, ogg.size() - pos);
+            wr.audio_data = ogg.data() + pos;
+            wr.audio_data_len = static_cast<int>(chunk);
+            pos += chunk;
+            wr.flags = pos >= ogg.size() ? 1 : 0;
+            con_->Send(wr.build());
+        } while (pos < ogg.size());
+
+        if (session_) {
+            char guid[33], placement[64];
+            for (int i = 0; i < 16; ++i) {
+                std::snprintf(guid + i * 2, 3, "%02x", begin.guid[i]);
+            }
+            std::snprintf(placement, sizeof(placement), "%d.0 1.0", n);
+            mpb_chat_message chat;
+            chat.parms[0] = "SESSION";
+            chat.parms[1] = kRemoteUser;
+            chat.parms[2] = guid;
+            chat.parms[3] = "0";
+            chat.parms[4] = placement;
+            con_->Send(chat.build());
+        }
+
+        sent_.fetch_add(1);
+    }
+
+    void run() {
+        while (!stop_) {
+            if (!con_) {
+                if (JNL_IConnection* c = listen_->get_connect()) {
+                    con_ = std::make_unique<Net_Connection>();
+                    con_->attach(c);
+                    welcome();
+                }
+            } else {
+                while (Net_Message* msg = con_->Run()) {
+                    if (msg->get_type() == MESSAGE_CLIENT_AUTH_USER && !joined_) {
+                        accept_user();
+                    }
+                    msg->releaseRef();  // uploads and the rest are dropped
+                }
+                if (joined_ && sent_.load() < kIntervals && Clock::now() >= next_interval_) {
+                    send_interval();
+                    next_interval_ += std::chrono::seconds(1);
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    std::unique_ptr<JNL_Listen> listen_;
+    std::unique_ptr<Net_Connection> con_;
+    int port_ = -1;
+    const bool session_;
+    bool joined_ = false;
+    Clock::time_point next_interval_;
+    std::atomic<int> sent_{0};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+bool checker_loaded() {
+    return dlsym(RTLD_DEFAULT, "jamwide_rtcheck_enter") != nullptr;
+}
+
+int selftest() {
+    JAMWIDE_RT_INIT();
+    {
+        JAMWIDE_RT_SCOPE();
+        void* volatile p = std::malloc(64);
+        std::free(p);
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--selftest") == 0) {
+        return selftest();
+    }
+    const bool session = argc > 1 && std::strcmp(argv[1], "--session") == 0;
+    if (!checker_loaded()) {
+        std::fprintf(stderr, "test_rt_audio: run with LD_PRELOAD=libjamwide-rtcheck.so\n");
+        return 1;
+    }
+    JAMWIDE_RT_INIT();  // before the client registers its mutexes
+
+    FakeServer server(session);
+    CHECK(server.port() > 0);
+    server.start();
+
+    auto client = std::make_unique<NJClient>();
+    client->config_autosubscribe = 1;
+    client->config_savelocalaudio = 0;
+    client->config_metronome_mute.store(true);
+    if (session) {
+        client->config_pcm_cache_bytes = 8 << 20;
+        client->ChatMessage_Callback = [](void*, NJClient*, const char**, int) {};  // SESSION needs one
+    }
+    client->SetLocalChannelInfo(0, "test", true, 0, true, 64, true, true);
+    client->SetLocalChannelMonitoring(0, false, 0.0f, false, 0.0f, true, true, false, false);
+    client->PrepareAudio(kBlock, kSrate);
+
+    char host[64];
+    std::snprintf(host, sizeof(host), "127.0.0.1:%d", server.port());
+    client->Connect(host, "test", "");
+
+    std::atomic<bool> stop{false};
+    std::thread run_thread([&] {
+        while (!stop.load()) {
+            while (!client->Run()) {
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    // the audio thread: a local sine in, everything summed out, paced to real time
+    std::atomic<float> remote_peak{0.0f};
+    std::atomic<bool> connected{false};
+    std::thread audio_thread([&] {
+        std::vector<float> in(kBlock), outl(kBlock), outr(kBlock);
+        float* inbuf[1] = { in.data() };
+        float* outbuf[2] = { outl.data(), outr.data() };
+        double phase = 0.0;
+        auto next = Clock::now();
+        const auto start = next;
+        const auto end = next + std::chrono::seconds(kIntervals + 2);
+        // session position trails the downloads by 1.5s and loops back to 0 once at 4s
+        double loop = 0.0;
+        while (Clock::now() < end) {
+            for (int i = 0; i < kBlock; ++i) {
+                in[i] = 0.25f * static_cast<float>(std::sin(phase));
+                phase += 2.0 * M_PI * 220.0 / kSrate;
+            }
+            if (session) {
+                const double t = std::chrono::duration<double>(next - start).count() - 1.5;
+                const bool seek = loop == 0.0 && t >= 4.0;
+                if (seek) {
+                    loop = 4.0;
+                }
+                client->AudioProc(inbuf, 1, outbuf, 2, kBlock, kSrate, false, true, seek,
+                                  std::max(t - loop, 0.0));
+            } else {
+                client->AudioProc(inbuf, 1, outbuf, 2, kBlock, kSrate);
+            }
+
+            if (client->cached_status.load() == NJClient::NJC_STATUS_OK) {
+                connected = true;
+            }
+            // local monitoring is muted and the metronome is off, so this is the remote user
+            float peak = remote_peak.load(std::memory_order_relaxed);
+            for (int i = 0; i < kBlock; ++i) {
+                peak = std::max(peak, std::fabs(outl[i]));
+            }
+            remote_peak.store(peak, std::memory_order_relaxed);
+
+            next += std::chrono::microseconds(1000000LL * kBlock / kSrate);
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    audio_thread.join();
+    stop = true;
+    run_thread.join();
+    NJClient::PcmCacheStats pcm = {};
+    client->GetPcmCacheStats(&pcm);
+    client->Disconnect();
+    client.reset();
+
+    CHECK(connected.load());
+    CHECK_MSG(server.intervals_sent() == kIntervals, "%d intervals sent", server.intervals_sent());
+    CHECK_MSG(remote_peak.load() > 0.1f, "remote peak %f", remote_peak.load());
+    if (session) {
+        CHECK_MSG(pcm.hits > 0, "%d PCM cache hits", pcm.hits);
+    }
+    return jamwide_test::result("test_rt_audio");  // the checker's verdict comes at exit
+}
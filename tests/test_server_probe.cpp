@@ -0,0 +1,250 @@
+/*
+    JamWide Plugin - test_server_probe.cpp
+    ServerProber against in-process loopback listeners
+    
+    Copyright (C) 2024 JamWide Contributors
+    Licensed under GPLv2+
+*/
+
+#include "net/server_probe.h"
+#include "core/mpb.h"
+#include "test_check.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace jamwide;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kDelayMs = 300;
+
+enum class Behavior {
+    Immediate,  // auth challenge as soon as the connection is accepted
+    Delayed,    // auth challenge kDelayMs after accepting
+    WrongByte,  // something that isn't NINJAM (an HTTP error)
+    Silent,     // accepts and never says anything
+};
+
+// Loopback listeners driven from their own thread, one behaviour per port
+class FakeServers {
+public:
+    FakeServers() { JNL::open_socketlib(); }
+    ~FakeServers() {
+        stop_ = true;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        for (auto& a : accepted_) {
+            delete a.con;
+        }
+        listeners_.clear();
+        JNL::close_socketlib();
+    }
+
+    int add(Behavior behavior) {
+        auto listen = open_listener();
+        if (!listen) {
+            return -1;
+        }
+        const int port = listen->port();
+        listeners_.push_back({behavior, std::move(listen)});
+        return port;
+    }
+
+    void start() { thread_ = std::thread([this] { run(); }); }
+
+    // A port with nothing listening on it
+    static int closed_port() {
+        auto listen = open_listener();
+        return listen ? listen->port() : -1;
+    }
+
+private:
+    struct Listener {
+        Behavior behavior;
+        std::unique_ptr<JNL_Listen> listen;
+    };
+    struct Accepted {
+        Behavior behavior;
+        JNL_IConnection* con;
+        Clock::time_point when;
+        bool answered;
+    };
+
+    static std::unique_ptr<JNL_Listen> open_listener() {
+        std::mt19937 rng(std::random_device{}());
+        for (int tries = 0; tries < 50; ++tries) {
+            const short port = static_cast<short>(20000 + rng() % 12000);
+            auto listen = std::make_unique<JNL_Listen>(port);
+            if (!listen->is_error()) {
+                return listen;
+            }
+        }
+        return nullptr;
+    }
+
+    static void send_challenge(JNL_IConnection* con) {
+        mpb_server_auth_challenge ch;
+        ch.protocol_version = 0x00020000;
+        Net_Message* msg = ch.build();
+        unsigned char hdr[16];
+        const int hdrlen = msg->makeMessageHeader(hdr);
+        con->send_bytes(hdr, hdrlen);
+        con->send_bytes(msg->get_data(), msg->get_size());
+        msg->releaseRef();  // never queued, back to the pool
+    }
+
+    void run() {
+        while (!stop_) {
+            for (auto& l : listeners_) {
+                if (JNL_IConnection* con = l.listen->get_connect()) {
+                    accepted_.push_back({l.behavior, con, Clock::now(), false});
+                }
+            }
+            const auto now = Clock::now();
+            for (auto& a : accepted_) {
+                if (!a.answered) {
+                    switch (a.behavior) {
+                        case Behavior::Immediate:
+                            send_challenge(a.con);
+                            a.answered = true;
+                            break;
+                        case Behavior::Delayed:
+                            if (now - a.when >= std::chrono::milliseconds(kDelayMs)) {
+                                send_challenge(a.con);
+                                a.answered = true;
+                            }
+                            break;
+                        case Behavior::WrongByte: {
+                            static const char reply[] = "HTTP/1.0 400 Bad Request\r\n\r\n";
+                            a.con->send_bytes(reply, sizeof(reply) - 1);
+                            a.answered = true;
+                            break;
+                        }
+                        case Behavior::Silent:
+                            break;
+                    }
+                }
+                a.con->run();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    std::vector<Listener> listeners_;
+    std::vector<Accepted> accepted_;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+ServerListEntry entry_for(int port) {
+    ServerListEntry e;
+    e.host = "127.0.0.1";
+    e.port = port;
+    return e;
+}
+
+// Polls like the Run thread does until everything has finished
+std::map<int, ServerProbeResult> run_probes(ServerProber& prober, int limit_ms) {
+    std::map<int, ServerProbeResult> by_port;
+    const auto deadline = Clock::now() + std::chrono::milliseconds(limit_ms);
+    while (prober.in_flight() && Clock::now() < deadline) {
+        std::vector<ServerProbeResult> results;
+        prober.poll(results);
+        for (auto& r : results) {
+            by_port[r.port] = r;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(ServerProber::kPollIntervalMs));
+    }
+    return by_port;
+}
+
+void test_behaviours() {
+    FakeServers servers;
+    const int immediate = servers.add(Behavior::Immediate);
+    const int delayed = servers.add(Behavior::Delayed);
+    const int wrong = servers.add(Behavior::WrongByte);
+    const int silent = servers.add(Behavior::Silent);
+    const int closed = FakeServers::closed_port();
+    CHECK(immediate > 0 && delayed > 0 && wrong > 0 && silent > 0 && closed > 0);
+    servers.start();
+
+    // five targets, so one also has to wait for a free slot
+    ServerProber prober;
+    prober.start({entry_for(immediate), entry_for(delayed), entry_for(wrong),
+                  entry_for(silent), entry_for(closed)});
+    CHECK(prober.in_flight());
+    const auto t0 = Clock::now();
+    auto res = run_probes(prober, ServerProber::kTimeoutMs * 3);
+    const auto took = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t0).count();
+    CHECK(!prober.in_flight());
+    CHECK_MSG(res.size() == 5, "%zu results", res.size());
+
+    const ServerProbeResult& im = res[immediate];
+    CHECK_MSG(im.error.empty(), "immediate: %s", im.error.c_str());
+    CHECK(im.rtt_ms >= 0 && im.rtt_ms < 100);
+    CHECK_MSG(im.handshake_ms >= 0 && im.handshake_ms < kDelayMs, "immediate handshake %d", im.handshake_ms);
+
+    const ServerProbeResult& de = res[delayed];
+    CHECK_MSG(de.error.empty(), "delayed: %s", de.error.c_str());
+    CHECK(de.rtt_ms >= 0 && de.rtt_ms < 100); // the TCP round trip isn't the server's think time
+    CHECK_MSG(de.handshake_ms >= kDelayMs - 20 && de.handshake_ms < kDelayMs + 500,
+              "delayed handshake %d", de.handshake_ms);
+
+    const ServerProbeResult& wr = res[wrong];
+    CHECK_MSG(wr.error == "Not a NINJAM server", "wrong byte: '%s'", wr.error.c_str());
+    CHECK(wr.handshake_ms < 0);
+
+    const ServerProbeResult& si = res[silent];
+    CHECK_MSG(si.error == "Timed out", "silent: '%s'", si.error.c_str());
+    CHECK(si.handshake_ms < 0);
+    CHECK(took >= ServerProber::kTimeoutMs);
+
+    const ServerProbeResult& cl = res[closed];
+    CHECK_MSG(!cl.error.empty(), "closed port reported no error");
+    CHECK(cl.rtt_ms < 0 && cl.handshake_ms < 0);
+}
+
+void test_suspend() {
+    FakeServers servers;
+    const int immediate = servers.add(Behavior::Immediate);
+    const int delayed = servers.add(Behavior::Delayed);
+    CHECK(immediate > 0 && delayed > 0);
+    servers.start();
+
+    ServerProber prober;
+    prober.start({entry_for(immediate), entry_for(delayed)});
+    std::vector<ServerProbeResult> results;
+    prober.poll(results);  // launches both
+
+    prober.set_suspended(true);
+    CHECK(!prober.in_flight());
+    std::this_thread::sleep_for(std::chrono::milliseconds(kDelayMs + 100));
+    CHECK(!prober.poll(results));
+    CHECK(results.empty());
+
+    // resumed probes start over, so the suspension doesn't show up in their timings
+    prober.set_suspended(false);
+    CHECK(prober.in_flight());
+    auto res = run_probes(prober, ServerProber::kTimeoutMs * 2);
+    CHECK_MSG(res.size() == 2, "%zu results after resume", res.size());
+    CHECK(res[immediate].error.empty() && res[immediate].handshake_ms < kDelayMs);
+    CHECK(res[delayed].error.empty() && res[delayed].handshake_ms >= kDelayMs - 20);
+}
+
+} // namespace
+
+int main() {
+    test_behaviours();
+    test_suspend();
+    return jamwide_test::result("test_server_probe");
+}
@@ -101,6 +101,18 @@ class WDL_Mutex {
 #endif
     }
 
+    // returns false instead of blocking if another thread holds the mutex
+    bool TryEnter()
+    {
+#ifdef _WIN32
+      return TryEnterCriticalSection(&m_cs) != FALSE;
+#elif defined(WDL_MAC_USE_CARBON_CRITSEC)
+      return MPEnterCriticalRegion(m_cr,kDurationImmediate) == noErr;
+#else
+      return pthread_mutex_trylock(&m_mutex) == 0;
+#endif
+    }
+
     void Leave()
     {
 #ifdef _WIN32
@@ -260,6 +260,7 @@ public:
 
   void SetGranul(int granul) { m_hb.SetGranul(granul); }
   void Prealloc(int sz) { m_hb.Prealloc(sz * sizeof(T)); }
+  int GetAlloc() const { return m_hb.GetAlloc() / (int)sizeof(T); }
 
 private:
   WDL_HeapBuf m_hb;
@@ -188,6 +188,10 @@ class VorbisDecoder : public VorbisDecoderInterface
     int Available() { return m_buf.Available(); }
     float *Get() { return m_buf.Get(); }
 
+    // decoded samples (all channels) the output queue can hold before it reallocates
+    void PreallocOutput(int samples) { if (samples > m_buf.GetAlloc()) m_buf.Prealloc(samples); }
+    int OutputAlloc() const { return m_buf.GetAlloc(); }
+
     void Skip(int amt)
     {
       m_buf.Advance(amt);